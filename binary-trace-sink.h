@@ -0,0 +1,314 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef BINARY_TRACE_SINK_H
+#define BINARY_TRACE_SINK_H
+
+#include "ns3/abort.h"
+#include "ns3/simple-ref-count.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// File layout (host byte order, checked through the header's byte-order mark):
+//
+//   header:       char magic[8] = "NS3BTRC", uint32 version, uint32 byteOrderMark
+//   stream block: uint8 kind = 1, uint16 metric, uint32 id, uint8 valueType,
+//                 uint16 nameLength, char name[nameLength]
+//   column block: uint8 kind = 2, uint16 metric, uint32 count,
+//                 int64 timeNs[count], uint32 id[count], double value[count]
+//
+// Samples are buffered per metric and written one column block at a time, so
+// the tracers never touch the file on the per-ACK path.  The id column tells
+// apart the streams of one metric (a node or a flow index, as the writer
+// chooses).  A stream block binds a (metric, id) pair to the name of the text
+// file it replaces, which is what the converter uses to rebuild the usual
+// ".data" files.
+
+namespace ns3
+{
+
+/**
+ * \brief Buffered writer for fixed-width binary trace samples.
+ */
+class BinaryTraceSink : public SimpleRefCount<BinaryTraceSink>
+{
+  public:
+    /// How the value column of a stream is rendered back to text.
+    enum ValueType : uint8_t
+    {
+        UINTEGER = 0, //!< Counters, windows and sequence numbers
+        REAL = 1,     //!< Times in seconds
+    };
+
+    static constexpr char MAGIC[8] = "NS3BTRC"; //!< File magic
+    static constexpr uint32_t VERSION = 1;       //!< File format version
+    static constexpr uint32_t BOM = 0x01020304;  //!< Byte order mark
+    static constexpr uint8_t STREAM_BLOCK = 1;   //!< Stream declaration block
+    static constexpr uint8_t COLUMN_BLOCK = 2;   //!< Column data block
+
+    /**
+     * Open the sink.
+     *
+     * \param filename Output file name.
+     * \param blockRecords Number of samples buffered per metric before a block is written.
+     */
+    BinaryTraceSink(const std::string& filename, uint32_t blockRecords = 8192);
+    ~BinaryTraceSink();
+
+    /**
+     * Declare the text file a (metric, id) stream stands for.
+     *
+     * \param metric Metric ID.
+     * \param id Stream ID within the metric.
+     * \param type Value rendering.
+     * \param textName Name of the ".data" file the converter writes.
+     */
+    void DeclareStream(uint16_t metric, uint32_t id, ValueType type, const std::string& textName);
+
+    /**
+     * Append one sample.
+     *
+     * \param metric Metric ID.
+     * \param id Stream ID within the metric.
+     * \param timeNs Sample time in nanoseconds.
+     * \param value Sample value.
+     */
+    void Write(uint16_t metric, uint32_t id, int64_t timeNs, double value)
+    {
+        if (metric >= m_columns.size())
+        {
+            m_columns.resize(metric + 1);
+        }
+        Columns& c = m_columns[metric];
+        if (c.time.capacity() < m_blockRecords)
+        {
+            c.time.reserve(m_blockRecords);
+            c.id.reserve(m_blockRecords);
+            c.value.reserve(m_blockRecords);
+        }
+        c.time.push_back(timeNs);
+        c.id.push_back(id);
+        c.value.push_back(value);
+        if (c.time.size() == m_blockRecords)
+        {
+            WriteBlock(metric);
+        }
+    }
+
+    /// Write all buffered samples and flush the file.
+    void Flush();
+
+  private:
+    /// Buffered samples of one metric, one vector per column.
+    struct Columns
+    {
+        std::vector<int64_t> time;  //!< Sample times (ns)
+        std::vector<uint32_t> id;   //!< Stream IDs
+        std::vector<double> value;  //!< Values
+    };
+
+    /**
+     * Write the buffered samples of a metric as a column block.
+     *
+     * \param metric Metric ID.
+     */
+    void WriteBlock(uint16_t metric);
+
+    /**
+     * Write a plain value.
+     *
+     * \param v The value.
+     */
+    template <typename T>
+    void Put(const T& v)
+    {
+        m_file.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    std::ofstream m_file;           //!< Output file
+    std::vector<char> m_fileBuffer; //!< Stream buffer backing m_file
+    uint32_t m_blockRecords;        //!< Samples per column block
+    std::vector<Columns> m_columns; //!< Buffers indexed by metric ID
+};
+
+inline BinaryTraceSink::BinaryTraceSink(const std::string& filename, uint32_t blockRecords)
+    : m_fileBuffer(1 << 20),
+      m_blockRecords(blockRecords)
+{
+    NS_ABORT_MSG_IF(blockRecords == 0, "Block size must be positive");
+    m_file.rdbuf()->pubsetbuf(m_fileBuffer.data(), m_fileBuffer.size());
+    m_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_UNLESS(m_file.is_open(), "Cannot open binary trace file " << filename);
+    m_file.write(MAGIC, sizeof(MAGIC));
+    Put(VERSION);
+    Put(BOM);
+}
+
+inline BinaryTraceSink::~BinaryTraceSink()
+{
+    Flush();
+}
+
+inline void
+BinaryTraceSink::DeclareStream(uint16_t metric,
+                               uint32_t id,
+                               ValueType type,
+                               const std::string& textName)
+{
+    NS_ABORT_MSG_IF(textName.size() > UINT16_MAX, "Stream name too long: " << textName);
+    Put(STREAM_BLOCK);
+    Put(metric);
+    Put(id);
+    Put(static_cast<uint8_t>(type));
+    Put(static_cast<uint16_t>(textName.size()));
+    m_file.write(textName.data(), textName.size());
+}
+
+inline void
+BinaryTraceSink::WriteBlock(uint16_t metric)
+{
+    Columns& c = m_columns[metric];
+    uint32_t count = c.time.size();
+    if (count == 0)
+    {
+        return;
+    }
+    Put(COLUMN_BLOCK);
+    Put(metric);
+    Put(count);
+    m_file.write(reinterpret_cast<const char*>(c.time.data()), count * sizeof(int64_t));
+    m_file.write(reinterpret_cast<const char*>(c.id.data()), count * sizeof(uint32_t));
+    m_file.write(reinterpret_cast<const char*>(c.value.data()), count * sizeof(double));
+    c.time.clear();
+    c.id.clear();
+    c.value.clear();
+}
+
+inline void
+BinaryTraceSink::Flush()
+{
+    for (uint16_t metric = 0; metric < m_columns.size(); metric++)
+    {
+        WriteBlock(metric);
+    }
+    m_file.flush();
+}
+
+/**
+ * \brief Rebuild the per-stream ".data" text files from a binary trace.
+ *
+ * The output matches what the ASCII tracers write: one "<seconds> <value>"
+ * line per sample, with samples at time zero printed as "0.0".
+ *
+ * \param filename Binary trace file name.
+ * \return the number of samples converted.
+ */
+inline uint64_t
+ConvertBinaryTrace(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    NS_ABORT_MSG_UNLESS(in.is_open(), "Cannot open binary trace file " << filename);
+
+    auto get = [&in](auto& v) {
+        in.read(reinterpret_cast<char*>(&v), sizeof(v));
+        return static_cast<bool>(in);
+    };
+
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t bom = 0;
+    in.read(magic, sizeof(magic));
+    NS_ABORT_MSG_UNLESS(in && std::memcmp(magic, BinaryTraceSink::MAGIC, sizeof(magic)) == 0,
+                        filename << " is not a binary trace file");
+    NS_ABORT_MSG_UNLESS(get(version) && version == BinaryTraceSink::VERSION,
+                        "Unsupported binary trace version " << version);
+    NS_ABORT_MSG_UNLESS(get(bom) && bom == BinaryTraceSink::BOM,
+                        "Binary trace was written on a host with a different byte order");
+
+    struct TextStream
+    {
+        BinaryTraceSink::ValueType type;
+        std::unique_ptr<std::ofstream> out;
+    };
+
+    std::map<std::pair<uint16_t, uint32_t>, TextStream> streams;
+    std::vector<int64_t> time;
+    std::vector<uint32_t> id;
+    std::vector<double> value;
+    uint64_t samples = 0;
+    uint8_t kind;
+
+    while (get(kind))
+    {
+        uint16_t metric;
+        NS_ABORT_MSG_UNLESS(get(metric), "Truncated block in " << filename);
+        if (kind == BinaryTraceSink::STREAM_BLOCK)
+        {
+            uint32_t streamId;
+            uint8_t type;
+            uint16_t length;
+            NS_ABORT_MSG_UNLESS(get(streamId) && get(type) && get(length),
+                                "Truncated stream block in " << filename);
+            std::string name(length, '\0');
+            in.read(name.data(), length);
+            TextStream& s = streams[{metric, streamId}];
+            s.type = static_cast<BinaryTraceSink::ValueType>(type);
+            s.out = std::make_unique<std::ofstream>(name);
+            NS_ABORT_MSG_UNLESS(s.out->is_open(), "Cannot open " << name);
+        }
+        else if (kind == BinaryTraceSink::COLUMN_BLOCK)
+        {
+            uint32_t count;
+            NS_ABORT_MSG_UNLESS(get(count), "Truncated column block in " << filename);
+            time.resize(count);
+            id.resize(count);
+            value.resize(count);
+            in.read(reinterpret_cast<char*>(time.data()), count * sizeof(int64_t));
+            in.read(reinterpret_cast<char*>(id.data()), count * sizeof(uint32_t));
+            in.read(reinterpret_cast<char*>(value.data()), count * sizeof(double));
+            NS_ABORT_MSG_UNLESS(in, "Truncated column block in " << filename);
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                auto it = streams.find({metric, id[i]});
+                NS_ABORT_MSG_IF(it == streams.end(),
+                                "Undeclared stream " << metric << "/" << id[i]);
+                std::ostream& os = *it->second.out;
+                if (time[i] == 0)
+                {
+                    os << "0.0 ";
+                }
+                else
+                {
+                    os << time[i] / 1e9 << " ";
+                }
+                if (it->second.type == BinaryTraceSink::UINTEGER)
+                {
+                    os << static_cast<uint64_t>(value[i]) << "\n";
+                }
+                else
+                {
+                    os << value[i] << "\n";
+                }
+            }
+            samples += count;
+        }
+        else
+        {
+            NS_FATAL_ERROR("Unknown block kind " << +kind << " in " << filename);
+        }
+    }
+    return samples;
+}
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_SINK_H */
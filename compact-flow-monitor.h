@@ -0,0 +1,606 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COMPACT_FLOW_MONITOR_H
+#define COMPACT_FLOW_MONITOR_H
+
+#include "flow-report.h"
+
+#include "ns3/abort.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/node-list.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/tag.h"
+#include "ns3/tcp-header.h"
+#include "ns3/tcp-l4-protocol.h"
+#include "ns3/udp-header.h"
+#include "ns3/udp-l4-protocol.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Packet tag carrying the flow, sequence number and send time of a monitored packet.
+ */
+class CompactFlowTag : public Tag
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(TagBuffer buf) const override;
+    void Deserialize(TagBuffer buf) override;
+    void Print(std::ostream& os) const override;
+
+    uint32_t flowIndex{0}; //!< Index of the flow in the monitor
+    uint32_t packetId{0};  //!< Sequence number of the packet in its flow
+    int64_t sendTime{0};   //!< Send time, in time steps
+};
+
+/**
+ * \brief FlowMonitor replacement with bounded per-flow memory for many-flow runs.
+ *
+ * Like Ipv4FlowProbe, the monitor classifies the packets a node sends by 5-tuple, tags
+ * them, and matches them on local delivery.  The state is kept flat:
+ * - flows are found by an open-addressing hash of their 5-tuple, and their statistics are
+ *   a fixed-size record in a vector;
+ * - packets in flight are keys in an open-addressing hash set, erased on delivery or drop;
+ * - loss timeouts run on a timing wheel: a packet is filed under the tick it was sent in,
+ *   and when the wheel comes round to that tick again, MaxPerHopDelay later, whatever is
+ *   still in flight is counted lost, so no periodic scan of all packets is needed;
+ * - delays are kept as sums, minimum and maximum, plus an optional fixed 32-bin log2
+ *   histogram per flow instead of FlowMonitor's growing histograms.
+ *
+ * Packets are counted with their IPv4 header, as FlowMonitor does.  IPv4 drops are
+ * counted at once; packets dropped below IP are counted when they time out.  Fragmented
+ * packets are not tracked.
+ */
+class CompactFlowMonitor : public SimpleRefCount<CompactFlowMonitor>
+{
+  public:
+    /// Number of delay histogram bins, the last one open-ended.
+    static constexpr std::size_t DELAY_BINS = 32;
+
+    /**
+     * \param maxDelay Time after which a packet in flight is counted lost.
+     * \param delayHistogram Whether to keep a delay histogram per flow.
+     */
+    explicit CompactFlowMonitor(Time maxDelay = Seconds(10), bool delayHistogram = false);
+
+    /// Connect to the IPv4 stack of every node.
+    void InstallAll();
+
+    /**
+     * Connect to the IPv4 stack of a node.
+     *
+     * \param node The node.
+     */
+    void Install(Ptr<Node> node);
+
+    /// \return the number of flows seen.
+    uint32_t GetNFlows() const
+    {
+        return m_flows.size();
+    }
+
+    /// \return the number of packets in flight.
+    uint64_t GetInFlight() const
+    {
+        return m_inFlight.size;
+    }
+
+    /**
+     * \param flowIndex A flow.
+     * \return its delay histogram: bin i counts delays in [2^(i-1), 2^i) microseconds.
+     */
+    const std::array<uint32_t, DELAY_BINS>& GetDelayHistogram(uint32_t flowIndex) const;
+
+    /**
+     * Add every flow to a report.
+     *
+     * \param report The report.
+     */
+    void AddFlows(FlowReport& report) const;
+
+    /**
+     * Print the memory used by the monitor state.
+     *
+     * \param os Output stream.
+     */
+    void PrintMemory(std::ostream& os) const;
+
+  private:
+    /// Statistics of one flow.
+    struct FlowRecord
+    {
+        Ipv4FlowClassifier::FiveTuple tuple; //!< 5-tuple
+        uint8_t tos{0};                      //!< ToS of the first packet
+        uint32_t nextPacketId{0};            //!< Next sequence number
+        uint64_t txPackets{0};               //!< Transmitted packets
+        uint64_t txBytes{0};                 //!< Transmitted bytes
+        uint64_t rxPackets{0};               //!< Received packets
+        uint64_t rxBytes{0};                 //!< Received bytes
+        uint64_t lostPackets{0};             //!< Dropped or timed out packets
+        int64_t delaySum{0};                 //!< Sum of the delays, in time steps
+        int64_t jitterSum{0};                //!< Sum of the delay variations
+        int64_t lastDelay{-1};               //!< Delay of the last reception
+        int64_t minDelay{INT64_MAX};         //!< Shortest delay
+        int64_t maxDelay{0};                 //!< Longest delay
+        int64_t firstRx{0};                  //!< First reception
+        int64_t lastRx{0};                   //!< Last reception
+    };
+
+    /// Open-addressing set of in-flight packet keys, linear probing, no tombstones.
+    struct KeySet
+    {
+        static constexpr uint64_t EMPTY = UINT64_MAX; //!< Free slot marker
+        std::vector<uint64_t> slots;                  //!< Slots, a power of two
+        uint64_t size{0};                             //!< Keys stored
+
+        /**
+         * \param key A key.
+         * \return its home slot.
+         */
+        std::size_t Home(uint64_t key) const
+        {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return key & (slots.size() - 1);
+        }
+
+        /**
+         * \param key Key to add.
+         */
+        void Insert(uint64_t key);
+
+        /**
+         * \param key Key to remove.
+         * \return true if it was present.
+         */
+        bool Erase(uint64_t key);
+    };
+
+    /**
+     * \param tuple A 5-tuple.
+     * \param tos ToS of its first packet.
+     * \return the index of its flow, created on first use.
+     */
+    uint32_t FindOrAddFlow(const Ipv4FlowClassifier::FiveTuple& tuple, uint8_t tos);
+    /**
+     * \param tuple A 5-tuple.
+     * \return its hash.
+     */
+    static uint64_t Hash(const Ipv4FlowClassifier::FiveTuple& tuple);
+    /**
+     * \param flowIndex A flow.
+     * \param packetId A packet of it.
+     * \return the in-flight key.
+     */
+    static uint64_t Key(uint32_t flowIndex, uint32_t packetId)
+    {
+        return static_cast<uint64_t>(flowIndex) << 32 | packetId;
+    }
+
+    /**
+     * SendOutgoing sink: a locally generated packet.
+     * \param header Its IPv4 header.
+     * \param packet Its payload.
+     * \param interface Output interface.
+     */
+    void Sent(const Ipv4Header& header, Ptr<const Packet> packet, uint32_t interface);
+    /**
+     * LocalDeliver sink.
+     * \param header IPv4 header.
+     * \param packet Payload.
+     * \param interface Input interface.
+     */
+    void Delivered(const Ipv4Header& header, Ptr<const Packet> packet, uint32_t interface);
+    /**
+     * Drop sink.
+     * \param header IPv4 header.
+     * \param packet Payload.
+     * \param reason Drop reason.
+     * \param ipv4 The IPv4 stack.
+     * \param interface Interface.
+     */
+    void Dropped(const Ipv4Header& header,
+                 Ptr<const Packet> packet,
+                 Ipv4L3Protocol::DropReason reason,
+                 Ptr<Ipv4> ipv4,
+                 uint32_t interface);
+    /// Advance the timing wheel by one tick and expire the slot it lands on.
+    void Tick();
+
+    Time m_tick;                                //!< Wheel tick
+    bool m_delayHistogram;                      //!< Whether delay histograms are kept
+    std::vector<FlowRecord> m_flows;            //!< Flows by index
+    std::vector<uint32_t> m_flowSlots;          //!< 5-tuple hash slots, flow index + 1
+    KeySet m_inFlight;                          //!< Packets in flight
+    std::vector<std::vector<uint64_t>> m_wheel; //!< Keys sent in each tick
+    uint64_t m_tickCount{0};                    //!< Ticks elapsed
+    bool m_running{false};                      //!< Whether the wheel is scheduled
+    /// Delay histograms by flow index, if enabled
+    std::vector<std::array<uint32_t, DELAY_BINS>> m_histograms;
+};
+
+/// Ticks per MaxPerHopDelay; the wheel has one more slot.
+constexpr uint32_t COMPACT_FLOW_WHEEL_TICKS = 8;
+
+NS_OBJECT_ENSURE_REGISTERED(CompactFlowTag);
+
+inline TypeId
+CompactFlowTag::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::CompactFlowTag")
+                            .SetParent<Tag>()
+                            .SetGroupName("FlowMonitor")
+                            .AddConstructor<CompactFlowTag>();
+    return tid;
+}
+
+inline TypeId
+CompactFlowTag::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+inline uint32_t
+CompactFlowTag::GetSerializedSize() const
+{
+    return 16;
+}
+
+inline void
+CompactFlowTag::Serialize(TagBuffer buf) const
+{
+    buf.WriteU32(flowIndex);
+    buf.WriteU32(packetId);
+    buf.WriteU64(sendTime);
+}
+
+inline void
+CompactFlowTag::Deserialize(TagBuffer buf)
+{
+    flowIndex = buf.ReadU32();
+    packetId = buf.ReadU32();
+    sendTime = buf.ReadU64();
+}
+
+inline void
+CompactFlowTag::Print(std::ostream& os) const
+{
+    os << "flow=" << flowIndex << " packet=" << packetId << " sent=" << sendTime;
+}
+
+inline void
+CompactFlowMonitor::KeySet::Insert(uint64_t key)
+{
+    if ((size + 1) * 2 > slots.size())
+    {
+        std::vector<uint64_t> old(std::max<std::size_t>(slots.size() * 2, 1024), EMPTY);
+        old.swap(slots);
+        size = 0;
+        for (uint64_t k : old)
+        {
+            if (k != EMPTY)
+            {
+                Insert(k);
+            }
+        }
+    }
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = Home(key);
+    while (slots[i] != EMPTY)
+    {
+        i = (i + 1) & mask;
+    }
+    slots[i] = key;
+    ++size;
+}
+
+inline bool
+CompactFlowMonitor::KeySet::Erase(uint64_t key)
+{
+    if (slots.empty())
+    {
+        return false;
+    }
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = Home(key);
+    while (slots[i] != key)
+    {
+        if (slots[i] == EMPTY)
+        {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    // Backward-shift the rest of the cluster so lookups never need tombstones
+    std::size_t hole = i;
+    for (std::size_t j = (i + 1) & mask; slots[j] != EMPTY; j = (j + 1) & mask)
+    {
+        std::size_t home = Home(slots[j]);
+        if (((j - home) & mask) >= ((j - hole) & mask))
+        {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole] = EMPTY;
+    --size;
+    return true;
+}
+
+inline CompactFlowMonitor::CompactFlowMonitor(Time maxDelay, bool delayHistogram)
+    : m_tick(maxDelay / COMPACT_FLOW_WHEEL_TICKS),
+      m_delayHistogram(delayHistogram),
+      m_wheel(COMPACT_FLOW_WHEEL_TICKS + 1)
+{
+    NS_ABORT_MSG_UNLESS(m_tick.IsStrictlyPositive(), "MaxPerHopDelay must be positive");
+}
+
+inline void
+CompactFlowMonitor::InstallAll()
+{
+    for (auto node = NodeList::Begin(); node != NodeList::End(); ++node)
+    {
+        if ((*node)->GetObject<Ipv4L3Protocol>())
+        {
+            Install(*node);
+        }
+    }
+}
+
+inline void
+CompactFlowMonitor::Install(Ptr<Node> node)
+{
+    Ptr<Ipv4L3Protocol> ipv4 = node->GetObject<Ipv4L3Protocol>();
+    NS_ABORT_MSG_UNLESS(ipv4, "Node " << node->GetId() << " has no IPv4 stack");
+    ipv4->TraceConnectWithoutContext("SendOutgoing", MakeCallback(&CompactFlowMonitor::Sent, this));
+    ipv4->TraceConnectWithoutContext("LocalDeliver",
+                                     MakeCallback(&CompactFlowMonitor::Delivered, this));
+    ipv4->TraceConnectWithoutContext("Drop", MakeCallback(&CompactFlowMonitor::Dropped, this));
+    if (!m_running)
+    {
+        m_running = true;
+        Simulator::Schedule(m_tick, &CompactFlowMonitor::Tick, this);
+    }
+}
+
+inline uint64_t
+CompactFlowMonitor::Hash(const Ipv4FlowClassifier::FiveTuple& tuple)
+{
+    uint64_t h = static_cast<uint64_t>(tuple.sourceAddress.Get()) << 32 |
+                 tuple.destinationAddress.Get();
+    uint64_t ports = static_cast<uint64_t>(tuple.sourcePort) << 24 |
+                     static_cast<uint64_t>(tuple.destinationPort) << 8 | tuple.protocol;
+    h ^= ports * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint32_t
+CompactFlowMonitor::FindOrAddFlow(const Ipv4FlowClassifier::FiveTuple& tuple, uint8_t tos)
+{
+    if ((m_flows.size() + 1) * 2 > m_flowSlots.size())
+    {
+        m_flowSlots.assign(std::max<std::size_t>(m_flowSlots.size() * 2, 1024), 0);
+        std::size_t mask = m_flowSlots.size() - 1;
+        for (uint32_t index = 0; index < m_flows.size(); ++index)
+        {
+            std::size_t i = Hash(m_flows[index].tuple) & mask;
+            while (m_flowSlots[i] != 0)
+            {
+                i = (i + 1) & mask;
+            }
+            m_flowSlots[i] = index + 1;
+        }
+    }
+
+    std::size_t mask = m_flowSlots.size() - 1;
+    std::size_t i = Hash(tuple) & mask;
+    while (m_flowSlots[i] != 0)
+    {
+        if (m_flows[m_flowSlots[i] - 1].tuple == tuple)
+        {
+            return m_flowSlots[i] - 1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    uint32_t index = m_flows.size();
+    m_flowSlots[i] = index + 1;
+    m_flows.emplace_back();
+    m_flows.back().tuple = tuple;
+    m_flows.back().tos = tos;
+    if (m_delayHistogram)
+    {
+        m_histograms.emplace_back();
+    }
+    return index;
+}
+
+inline void
+CompactFlowMonitor::Sent(const Ipv4Header& header,
+                         Ptr<const Packet> packet,
+                         uint32_t /* interface */)
+{
+    CompactFlowTag tag;
+    if (packet->PeekPacketTag(tag) || header.IsMoreFragments() || header.GetFragmentOffset() != 0)
+    {
+        return; // already tracked, e.g. a packet sent back out of the same node
+    }
+
+    Ipv4FlowClassifier::FiveTuple tuple;
+    tuple.sourceAddress = header.GetSource();
+    tuple.destinationAddress = header.GetDestination();
+    tuple.protocol = header.GetProtocol();
+    tuple.sourcePort = 0;
+    tuple.destinationPort = 0;
+    if (tuple.protocol == UdpL4Protocol::PROT_NUMBER)
+    {
+        UdpHeader udp;
+        packet->PeekHeader(udp);
+        tuple.sourcePort = udp.GetSourcePort();
+        tuple.destinationPort = udp.GetDestinationPort();
+    }
+    else if (tuple.protocol == TcpL4Protocol::PROT_NUMBER)
+    {
+        TcpHeader tcp;
+        packet->PeekHeader(tcp);
+        tuple.sourcePort = tcp.GetSourcePort();
+        tuple.destinationPort = tcp.GetDestinationPort();
+    }
+
+    tag.flowIndex = FindOrAddFlow(tuple, header.GetTos());
+    FlowRecord& flow = m_flows[tag.flowIndex];
+    tag.packetId = flow.nextPacketId++;
+    tag.sendTime = Simulator::Now().GetTimeStep();
+    ConstCast<Packet>(packet)->AddPacketTag(tag);
+
+    flow.txPackets++;
+    flow.txBytes += packet->GetSize() + header.GetSerializedSize();
+    uint64_t key = Key(tag.flowIndex, tag.packetId);
+    m_inFlight.Insert(key);
+    m_wheel[m_tickCount % m_wheel.size()].push_back(key);
+}
+
+inline void
+CompactFlowMonitor::Delivered(const Ipv4Header& header,
+                              Ptr<const Packet> packet,
+                              uint32_t /* interface */)
+{
+    CompactFlowTag tag;
+    if (!ConstCast<Packet>(packet)->RemovePacketTag(tag) ||
+        !m_inFlight.Erase(Key(tag.flowIndex, tag.packetId)))
+    {
+        return; // not ours, or already counted lost
+    }
+
+    FlowRecord& flow = m_flows[tag.flowIndex];
+    int64_t now = Simulator::Now().GetTimeStep();
+    int64_t delay = now - tag.sendTime;
+    if (flow.rxPackets == 0)
+    {
+        flow.firstRx = now;
+    }
+    else
+    {
+        flow.jitterSum += std::abs(delay - flow.lastDelay);
+    }
+    flow.lastRx = now;
+    flow.lastDelay = delay;
+    flow.rxPackets++;
+    flow.rxBytes += packet->GetSize() + header.GetSerializedSize();
+    flow.delaySum += delay;
+    flow.minDelay = std::min(flow.minDelay, delay);
+    flow.maxDelay = std::max(flow.maxDelay, delay);
+
+    if (m_delayHistogram)
+    {
+        int64_t us = TimeStep(delay).GetMicroSeconds();
+        std::size_t bin = us <= 0 ? 0 : 64 - __builtin_clzll(static_cast<uint64_t>(us));
+        m_histograms[tag.flowIndex][std::min(bin, DELAY_BINS - 1)]++;
+    }
+}
+
+inline void
+CompactFlowMonitor::Dropped(const Ipv4Header& /* header */,
+                            Ptr<const Packet> packet,
+                            Ipv4L3Protocol::DropReason /* reason */,
+                            Ptr<Ipv4> /* ipv4 */,
+                            uint32_t /* interface */)
+{
+    CompactFlowTag tag;
+    if (packet->PeekPacketTag(tag) && m_inFlight.Erase(Key(tag.flowIndex, tag.packetId)))
+    {
+        m_flows[tag.flowIndex].lostPackets++;
+    }
+}
+
+inline void
+CompactFlowMonitor::Tick()
+{
+    // The slot of the new tick holds the packets sent one full turn ago, more than
+    // MaxPerHopDelay before now
+    ++m_tickCount;
+    std::vector<uint64_t>& slot = m_wheel[m_tickCount % m_wheel.size()];
+    for (uint64_t key : slot)
+    {
+        if (m_inFlight.Erase(key))
+        {
+            m_flows[key >> 32].lostPackets++;
+        }
+    }
+    slot.clear();
+    Simulator::Schedule(m_tick, &CompactFlowMonitor::Tick, this);
+}
+
+inline const std::array<uint32_t, CompactFlowMonitor::DELAY_BINS>&
+CompactFlowMonitor::GetDelayHistogram(uint32_t flowIndex) const
+{
+    NS_ABORT_MSG_UNLESS(m_delayHistogram, "Delay histograms are disabled");
+    NS_ABORT_MSG_IF(flowIndex >= m_histograms.size(), "Unknown flow " << flowIndex);
+    return m_histograms[flowIndex];
+}
+
+inline void
+CompactFlowMonitor::AddFlows(FlowReport& report) const
+{
+    for (uint32_t index = 0; index < m_flows.size(); ++index)
+    {
+        const FlowRecord& record = m_flows[index];
+        FlowSummary flow;
+        flow.flowId = index + 1;
+        flow.tuple = record.tuple;
+        flow.tos = record.tos;
+        flow.txPackets = record.txPackets;
+        flow.txBytes = record.txBytes;
+        flow.rxPackets = record.rxPackets;
+        flow.rxBytes = record.rxBytes;
+        flow.lostPackets = record.lostPackets;
+        flow.delaySum = TimeStep(record.delaySum);
+        flow.jitterSum = TimeStep(record.jitterSum);
+        flow.timeFirstRxPacket = TimeStep(record.firstRx);
+        flow.timeLastRxPacket = TimeStep(record.lastRx);
+        report.AddFlow(flow);
+    }
+}
+
+inline void
+CompactFlowMonitor::PrintMemory(std::ostream& os) const
+{
+    std::size_t wheel = 0;
+    for (const auto& slot : m_wheel)
+    {
+        wheel += slot.capacity() * sizeof(uint64_t);
+    }
+    std::size_t total = m_flows.capacity() * sizeof(FlowRecord) +
+                        m_flowSlots.capacity() * sizeof(uint32_t) +
+                        m_histograms.capacity() * sizeof(m_histograms[0]) +
+                        m_inFlight.slots.capacity() * sizeof(uint64_t) + wheel;
+    os << "Compact flow monitor: " << m_flows.size() << " flows, " << m_inFlight.size
+       << " packets in flight, " << total / 1024 << " KiB" << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* COMPACT_FLOW_MONITOR_H */
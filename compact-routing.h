@@ -0,0 +1,610 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COMPACT_ROUTING_H
+#define COMPACT_ROUTING_H
+
+#include "topology-builder.h"
+
+#include "ns3/abort.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-helper.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4.h"
+#include "ns3/node.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/simple-ref-count.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief All-pairs next hops of a static Topology.
+ *
+ * The graph is kept in CSR form (per-node offsets into one array of
+ * incident edge ends).  The next hop from a source to a destination is a
+ * 16-bit port number, a port being the position of an edge in the node's
+ * adjacency list.  Each source row is computed with one breadth-first
+ * search, the sources being spread over a pool of threads.  Paths are
+ * minimum hop count, like global routing with its default unit metric.
+ *
+ * A row is stored as runs of consecutive destinations sharing a port,
+ * looked up by binary search, unless the plain array of ports is smaller.
+ * The generators number the nodes behind a port mostly contiguously (fat
+ * tree pods, dumbbell sides, ring arcs), so their rows shrink to a few
+ * runs; rows of unstructured graphs, like Topology::Random, stay plain at
+ * 2 bytes per destination.  The constructor aborts as soon as the rows
+ * would take more than \p maxBytes.
+ *
+ * Addresses follow the TopologyHelper layout, so the node owning an address
+ * and the gateway of a port are computed, not looked up.
+ */
+class CompactRoutingTable : public SimpleRefCount<CompactRoutingTable>
+{
+  public:
+    /// Port value for "no route" and "local".
+    static constexpr uint16_t NO_PORT = std::numeric_limits<uint16_t>::max();
+
+    /// Default bound on the memory taken by the rows.
+    static constexpr uint64_t DEFAULT_MAX_BYTES = uint64_t(1) << 30;
+
+    /**
+     * \param topology The topology.
+     * \param base First address of the TopologyHelper subnets.
+     * \param threads Number of threads; 0 uses one per core.
+     * \param maxBytes Abort if the rows need more memory than this.
+     */
+    CompactRoutingTable(const Topology& topology,
+                        Ipv4Address base,
+                        uint32_t threads = 0,
+                        uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+    /**
+     * \param address An address.
+     * \param node Set to the topology node owning it.
+     * \return whether the address belongs to the topology.
+     */
+    bool GetNodeOfAddress(Ipv4Address address, uint32_t& node) const;
+
+    /**
+     * \param src Source node.
+     * \param dst Destination node.
+     * \return the port of src towards dst, or NO_PORT.
+     */
+    uint16_t GetNextHop(uint32_t src, uint32_t dst) const
+    {
+        auto first = m_starts.begin() + m_startOffset[src];
+        auto last = m_starts.begin() + m_startOffset[src + 1];
+        if (first == last)
+        {
+            return m_ports[m_portOffset[src] + dst];
+        }
+        return m_ports[m_portOffset[src] + (std::upper_bound(first, last, dst) - first) - 1];
+    }
+
+    /**
+     * \param node A node.
+     * \return the number of ports of the node.
+     */
+    uint32_t GetNPorts(uint32_t node) const
+    {
+        return m_offset[node + 1] - m_offset[node];
+    }
+
+    /**
+     * \param node A node.
+     * \param port One of its ports.
+     * \return the address of the node on that port.
+     */
+    Ipv4Address GetLocalAddress(uint32_t node, uint16_t port) const
+    {
+        uint32_t end = m_ends[m_offset[node] + port];
+        return Ipv4Address(m_base.Get() + 4 * (end / 2) + 1 + end % 2);
+    }
+
+    /**
+     * \param node A node.
+     * \param port One of its ports.
+     * \return the address of the neighbour at the other end of the port.
+     */
+    Ipv4Address GetGateway(uint32_t node, uint16_t port) const
+    {
+        uint32_t end = m_ends[m_offset[node] + port];
+        return Ipv4Address(m_base.Get() + 4 * (end / 2) + 1 + (1 - end % 2));
+    }
+
+    /// \return the number of nodes.
+    uint32_t GetNNodes() const
+    {
+        return m_nodes;
+    }
+
+    /// \return the memory taken by the rows, in bytes.
+    uint64_t GetBytes() const
+    {
+        return m_starts.size() * sizeof(uint32_t) + m_ports.size() * sizeof(uint16_t);
+    }
+
+  private:
+    /// Next hops of one source, before the rows are packed.
+    struct Row
+    {
+        std::vector<uint32_t> start; //!< First destination of every run, empty if plain
+        std::vector<uint16_t> port;  //!< Port of every run, or of every destination
+    };
+
+    /**
+     * Compute rows, one source at a time, until no source is left or the
+     * rows exceed their budget.
+     *
+     * \param next Next source to process, shared by the threads.
+     * \param rows Rows of all sources.
+     * \param bytes Memory taken by the rows computed so far, shared by the threads.
+     * \param maxBytes Budget of memory.
+     */
+    void Worker(std::atomic<uint32_t>& next,
+                std::vector<Row>& rows,
+                std::atomic<uint64_t>& bytes,
+                uint64_t maxBytes) const;
+
+    Ipv4Address m_base;                  //!< First subnet
+    uint32_t m_nodes;                    //!< Number of nodes
+    uint32_t m_edges;                    //!< Number of edges
+    std::vector<uint32_t> m_edgeNodes;   //!< Nodes of edge e at 2e (first) and 2e + 1 (second)
+    std::vector<uint32_t> m_offset;      //!< CSR offsets, m_nodes + 1 entries
+    std::vector<uint32_t> m_ends;        //!< Incident edge ends, 2 * edge + side
+    std::vector<uint64_t> m_startOffset; //!< First run start of every row, m_nodes + 1 entries
+    std::vector<uint64_t> m_portOffset;  //!< First port of every row, m_nodes + 1 entries
+    std::vector<uint32_t> m_starts;      //!< First destination of every run
+    std::vector<uint16_t> m_ports;       //!< Ports, NO_PORT if unreachable
+};
+
+/**
+ * \brief Routing protocol forwarding with a shared CompactRoutingTable.
+ *
+ * Meant to sit below static routing in an Ipv4ListRouting, which takes care
+ * of local delivery.  The protocol finds its own topology node from its
+ * addresses the first time it routes a packet.
+ */
+class CompactRouting : public Ipv4RoutingProtocol
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * \param table The shared table.
+     */
+    void SetTable(Ptr<const CompactRoutingTable> table)
+    {
+        m_table = table;
+        m_node = UNRESOLVED;
+    }
+
+    Ptr<Ipv4Route> RouteOutput(Ptr<Packet> p,
+                               const Ipv4Header& header,
+                               Ptr<NetDevice> oif,
+                               Socket::SocketErrno& sockerr) override;
+    bool RouteInput(Ptr<const Packet> p,
+                    const Ipv4Header& header,
+                    Ptr<const NetDevice> idev,
+                    const UnicastForwardCallback& ucb,
+                    const MulticastForwardCallback& mcb,
+                    const LocalDeliverCallback& lcb,
+                    const ErrorCallback& ecb) override;
+    void NotifyInterfaceUp(uint32_t interface) override;
+    void NotifyInterfaceDown(uint32_t interface) override;
+    void NotifyAddAddress(uint32_t interface, Ipv4InterfaceAddress address) override;
+    void NotifyRemoveAddress(uint32_t interface, Ipv4InterfaceAddress address) override;
+    void SetIpv4(Ptr<Ipv4> ipv4) override;
+    void PrintRoutingTable(Ptr<OutputStreamWrapper> stream,
+                           Time::Unit unit = Time::S) const override;
+
+  private:
+    /// Value of m_node before the node is known.
+    static constexpr uint32_t UNRESOLVED = std::numeric_limits<uint32_t>::max();
+
+    /// Find the topology node and the interface of every port.
+    void Resolve();
+
+    /**
+     * \param destination The destination.
+     * \return the route, or nullptr.
+     */
+    Ptr<Ipv4Route> Lookup(Ipv4Address destination);
+
+    Ptr<const CompactRoutingTable> m_table; //!< Shared table
+    Ptr<Ipv4> m_ipv4;                       //!< IPv4 of the node
+    uint32_t m_node{UNRESOLVED};            //!< Topology node
+    std::vector<uint32_t> m_interface;      //!< Interface of every port
+};
+
+/**
+ * \brief Create CompactRouting instances sharing one table.
+ *
+ * \code
+ *   Ipv4ListRoutingHelper list;
+ *   list.Add(Ipv4StaticRoutingHelper(), 0);
+ *   list.Add(CompactRoutingHelper(topology), -10);
+ *   InternetStackHelper stack;
+ *   stack.SetRoutingHelper(list);
+ *   topologyHelper.SetStackHelper(stack);
+ * \endcode
+ */
+class CompactRoutingHelper : public Ipv4RoutingHelper
+{
+  public:
+    /**
+     * Compute the table.
+     *
+     * \param topology The topology.
+     * \param base First address of the TopologyHelper subnets.
+     * \param threads Number of threads; 0 uses one per core.
+     * \param maxBytes Abort if the table needs more memory than this.
+     */
+    CompactRoutingHelper(const Topology& topology,
+                         Ipv4Address base = Ipv4Address("10.0.0.0"),
+                         uint32_t threads = 0,
+                         uint64_t maxBytes = CompactRoutingTable::DEFAULT_MAX_BYTES)
+        : m_table(ns3::Create<CompactRoutingTable>(topology, base, threads, maxBytes))
+    {
+    }
+
+    CompactRoutingHelper* Copy() const override
+    {
+        return new CompactRoutingHelper(*this);
+    }
+
+    Ptr<Ipv4RoutingProtocol> Create(Ptr<Node> node) const override
+    {
+        Ptr<CompactRouting> routing = CreateObject<CompactRouting>();
+        routing->SetTable(m_table);
+        return routing;
+    }
+
+  private:
+    Ptr<const CompactRoutingTable> m_table; //!< Shared table
+};
+
+inline CompactRoutingTable::CompactRoutingTable(const Topology& topology,
+                                                Ipv4Address base,
+                                                uint32_t threads,
+                                                uint64_t maxBytes)
+    : m_base(base),
+      m_nodes(topology.GetNNodes()),
+      m_edges(topology.GetEdges().size())
+{
+    const auto& edges = topology.GetEdges();
+
+    // CSR adjacency, ports in edge order like the TopologyHelper interfaces
+    m_edgeNodes.resize(2 * m_edges);
+    m_offset.assign(m_nodes + 1, 0);
+    for (uint32_t e = 0; e < m_edges; e++)
+    {
+        m_edgeNodes[2 * e] = edges[e].a;
+        m_edgeNodes[2 * e + 1] = edges[e].b;
+        m_offset[edges[e].a + 1]++;
+        m_offset[edges[e].b + 1]++;
+    }
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+        NS_ABORT_MSG_IF(m_offset[n + 1] >= NO_PORT, "Node " << n << " has too many links");
+        m_offset[n + 1] += m_offset[n];
+    }
+    m_ends.resize(2 * m_edges);
+    std::vector<uint32_t> fill(m_offset.begin(), m_offset.end() - 1);
+    for (uint32_t e = 0; e < m_edges; e++)
+    {
+        m_ends[fill[edges[e].a]++] = 2 * e;
+        m_ends[fill[edges[e].b]++] = 2 * e + 1;
+    }
+
+    if (threads == 0)
+    {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, std::max(1U, m_nodes));
+
+    std::vector<Row> rows(m_nodes);
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint64_t> bytes{0};
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < threads; t++)
+    {
+        pool.emplace_back(&CompactRoutingTable::Worker,
+                          this,
+                          std::ref(next),
+                          std::ref(rows),
+                          std::ref(bytes),
+                          maxBytes);
+    }
+    Worker(next, rows, bytes, maxBytes);
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+    NS_ABORT_MSG_IF(bytes > maxBytes,
+                    "Next-hop table of " << m_nodes << " nodes needs more than " << maxBytes
+                                         << " bytes; raise maxBytes or use global routing");
+
+    // Pack the rows into one pair of arrays
+    m_startOffset.assign(m_nodes + 1, 0);
+    m_portOffset.assign(m_nodes + 1, 0);
+    for (uint32_t n = 0; n < m_nodes; n++)
+    {
+        m_startOffset[n + 1] = m_startOffset[n] + rows[n].start.size();
+        m_portOffset[n + 1] = m_portOffset[n] + rows[n].port.size();
+    }
+    m_starts.reserve(m_startOffset[m_nodes]);
+    m_ports.reserve(m_portOffset[m_nodes]);
+    for (auto& row : rows)
+    {
+        m_starts.insert(m_starts.end(), row.start.begin(), row.start.end());
+        m_ports.insert(m_ports.end(), row.port.begin(), row.port.end());
+        row = Row();
+    }
+}
+
+inline void
+CompactRoutingTable::Worker(std::atomic<uint32_t>& next,
+                            std::vector<Row>& rows,
+                            std::atomic<uint64_t>& bytes,
+                            uint64_t maxBytes) const
+{
+    std::vector<uint32_t> queue(m_nodes);
+    std::vector<uint16_t> firstPort(m_nodes);
+    std::vector<uint16_t> row(m_nodes);
+    std::vector<bool> seen(m_nodes);
+
+    for (uint32_t src = next++; src < m_nodes; src = next++)
+    {
+        std::fill(row.begin(), row.end(), NO_PORT);
+        std::fill(seen.begin(), seen.end(), false);
+        seen[src] = true;
+        std::size_t head = 0;
+        std::size_t tail = 0;
+
+        for (uint32_t p = 0; p < GetNPorts(src); p++)
+        {
+            uint32_t end = m_ends[m_offset[src] + p];
+            uint32_t v = m_edgeNodes[end ^ 1];
+            if (!seen[v])
+            {
+                seen[v] = true;
+                firstPort[v] = p;
+                row[v] = p;
+                queue[tail++] = v;
+            }
+        }
+        while (head < tail)
+        {
+            uint32_t u = queue[head++];
+            for (uint32_t i = m_offset[u]; i < m_offset[u + 1]; i++)
+            {
+                uint32_t v = m_edgeNodes[m_ends[i] ^ 1];
+                if (!seen[v])
+                {
+                    seen[v] = true;
+                    firstPort[v] = firstPort[u];
+                    row[v] = firstPort[u];
+                    queue[tail++] = v;
+                }
+            }
+        }
+
+        uint64_t runs = 1;
+        for (uint32_t dst = 1; dst < m_nodes; dst++)
+        {
+            runs += row[dst] != row[dst - 1];
+        }
+        Row& packed = rows[src];
+        if (runs * (sizeof(uint32_t) + sizeof(uint16_t)) < m_nodes * sizeof(uint16_t))
+        {
+            packed.start.reserve(runs);
+            packed.port.reserve(runs);
+            for (uint32_t dst = 0; dst < m_nodes; dst++)
+            {
+                if (dst == 0 || row[dst] != row[dst - 1])
+                {
+                    packed.start.push_back(dst);
+                    packed.port.push_back(row[dst]);
+                }
+            }
+        }
+        else
+        {
+            packed.port = row;
+        }
+        uint64_t size =
+            packed.start.size() * sizeof(uint32_t) + packed.port.size() * sizeof(uint16_t);
+        if ((bytes += size) > maxBytes)
+        {
+            return;
+        }
+    }
+}
+
+inline bool
+CompactRoutingTable::GetNodeOfAddress(Ipv4Address address, uint32_t& node) const
+{
+    uint32_t offset = address.Get() - m_base.Get();
+    uint32_t host = offset % 4;
+    if (address.Get() < m_base.Get() || offset / 4 >= m_edges || host == 0 || host == 3)
+    {
+        return false;
+    }
+    node = m_edgeNodes[2 * (offset / 4) + host - 1];
+    return true;
+}
+
+NS_OBJECT_ENSURE_REGISTERED(CompactRouting);
+
+inline TypeId
+CompactRouting::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::CompactRouting")
+                            .SetParent<Ipv4RoutingProtocol>()
+                            .SetGroupName("Internet")
+                            .AddConstructor<CompactRouting>();
+    return tid;
+}
+
+inline void
+CompactRouting::Resolve()
+{
+    m_interface.clear();
+    for (uint32_t i = 0; i < m_ipv4->GetNInterfaces() && m_node == UNRESOLVED; i++)
+    {
+        for (uint32_t j = 0; j < m_ipv4->GetNAddresses(i); j++)
+        {
+            if (m_table->GetNodeOfAddress(m_ipv4->GetAddress(i, j).GetLocal(), m_node))
+            {
+                break;
+            }
+        }
+    }
+    if (m_node == UNRESOLVED)
+    {
+        return;
+    }
+    for (uint32_t p = 0; p < m_table->GetNPorts(m_node); p++)
+    {
+        int32_t interface = m_ipv4->GetInterfaceForAddress(m_table->GetLocalAddress(m_node, p));
+        NS_ABORT_MSG_IF(interface < 0, "Port " << p << " of node " << m_node << " has no address");
+        m_interface.push_back(interface);
+    }
+}
+
+inline Ptr<Ipv4Route>
+CompactRouting::Lookup(Ipv4Address destination)
+{
+    if (m_node == UNRESOLVED)
+    {
+        Resolve();
+    }
+    uint32_t dst;
+    if (m_node == UNRESOLVED || !m_table->GetNodeOfAddress(destination, dst))
+    {
+        return nullptr;
+    }
+    uint16_t port = m_table->GetNextHop(m_node, dst);
+    if (port == CompactRoutingTable::NO_PORT || !m_ipv4->IsUp(m_interface[port]))
+    {
+        return nullptr;
+    }
+
+    Ptr<Ipv4Route> route = Create<Ipv4Route>();
+    route->SetDestination(destination);
+    route->SetGateway(m_table->GetGateway(m_node, port));
+    route->SetSource(m_table->GetLocalAddress(m_node, port));
+    route->SetOutputDevice(m_ipv4->GetNetDevice(m_interface[port]));
+    return route;
+}
+
+inline Ptr<Ipv4Route>
+CompactRouting::RouteOutput(Ptr<Packet> p,
+                            const Ipv4Header& header,
+                            Ptr<NetDevice> oif,
+                            Socket::SocketErrno& sockerr)
+{
+    Ptr<Ipv4Route> route = Lookup(header.GetDestination());
+    if (!route || (oif && oif != route->GetOutputDevice()))
+    {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return nullptr;
+    }
+    sockerr = Socket::ERROR_NOTERROR;
+    return route;
+}
+
+inline bool
+CompactRouting::RouteInput(Ptr<const Packet> p,
+                           const Ipv4Header& header,
+                           Ptr<const NetDevice> idev,
+                           const UnicastForwardCallback& ucb,
+                           const MulticastForwardCallback& mcb,
+                           const LocalDeliverCallback& lcb,
+                           const ErrorCallback& ecb)
+{
+    if (header.GetDestination().IsMulticast())
+    {
+        return false;
+    }
+    Ptr<Ipv4Route> route = Lookup(header.GetDestination());
+    if (!route)
+    {
+        return false;
+    }
+    ucb(route, p, header);
+    return true;
+}
+
+// The table describes a static topology and is never recomputed.  Lookup
+// checks that the outgoing interface is up, so a link going down drops the
+// routes through it instead of rerouting, and the interface numbers of the
+// ports do not change with the link state.
+
+inline void
+CompactRouting::NotifyInterfaceUp(uint32_t /* interface */)
+{
+}
+
+inline void
+CompactRouting::NotifyInterfaceDown(uint32_t /* interface */)
+{
+}
+
+inline void
+CompactRouting::NotifyAddAddress(uint32_t interface, Ipv4InterfaceAddress address)
+{
+    m_node = UNRESOLVED;
+}
+
+inline void
+CompactRouting::NotifyRemoveAddress(uint32_t interface, Ipv4InterfaceAddress address)
+{
+    m_node = UNRESOLVED;
+}
+
+inline void
+CompactRouting::SetIpv4(Ptr<Ipv4> ipv4)
+{
+    m_ipv4 = ipv4;
+    m_node = UNRESOLVED;
+}
+
+inline void
+CompactRouting::PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+    std::ostream* os = stream->GetStream();
+    *os << "Node: " << m_ipv4->GetObject<Node>()->GetId() << ", compact routing, topology node ";
+    if (m_node == UNRESOLVED)
+    {
+        *os << "unresolved" << std::endl;
+        return;
+    }
+    *os << m_node << std::endl << "Destination node\tGateway\t\tInterface" << std::endl;
+    for (uint32_t dst = 0; dst < m_table->GetNNodes(); dst++)
+    {
+        uint16_t port = m_table->GetNextHop(m_node, dst);
+        if (port != CompactRoutingTable::NO_PORT)
+        {
+            *os << dst << "\t\t\t" << m_table->GetGateway(m_node, port) << "\t"
+                << m_interface[port] << std::endl;
+        }
+    }
+}
+
+} // namespace ns3
+
+#endif /* COMPACT_ROUTING_H */
@@ -0,0 +1,254 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Parameter sweep driver for five.cc.
+//
+// Every configuration of the sweep runs as its own five.cc process on a pool
+// of workers sized to the core count, with its own --run value, and the
+// per-flow FlowMonitor summaries of all runs are merged into one CSV table.
+// Failed runs keep a row with their exit status and empty metrics.
+//
+// Cartesian product of comma-separated lists:
+//
+// ./ns3 run "five-sweep --transport_prot=TcpNewReno,TcpCubic --error_p=0,0.01
+//            --queue_disc_type=ns3::PfifoFastQueueDisc,ns3::CoDelQueueDisc --replications=10"
+//
+// Explicit list, one set of five.cc arguments per line:
+//
+// ./ns3 run "five-sweep --config_file=configs.txt --replications=5"
+
+#include "process-runner.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FiveSweep");
+
+/**
+ * Quote a CSV field if it needs it.
+ *
+ * \param field The field.
+ * \return the CSV field.
+ */
+static std::string
+CsvField(const std::string& field)
+{
+    if (field.find_first_of(",\"") == std::string::npos)
+    {
+        return field;
+    }
+    std::string quoted = "\"";
+    for (char c : field)
+    {
+        quoted += (c == '"') ? "\"\"" : std::string(1, c);
+    }
+    return quoted + "\"";
+}
+
+/// One point of the sweep.
+struct SweepConfig
+{
+    std::vector<std::string> values; //!< Table columns describing the point
+    std::vector<std::string> args;   //!< five.cc arguments
+};
+
+int
+main(int argc, char* argv[])
+{
+    std::string program = "build/scratch/ns3.44-five-default";
+    std::string transport_prot;
+    std::string queue_disc_type;
+    std::string error_p;
+    std::string bandwidth;
+    std::string config_file;
+    std::string extra_args;
+    std::string output_dir = "five-sweep";
+    uint32_t replications = 1;
+    uint32_t run_base = 0;
+    uint32_t jobs = 0;
+    bool tracing = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("program", "Path to the five.cc executable", program);
+    cmd.AddValue("transport_prot", "Comma-separated transport protocols", transport_prot);
+    cmd.AddValue("queue_disc_type", "Comma-separated queue disc types", queue_disc_type);
+    cmd.AddValue("error_p", "Comma-separated packet error rates", error_p);
+    cmd.AddValue("bandwidth", "Comma-separated bottleneck bandwidths", bandwidth);
+    cmd.AddValue("config_file",
+                 "File with one set of five.cc arguments per line (replaces the lists)",
+                 config_file);
+    cmd.AddValue("extra_args", "Space-separated arguments passed to every run", extra_args);
+    cmd.AddValue("replications", "Number of runs of each configuration", replications);
+    cmd.AddValue("run_base", "First run index", run_base);
+    cmd.AddValue("jobs", "Number of concurrent runs (0: one per core)", jobs);
+    cmd.AddValue("output_dir", "Directory for logs, summaries and the results table", output_dir);
+    cmd.AddValue("tracing", "Let the runs write their TCP and ASCII traces", tracing);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(replications == 0, "At least one replication is needed");
+
+    std::vector<std::string> columns;
+    std::vector<SweepConfig> configs;
+
+    if (!config_file.empty())
+    {
+        std::ifstream in(config_file);
+        NS_ABORT_MSG_UNLESS(in.is_open(), "Cannot open " << config_file);
+        columns.emplace_back("args");
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            configs.push_back({{line}, SplitList(line, ' ')});
+        }
+    }
+    else
+    {
+        std::vector<std::pair<std::string, std::vector<std::string>>> axes;
+        for (const auto& [name, list] : {std::make_pair("transport_prot", transport_prot),
+                                         std::make_pair("queue_disc_type", queue_disc_type),
+                                         std::make_pair("error_p", error_p),
+                                         std::make_pair("bandwidth", bandwidth)})
+        {
+            std::vector<std::string> values = SplitList(list, ',');
+            if (!values.empty())
+            {
+                columns.emplace_back(name);
+                axes.emplace_back(name, values);
+            }
+        }
+
+        // Walk the cartesian product like an odometer
+        std::vector<std::size_t> index(axes.size(), 0);
+        while (true)
+        {
+            SweepConfig config;
+            for (std::size_t a = 0; a < axes.size(); a++)
+            {
+                const std::string& value = axes[a].second[index[a]];
+                config.values.push_back(value);
+                config.args.push_back("--" + axes[a].first + "=" + value);
+            }
+            configs.push_back(config);
+
+            std::size_t a = 0;
+            while (a < axes.size() && ++index[a] == axes[a].second.size())
+            {
+                index[a++] = 0;
+            }
+            if (a == axes.size())
+            {
+                break;
+            }
+        }
+    }
+    NS_ABORT_MSG_IF(configs.empty(), "Empty sweep");
+
+    std::filesystem::create_directories(output_dir);
+    std::vector<std::string> extra = SplitList(extra_args, ' ');
+
+    ProcessPool pool(jobs);
+    std::vector<std::pair<std::size_t, uint32_t>> points; // (config, run) of each job
+    for (std::size_t c = 0; c < configs.size(); c++)
+    {
+        for (uint32_t r = run_base; r < run_base + replications; r++)
+        {
+            std::string name = output_dir + "/cfg" + std::to_string(c) + "-run" + std::to_string(r);
+            std::vector<std::string> argv = {program};
+            argv.insert(argv.end(), configs[c].args.begin(), configs[c].args.end());
+            argv.insert(argv.end(), extra.begin(), extra.end());
+            argv.push_back("--run=" + std::to_string(r));
+            argv.push_back("--prefix_name=" + name);
+            argv.push_back("--summary_file=" + name + ".csv");
+            argv.push_back(std::string("--tracing=") + (tracing ? "true" : "false"));
+            pool.Add(argv, name + ".log");
+            points.emplace_back(c, r);
+        }
+    }
+
+    std::cout << "Running " << points.size() << " simulations on " << pool.GetWorkers()
+              << " workers" << std::endl;
+    std::vector<ProcessResult> results = pool.Run();
+
+    std::string table = output_dir + "/results.csv";
+    std::ofstream out(table);
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open " << table);
+
+    // Read every summary first: the metric columns come from any run that
+    // produced one, and the failed runs get as many empty fields
+    std::vector<std::vector<std::string>> summaries(points.size());
+    std::string metrics;
+    uint32_t failed = 0;
+    for (std::size_t j = 0; j < points.size(); j++)
+    {
+        const auto& [c, r] = points[j];
+        std::ifstream summary(output_dir + "/cfg" + std::to_string(c) + "-run" +
+                              std::to_string(r) + ".csv");
+        std::string line;
+        if (results[j].exitStatus != 0 || !std::getline(summary, line))
+        {
+            failed++;
+            continue;
+        }
+        metrics = line;
+        while (std::getline(summary, line))
+        {
+            summaries[j].push_back(line);
+        }
+    }
+
+    out << "config,run";
+    for (const auto& column : columns)
+    {
+        out << "," << column;
+    }
+    out << ",exit_status,wall_s,max_rss_kb";
+    if (!metrics.empty())
+    {
+        out << "," << metrics;
+    }
+    out << "\n";
+    std::string emptyMetrics(std::count(metrics.begin(), metrics.end(), ',') + 1, ',');
+
+    for (std::size_t j = 0; j < points.size(); j++)
+    {
+        const auto& [c, r] = points[j];
+        std::string prefix = std::to_string(c) + "," + std::to_string(r);
+        for (const auto& value : configs[c].values)
+        {
+            prefix += "," + CsvField(value);
+        }
+        prefix += "," + std::to_string(results[j].exitStatus) + "," +
+                  std::to_string(results[j].wallSeconds) + "," +
+                  std::to_string(results[j].maxRssKb);
+
+        if (summaries[j].empty())
+        {
+            // Failed run, or a run without flows: one row, metrics left empty
+            out << prefix << (metrics.empty() ? "" : emptyMetrics) << "\n";
+            continue;
+        }
+        for (const auto& line : summaries[j])
+        {
+            out << prefix << "," << line << "\n";
+        }
+    }
+
+    std::cout << "Results of " << points.size() << " runs written to " << table;
+    if (failed > 0)
+    {
+        std::cout << " (" << failed << " runs failed, see their .log files)";
+    }
+    std::cout << std::endl;
+
+    return failed > 0 ? 1 : 0;
+}
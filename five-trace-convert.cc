@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Convert a binary TCP trace written by five.cc (--trace_format=binary) back to
+// the per-flow ".data" text files that the ASCII tracers produce.
+//
+// ./ns3 run "five-trace-convert --input=TcpVariantsComparison-tcp.btr"
+
+#include "binary-trace-sink.h"
+
+#include "ns3/core-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FiveTraceConvert");
+
+int
+main(int argc, char* argv[])
+{
+    std::string input = "TcpVariantsComparison-tcp.btr";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Binary trace file to convert", input);
+    cmd.Parse(argc, argv);
+
+    uint64_t samples = ConvertBinaryTrace(input);
+    std::cout << "Converted " << samples << " samples from " << input << std::endl;
+
+    return 0;
+}
@@ -22,6 +22,15 @@
  * ICST SIMUTools Workshop on ns-3 (WNS3), Cannes, France, March 2013
  */
 
+#include "binary-trace-sink.h"
+#include "compact-flow-monitor.h"
+#include "flow-report.h"
+#include "flow-sampler.h"
+#include "heap-hooks.h"
+#include "ladder-scheduler.h"
+#include "run-stats.h"
+#include "steady-state.h"
+
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/enum.h"
@@ -40,293 +49,337 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("TcpVariantsComparison");
 
-static std::map<uint32_t, bool> firstCwnd;                      //!< First congestion window.
-static std::map<uint32_t, bool> firstSshThr;                    //!< First SlowStart threshold.
-static std::map<uint32_t, bool> firstRtt;                       //!< First RTT.
-static std::map<uint32_t, bool> firstRto;                       //!< First RTO.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> cWndStream; //!< Congstion window output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>>
-    ssThreshStream; //!< SlowStart threshold output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> rttStream;      //!< RTT output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> rtoStream;      //!< RTO output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> nextTxStream;   //!< Next TX output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> nextRxStream;   //!< Next RX output stream.
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> inFlightStream; //!< In flight output stream.
-static std::map<uint32_t, uint32_t> cWndValue;                      //!< congestion window value.
-static std::map<uint32_t, uint32_t> ssThreshValue;                  //!< SlowStart threshold value.
+/**
+ * Trace state of one flow.
+ *
+ * The tracers of a flow are bound to its entry with MakeBoundCallback, so a
+ * sample costs no context parsing and no map lookup.  Sender sockets are
+ * hooked as soon as their application has created them, receiver sockets
+ * from the first Rx callback of their application.
+ */
+struct FlowTraceState
+{
+    uint32_t id{0};                          //!< Flow index, used as binary stream ID.
+    Ptr<BulkSendApplication> sourceApp;      //!< Sending application.
+    Ptr<PacketSink> sinkApp;                 //!< Receiving application.
+    bool sourceHooked{false};                //!< Sender socket traces connected.
+    bool sinkHooked{false};                  //!< Receiver socket traces connected.
+    bool firstCwnd{true};                    //!< First congestion window.
+    bool firstSshThr{true};                  //!< First SlowStart threshold.
+    bool firstRtt{true};                     //!< First RTT.
+    bool firstRto{true};                     //!< First RTO.
+    uint32_t cWndValue{0};                   //!< Congestion window value.
+    uint32_t ssThreshValue{0};               //!< SlowStart threshold value.
+    Ptr<OutputStreamWrapper> cWndStream;     //!< Congestion window output stream.
+    Ptr<OutputStreamWrapper> ssThreshStream; //!< SlowStart threshold output stream.
+    Ptr<OutputStreamWrapper> rttStream;      //!< RTT output stream.
+    Ptr<OutputStreamWrapper> rtoStream;      //!< RTO output stream.
+    Ptr<OutputStreamWrapper> nextTxStream;   //!< Next TX output stream.
+    Ptr<OutputStreamWrapper> nextRxStream;   //!< Next RX output stream.
+    Ptr<OutputStreamWrapper> inFlightStream; //!< In flight output stream.
+};
+
+static std::vector<FlowTraceState> flowTraces; //!< Trace state, indexed by flow.
+static Ptr<BinaryTraceSink> binarySink; //!< Binary trace sink (null when tracing to ASCII).
+
+/// Metric IDs used in the binary trace.
+enum TraceMetric : uint16_t
+{
+    CWND = 0,
+    SSTHRESH,
+    RTT,
+    RTO,
+    NEXT_TX,
+    NEXT_RX,
+    IN_FLIGHT,
+};
+
+/**
+ * Write one trace sample, either to the binary sink or as a text line.
+ *
+ * \param metric The metric.
+ * \param nodeId The node ID.
+ * \param stream The text stream (unused with the binary sink).
+ * \param at The sample time.
+ * \param value The sample value.
+ */
+template <typename T>
+static void
+WriteSample(TraceMetric metric,
+            uint32_t nodeId,
+            const Ptr<OutputStreamWrapper>& stream,
+            const Time& at,
+            T value)
+{
+    if (binarySink)
+    {
+        binarySink->Write(metric, nodeId, at.GetNanoSeconds(), value);
+        return;
+    }
+    std::ostream& os = *stream->GetStream();
+    if (at.IsZero())
+    {
+        os << "0.0 " << value << '\n';
+    }
+    else
+    {
+        os << at.GetSeconds() << " " << value << '\n';
+    }
+}
 
 /**
- * Get the Node Id From Context.
+ * Open the output of a trace, either as a text file or as a binary sink stream.
  *
- * \param context The context.
- * \return the node ID.
+ * \param metric The metric.
+ * \param nodeId The node ID.
+ * \param type How the binary values are rendered back to text.
+ * \param file_name The text trace file name.
+ * \return the text stream, or null with the binary sink.
  */
-static uint32_t
-GetNodeIdFromContext(std::string context)
+static Ptr<OutputStreamWrapper>
+OpenTrace(TraceMetric metric,
+          uint32_t nodeId,
+          BinaryTraceSink::ValueType type,
+          const std::string& file_name)
 {
-    const std::size_t n1 = context.find_first_of('/', 1);
-    const std::size_t n2 = context.find_first_of('/', n1 + 1);
-    return std::stoul(context.substr(n1 + 1, n2 - n1 - 1));
+    if (binarySink)
+    {
+        binarySink->DeclareStream(metric, nodeId, type, file_name);
+        return nullptr;
+    }
+    AsciiTraceHelper ascii;
+    return ascii.CreateFileStream(file_name);
 }
 
 /**
  * Congestion window tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param oldval Old value.
  * \param newval New value.
  */
 static void
-CwndTracer(std::string context, uint32_t oldval, uint32_t newval)
+CwndTracer(FlowTraceState* flow, uint32_t oldval, uint32_t newval)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    if (firstCwnd[nodeId])
+    if (flow->firstCwnd)
     {
-        *cWndStream[nodeId]->GetStream() << "0.0 " << oldval << std::endl;
-        firstCwnd[nodeId] = false;
+        WriteSample(CWND, flow->id, flow->cWndStream, Seconds(0), oldval);
+        flow->firstCwnd = false;
     }
-    *cWndStream[nodeId]->GetStream() << Simulator::Now().GetSeconds() << " " << newval << std::endl;
-    cWndValue[nodeId] = newval;
+    WriteSample(CWND, flow->id, flow->cWndStream, Simulator::Now(), newval);
+    flow->cWndValue = newval;
 
-    if (!firstSshThr[nodeId])
+    if (!flow->firstSshThr)
     {
-        *ssThreshStream[nodeId]->GetStream()
-            << Simulator::Now().GetSeconds() << " " << ssThreshValue[nodeId] << std::endl;
+        WriteSample(SSTHRESH,
+                    flow->id,
+                    flow->ssThreshStream,
+                    Simulator::Now(),
+                    flow->ssThreshValue);
     }
 }
 
 /**
  * Slow start threshold tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param oldval Old value.
  * \param newval New value.
  */
 static void
-SsThreshTracer(std::string context, uint32_t oldval, uint32_t newval)
+SsThreshTracer(FlowTraceState* flow, uint32_t oldval, uint32_t newval)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    if (firstSshThr[nodeId])
+    if (flow->firstSshThr)
     {
-        *ssThreshStream[nodeId]->GetStream() << "0.0 " << oldval << std::endl;
-        firstSshThr[nodeId] = false;
+        WriteSample(SSTHRESH, flow->id, flow->ssThreshStream, Seconds(0), oldval);
+        flow->firstSshThr = false;
     }
-    *ssThreshStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << newval << std::endl;
-    ssThreshValue[nodeId] = newval;
+    WriteSample(SSTHRESH, flow->id, flow->ssThreshStream, Simulator::Now(), newval);
+    flow->ssThreshValue = newval;
 
-    if (!firstCwnd[nodeId])
+    if (!flow->firstCwnd)
     {
-        *cWndStream[nodeId]->GetStream()
-            << Simulator::Now().GetSeconds() << " " << cWndValue[nodeId] << std::endl;
+        WriteSample(CWND, flow->id, flow->cWndStream, Simulator::Now(), flow->cWndValue);
     }
 }
 
 /**
  * RTT tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param oldval Old value.
  * \param newval New value.
  */
 static void
-RttTracer(std::string context, Time oldval, Time newval)
+RttTracer(FlowTraceState* flow, Time oldval, Time newval)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    if (firstRtt[nodeId])
+    if (flow->firstRtt)
     {
-        *rttStream[nodeId]->GetStream() << "0.0 " << oldval.GetSeconds() << std::endl;
-        firstRtt[nodeId] = false;
+        WriteSample(RTT, flow->id, flow->rttStream, Seconds(0), oldval.GetSeconds());
+        flow->firstRtt = false;
     }
-    *rttStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << newval.GetSeconds() << std::endl;
+    WriteSample(RTT, flow->id, flow->rttStream, Simulator::Now(), newval.GetSeconds());
 }
 
 /**
  * RTO tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param oldval Old value.
  * \param newval New value.
  */
 static void
-RtoTracer(std::string context, Time oldval, Time newval)
+RtoTracer(FlowTraceState* flow, Time oldval, Time newval)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    if (firstRto[nodeId])
+    if (flow->firstRto)
     {
-        *rtoStream[nodeId]->GetStream() << "0.0 " << oldval.GetSeconds() << std::endl;
-        firstRto[nodeId] = false;
+        WriteSample(RTO, flow->id, flow->rtoStream, Seconds(0), oldval.GetSeconds());
+        flow->firstRto = false;
     }
-    *rtoStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << newval.GetSeconds() << std::endl;
+    WriteSample(RTO, flow->id, flow->rtoStream, Simulator::Now(), newval.GetSeconds());
 }
 
 /**
  * Next TX tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param old Old sequence number.
  * \param nextTx Next sequence number.
  */
 static void
-NextTxTracer(std::string context, SequenceNumber32 old [[maybe_unused]], SequenceNumber32 nextTx)
+NextTxTracer(FlowTraceState* flow, SequenceNumber32 old [[maybe_unused]], SequenceNumber32 nextTx)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    *nextTxStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << nextTx << std::endl;
+    WriteSample(NEXT_TX, flow->id, flow->nextTxStream, Simulator::Now(), nextTx.GetValue());
 }
 
 /**
  * In-flight tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param old Old value.
  * \param inFlight In flight value.
  */
 static void
-InFlightTracer(std::string context, uint32_t old [[maybe_unused]], uint32_t inFlight)
+InFlightTracer(FlowTraceState* flow, uint32_t old [[maybe_unused]], uint32_t inFlight)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    *inFlightStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << inFlight << std::endl;
+    WriteSample(IN_FLIGHT, flow->id, flow->inFlightStream, Simulator::Now(), inFlight);
 }
 
 /**
  * Next RX tracer.
  *
- * \param context The context.
+ * \param flow The flow trace state.
  * \param old Old sequence number.
  * \param nextRx Next sequence number.
  */
 static void
-NextRxTracer(std::string context, SequenceNumber32 old [[maybe_unused]], SequenceNumber32 nextRx)
+NextRxTracer(FlowTraceState* flow, SequenceNumber32 old [[maybe_unused]], SequenceNumber32 nextRx)
 {
-    uint32_t nodeId = GetNodeIdFromContext(context);
-
-    *nextRxStream[nodeId]->GetStream()
-        << Simulator::Now().GetSeconds() << " " << nextRx << std::endl;
+    WriteSample(NEXT_RX, flow->id, flow->nextRxStream, Simulator::Now(), nextRx.GetValue());
 }
 
 /**
- * Congestion window trace connection.
+ * Open the trace outputs of a flow.
  *
- * \param cwnd_tr_file_name Congestion window trace file name.
- * \param nodeId Node ID.
+ * \param prefix Trace file name prefix, including the flow suffix.
+ * \param flow The flow trace state.
  */
 static void
-TraceCwnd(std::string cwnd_tr_file_name, uint32_t nodeId)
+OpenFlowTraces(const std::string& prefix, FlowTraceState* flow)
 {
-    AsciiTraceHelper ascii;
-    cWndStream[nodeId] = ascii.CreateFileStream(cwnd_tr_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) +
-                        "/$ns3::TcpL4Protocol/SocketList/0/CongestionWindow",
-                    MakeCallback(&CwndTracer));
+    flow->cWndStream = OpenTrace(CWND, flow->id, BinaryTraceSink::UINTEGER, prefix + "-cwnd.data");
+    flow->ssThreshStream =
+        OpenTrace(SSTHRESH, flow->id, BinaryTraceSink::UINTEGER, prefix + "-ssth.data");
+    flow->rttStream = OpenTrace(RTT, flow->id, BinaryTraceSink::REAL, prefix + "-rtt.data");
+    flow->rtoStream = OpenTrace(RTO, flow->id, BinaryTraceSink::REAL, prefix + "-rto.data");
+    flow->nextTxStream =
+        OpenTrace(NEXT_TX, flow->id, BinaryTraceSink::UINTEGER, prefix + "-next-tx.data");
+    flow->inFlightStream =
+        OpenTrace(IN_FLIGHT, flow->id, BinaryTraceSink::UINTEGER, prefix + "-inflight.data");
+    flow->nextRxStream =
+        OpenTrace(NEXT_RX, flow->id, BinaryTraceSink::UINTEGER, prefix + "-next-rx.data");
 }
 
 /**
- * Slow start threshold trace connection.
+ * Hook the sender socket of a flow, once it exists.
  *
- * \param ssthresh_tr_file_name Slow start threshold trace file name.
- * \param nodeId Node ID.
+ * \param flow The flow trace state.
  */
 static void
-TraceSsThresh(std::string ssthresh_tr_file_name, uint32_t nodeId)
+HookSourceTraces(FlowTraceState* flow)
 {
-    AsciiTraceHelper ascii;
-    ssThreshStream[nodeId] = ascii.CreateFileStream(ssthresh_tr_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) +
-                        "/$ns3::TcpL4Protocol/SocketList/0/SlowStartThreshold",
-                    MakeCallback(&SsThreshTracer));
-}
-
-/**
- * RTT trace connection.
- *
- * \param rtt_tr_file_name RTT trace file name.
- * \param nodeId Node ID.
- */
-static void
-TraceRtt(std::string rtt_tr_file_name, uint32_t nodeId)
-{
-    AsciiTraceHelper ascii;
-    rttStream[nodeId] = ascii.CreateFileStream(rtt_tr_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/RTT",
-                    MakeCallback(&RttTracer));
+    Ptr<Socket> socket = flow->sourceApp->GetSocket();
+    if (flow->sourceHooked || !socket)
+    {
+        return;
+    }
+    flow->sourceHooked = true;
+
+    socket->TraceConnectWithoutContext("CongestionWindow", MakeBoundCallback(&CwndTracer, flow));
+    socket->TraceConnectWithoutContext("SlowStartThreshold",
+                                       MakeBoundCallback(&SsThreshTracer, flow));
+    socket->TraceConnectWithoutContext("RTT", MakeBoundCallback(&RttTracer, flow));
+    socket->TraceConnectWithoutContext("RTO", MakeBoundCallback(&RtoTracer, flow));
+    socket->TraceConnectWithoutContext("NextTxSequence", MakeBoundCallback(&NextTxTracer, flow));
+    socket->TraceConnectWithoutContext("BytesInFlight", MakeBoundCallback(&InFlightTracer, flow));
 }
 
 /**
- * RTO trace connection.
+ * Scheduled at the start time of a sender: StartApplication is already queued
+ * for this instant, so a zero-delay event runs right after it, when the socket
+ * exists and has sent its SYN but before the SYN-ACK brings the first RTT
+ * sample.
  *
- * \param rto_tr_file_name RTO trace file name.
- * \param nodeId Node ID.
+ * \param flow The flow trace state.
  */
 static void
-TraceRto(std::string rto_tr_file_name, uint32_t nodeId)
+SourceStarting(FlowTraceState* flow)
 {
-    AsciiTraceHelper ascii;
-    rtoStream[nodeId] = ascii.CreateFileStream(rto_tr_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/RTO",
-                    MakeCallback(&RtoTracer));
+    Simulator::ScheduleNow(&HookSourceTraces, flow);
 }
 
 /**
- * Next TX trace connection.
+ * Hook the sender socket of a flow on its first transmission, should it not
+ * be hooked yet.
  *
- * \param next_tx_seq_file_name Next TX trace file name.
- * \param nodeId Node ID.
+ * \param flow The flow trace state.
+ * \param packet The packet sent.
  */
 static void
-TraceNextTx(std::string& next_tx_seq_file_name, uint32_t nodeId)
+SourceTxTracer(FlowTraceState* flow, Ptr<const Packet> packet [[maybe_unused]])
 {
-    AsciiTraceHelper ascii;
-    nextTxStream[nodeId] = ascii.CreateFileStream(next_tx_seq_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) +
-                        "/$ns3::TcpL4Protocol/SocketList/0/NextTxSequence",
-                    MakeCallback(&NextTxTracer));
+    HookSourceTraces(flow);
 }
 
 /**
- * In flight trace connection.
+ * Hook the receiver socket of a flow on its first reception.
  *
- * \param in_flight_file_name In flight trace file name.
- * \param nodeId Node ID.
+ * \param flow The flow trace state.
+ * \param packet The packet received.
+ * \param from The sender address.
  */
 static void
-TraceInFlight(std::string& in_flight_file_name, uint32_t nodeId)
+SinkRxTracer(FlowTraceState* flow,
+             Ptr<const Packet> packet [[maybe_unused]],
+             const Address& from [[maybe_unused]])
 {
-    AsciiTraceHelper ascii;
-    inFlightStream[nodeId] = ascii.CreateFileStream(in_flight_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) +
-                        "/$ns3::TcpL4Protocol/SocketList/0/BytesInFlight",
-                    MakeCallback(&InFlightTracer));
-}
+    if (flow->sinkHooked)
+    {
+        return;
+    }
+    flow->sinkHooked = true;
 
-/**
- * Next RX trace connection.
- *
- * \param next_rx_seq_file_name Next RX trace file name.
- * \param nodeId Node ID.
- */
-static void
-TraceNextRx(std::string& next_rx_seq_file_name, uint32_t nodeId)
-{
-    AsciiTraceHelper ascii;
-    nextRxStream[nodeId] = ascii.CreateFileStream(next_rx_seq_file_name);
-    Config::Connect("/NodeList/" + std::to_string(nodeId) +
-                        "/$ns3::TcpL4Protocol/SocketList/1/RxBuffer/NextRxSequence",
-                    MakeCallback(&NextRxTracer));
+    // Each sink application serves exactly one flow, hence one accepted socket.
+    Ptr<TcpSocketBase> socket =
+        DynamicCast<TcpSocketBase>(flow->sinkApp->GetAcceptedSockets().front());
+    socket->GetRxBuffer()->TraceConnectWithoutContext("NextRxSequence",
+                                                      MakeBoundCallback(&NextRxTracer, flow));
 }
 
 int
@@ -340,14 +393,27 @@ main(int argc, char* argv[])
     std::string access_bandwidth = "10Mbps";
     std::string access_delay = "45ms";
     bool tracing = true;
+    std::string trace_format = "ascii";
     std::string prefix_file_name = "TcpVariantsComparison";
     uint64_t data_mbytes = 0;
     uint32_t mtu_bytes = 400;
     uint16_t num_flows = 1;
+    uint16_t flows_per_source = 1;
     double duration = 100.0;
     uint32_t run = 0;
     bool flow_monitor = true;
+    bool compact_flow_monitor = false;
+    std::string summary_file;
+    double sample_interval = 0;
+    std::string sample_file;
+    double converge_tolerance = 0;
+    uint32_t converge_intervals = 10;
+    bool steady_state = false;
+    double steady_interval = 0.1;
+    double steady_precision = 0.05;
+    uint32_t steady_min_batches = 10;
     bool pcap = false;
+    bool pool = false;
     bool sack = true;
     std::string queue_disc_type = "ns3::PfifoFastQueueDisc";
     std::string recovery = "ns3::TcpClassicRecovery";
@@ -365,21 +431,68 @@ main(int argc, char* argv[])
     cmd.AddValue("access_bandwidth", "Access link bandwidth", access_bandwidth);
     cmd.AddValue("access_delay", "Access link delay", access_delay);
     cmd.AddValue("tracing", "Flag to enable/disable tracing", tracing);
+    cmd.AddValue("trace_format",
+                 "Format of the TCP traces: ascii (.data files) or binary (one .btr file)",
+                 trace_format);
     cmd.AddValue("prefix_name", "Prefix of output trace file", prefix_file_name);
     cmd.AddValue("data", "Number of Megabytes of data to transmit", data_mbytes);
     cmd.AddValue("mtu", "Size of IP packets to send in bytes", mtu_bytes);
     cmd.AddValue("num_flows", "Number of flows", num_flows);
+    cmd.AddValue("flows_per_source",
+                 "Number of TCP connections opened by each source",
+                 flows_per_source);
     cmd.AddValue("duration", "Time to allow flows to run in seconds", duration);
     cmd.AddValue("run", "Run index (for setting repeatable seeds)", run);
     cmd.AddValue("flow_monitor", "Enable flow monitor", flow_monitor);
+    cmd.AddValue("simulation_time",
+                 "Simulation time in seconds; the simulation stops 5 s after it",
+                 simulationTime);
+    cmd.AddValue("compact_flow_monitor",
+                 "Use the hash-table flow monitor with bounded per-flow state",
+                 compact_flow_monitor);
+    cmd.AddValue("summary_file",
+                 "Write the per-flow statistics to this file (.csv or .json)",
+                 summary_file);
+    cmd.AddValue("sample_interval",
+                 "Sample the per-flow statistics every this many seconds (0 disables)",
+                 sample_interval);
+    cmd.AddValue("sample_file",
+                 "File receiving the per-flow samples (default <prefix_name>-samples.csv)",
+                 sample_file);
+    cmd.AddValue("converge_tolerance",
+                 "Stop once the aggregate throughput spread is below this fraction (0 disables)",
+                 converge_tolerance);
+    cmd.AddValue("converge_intervals",
+                 "Number of sampling intervals the convergence test looks at",
+                 converge_intervals);
+    cmd.AddValue("steady_state",
+                 "Stop once every flow's goodput is in steady state (simulation_time caps it)",
+                 steady_state);
+    cmd.AddValue("steady_interval", "Goodput sampling interval in seconds", steady_interval);
+    cmd.AddValue("steady_precision",
+                 "Relative half width of the goodput confidence interval",
+                 steady_precision);
+    cmd.AddValue("steady_min_batches",
+                 "Minimum number of MSER-5 batches after the warm-up",
+                 steady_min_batches);
     cmd.AddValue("pcap_tracing", "Enable or disable PCAP tracing", pcap);
     cmd.AddValue("queue_disc_type",
                  "Queue disc type for gateway (e.g. ns3::CoDelQueueDisc)",
                  queue_disc_type);
     cmd.AddValue("sack", "Enable or disable SACK option", sack);
     cmd.AddValue("recovery", "Recovery algorithm type to use (e.g., ns3::TcpPrrRecovery", recovery);
+    cmd.AddValue("pool",
+                 "Serve packets, buffers and queue items from size-class freelists (needs a "
+                 "build with -DNS3_HEAP_HOOKS)",
+                 pool);
     cmd.Parse(argc, argv);
 
+    NS_ABORT_MSG_IF(pool && !heap::ENABLED, "--pool needs a build with -DNS3_HEAP_HOOKS");
+    if (pool && !heap::SetPoolEnabled(true))
+    {
+        std::cout << "Could not reserve the allocation pool, using the heap" << std::endl;
+    }
+
     transport_prot = std::string("ns3::") + transport_prot;
 
     SeedManager::SetSeed(1);
@@ -506,26 +619,40 @@ main(int argc, char* argv[])
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
 
     uint16_t port = 50000;
-    Address sinkLocalAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
-    PacketSinkHelper sinkHelper("ns3::TcpSocketFactory", sinkLocalAddress);
+    uint32_t total_flows = num_flows * flows_per_source;
+
+    // Sized once: the tracers hold pointers into this vector.
+    flowTraces.assign(total_flows, FlowTraceState());
 
     for (uint32_t i = 0; i < sources.GetN(); i++)
     {
-        AddressValue remoteAddress(InetSocketAddress(sink_interfaces.GetAddress(i, 0), port));
-        Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(tcp_adu_size));
-        BulkSendHelper ftp("ns3::TcpSocketFactory", Address());
-        ftp.SetAttribute("Remote", remoteAddress);
-        ftp.SetAttribute("SendSize", UintegerValue(tcp_adu_size));
-        ftp.SetAttribute("MaxBytes", UintegerValue(data_mbytes * 1000000));
-
-        ApplicationContainer sourceApp = ftp.Install(sources.Get(i));
-        sourceApp.Start(Seconds(start_time * i));
-        sourceApp.Stop(Seconds(stop_time - 3));
-
-        sinkHelper.SetAttribute("Protocol", TypeIdValue(TcpSocketFactory::GetTypeId()));
-        ApplicationContainer sinkApp = sinkHelper.Install(sinks.Get(i));
-        sinkApp.Start(Seconds(start_time * i));
-        sinkApp.Stop(Seconds(stop_time));
+        for (uint16_t j = 0; j < flows_per_source; j++)
+        {
+            // One sink application per connection, each on its own port
+            AddressValue remoteAddress(
+                InetSocketAddress(sink_interfaces.GetAddress(i, 0), port + j));
+            Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(tcp_adu_size));
+            BulkSendHelper ftp("ns3::TcpSocketFactory", Address());
+            ftp.SetAttribute("Remote", remoteAddress);
+            ftp.SetAttribute("SendSize", UintegerValue(tcp_adu_size));
+            ftp.SetAttribute("MaxBytes", UintegerValue(data_mbytes * 1000000));
+
+            ApplicationContainer sourceApp = ftp.Install(sources.Get(i));
+            sourceApp.Start(Seconds(start_time * i));
+            sourceApp.Stop(Seconds(stop_time - 3));
+
+            PacketSinkHelper sinkHelper("ns3::TcpSocketFactory",
+                                        InetSocketAddress(Ipv4Address::GetAny(), port + j));
+            sinkHelper.SetAttribute("Protocol", TypeIdValue(TcpSocketFactory::GetTypeId()));
+            ApplicationContainer sinkApp = sinkHelper.Install(sinks.Get(i));
+            sinkApp.Start(Seconds(start_time * i));
+            sinkApp.Stop(Seconds(stop_time));
+
+            FlowTraceState& flow = flowTraces[i * flows_per_source + j];
+            flow.id = i * flows_per_source + j;
+            flow.sourceApp = DynamicCast<BulkSendApplication>(sourceApp.Get(0));
+            flow.sinkApp = DynamicCast<PacketSink>(sinkApp.Get(0));
+        }
     }
 
     // Set up tracing if enabled
@@ -537,47 +664,33 @@ main(int argc, char* argv[])
         ascii_wrap = new OutputStreamWrapper(prefix_file_name + "-ascii", std::ios::out);
         stack.EnableAsciiIpv4All(ascii_wrap);
 
-        for (uint16_t index = 0; index < num_flows; index++)
+        if (trace_format == "binary")
+        {
+            binarySink = Create<BinaryTraceSink>(prefix_file_name + "-tcp.btr");
+        }
+        else if (trace_format != "ascii")
+        {
+            NS_FATAL_ERROR("Trace format not recognized. Allowed values are ascii or binary");
+        }
+
+        // Sockets are created when the applications start.  Senders are hooked
+        // right after their start, so the handshake RTT/RTO samples and the
+        // initial NextTx are traced, with their first Tx as a fallback;
+        // receivers from the first Rx of their application.
+        for (FlowTraceState& flow : flowTraces)
         {
             std::string flowString;
-            if (num_flows > 1)
+            if (total_flows > 1)
             {
-                flowString = "-flow" + std::to_string(index);
+                flowString = "-flow" + std::to_string(flow.id);
             }
-
-            firstCwnd[index + 1] = true;
-            firstSshThr[index + 1] = true;
-            firstRtt[index + 1] = true;
-            firstRto[index + 1] = true;
-
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceCwnd,
-                                prefix_file_name + flowString + "-cwnd.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceSsThresh,
-                                prefix_file_name + flowString + "-ssth.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceRtt,
-                                prefix_file_name + flowString + "-rtt.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceRto,
-                                prefix_file_name + flowString + "-rto.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceNextTx,
-                                prefix_file_name + flowString + "-next-tx.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.00001),
-                                &TraceInFlight,
-                                prefix_file_name + flowString + "-inflight.data",
-                                index + 1);
-            Simulator::Schedule(Seconds(start_time * index + 0.1),
-                                &TraceNextRx,
-                                prefix_file_name + flowString + "-next-rx.data",
-                                num_flows + index + 1);
+            OpenFlowTraces(prefix_file_name + flowString, &flow);
+            Simulator::Schedule(Seconds(start_time * (flow.id / flows_per_source)),
+                                &SourceStarting,
+                                &flow);
+            flow.sourceApp->TraceConnectWithoutContext("Tx",
+                                                       MakeBoundCallback(&SourceTxTracer, &flow));
+            flow.sinkApp->TraceConnectWithoutContext("Rx", MakeBoundCallback(&SinkRxTracer, &flow));
         }
     }
 
@@ -589,39 +702,93 @@ main(int argc, char* argv[])
 
     // Flow monitor
     FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    Ptr<FlowMonitor> monitor;
+    Ptr<CompactFlowMonitor> compactMonitor;
+    if (compact_flow_monitor)
+    {
+        NS_ABORT_MSG_IF(sample_interval > 0, "sample_interval needs the full flow monitor");
+        compactMonitor = Create<CompactFlowMonitor>();
+        compactMonitor->InstallAll();
+    }
+    else if (flow_monitor)
+    {
+        monitor = flowmon.InstallAll();
+    }
+    NS_ABORT_MSG_IF(!monitor && !compactMonitor && !summary_file.empty(),
+                    "--summary_file needs --flow_monitor");
+
+    Ptr<FlowStatsSampler> sampler;
+    if (sample_interval > 0)
+    {
+        NS_ABORT_MSG_UNLESS(monitor, "--sample_interval needs --flow_monitor");
+        if (sample_file.empty())
+        {
+            sample_file = prefix_file_name + "-samples.csv";
+        }
+        sampler = Create<FlowStatsSampler>(monitor, Seconds(sample_interval), sample_file);
+        if (converge_tolerance > 0)
+        {
+            sampler->SetConvergenceStop(converge_tolerance, converge_intervals);
+        }
+        sampler->Start(Seconds(start_time));
+    }
+
+    Ptr<SteadyStateDetector> detector;
+    if (steady_state)
+    {
+        detector = Create<SteadyStateDetector>(Seconds(steady_interval),
+                                               steady_precision,
+                                               steady_min_batches);
+        for (const auto& flow : flowTraces)
+        {
+            detector->AddFlow(flow.sinkApp);
+        }
+        detector->Start(Seconds(start_time));
+    }
 
     Simulator::Stop(Seconds(simulationTime + 5));
-    Simulator::Run();
-
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-
-    for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator iter = stats.begin(); iter != stats.end(); ++iter) {
-        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(iter->first);
-      
-        std::cout << "Flow ID: " << iter->first << " Src Addr " << t.sourceAddress << " Dst Addr " << t.destinationAddress << std::endl;
-        
-        std::cout << "  Tx Packets/Bytes:   " << stats[1].txPackets << " / " << stats[1].txBytes
-              << std::endl;
-   
-        std::cout << "  Rx Packets/Bytes:   " << stats[1].rxPackets << " / " << stats[1].rxBytes
-              << std::endl;
-    
-        std::cout << "  Throughput: "
-              << stats[1].rxBytes * 8.0 /
-                     (stats[1].timeLastRxPacket.GetSeconds() -
-                      stats[1].timeFirstRxPacket.GetSeconds()) /
-                     1000000
-              << " Mbps" << std::endl;
-        std::cout << "  Packets/Bytes Dropped:   " << stats[1].lostPackets
-              << std::endl;
-    
-        std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets
-              << std::endl;
-        std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1)
-              << std::endl;
+    RunWithStats();
+
+    if (pool)
+    {
+        heap::PrintPoolStats(std::cout);
     }
+
+    if (detector)
+    {
+        detector->Print(std::cout);
+    }
+
+    if (binarySink)
+    {
+        binarySink->Flush();
+    }
+    if (sampler)
+    {
+        sampler->Flush();
+    }
+
+    if (monitor || compactMonitor)
+    {
+        FlowReport report;
+        if (compactMonitor)
+        {
+            compactMonitor->PrintMemory(std::cout);
+            compactMonitor->AddFlows(report);
+        }
+        else
+        {
+            Ptr<Ipv4FlowClassifier> classifier =
+                DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+            report.AddFlows(monitor, classifier);
+        }
+        report.Print(std::cout);
+        if (!summary_file.empty())
+        {
+            report.WriteFile(summary_file);
+        }
+    }
+
     Simulator::Destroy();
     return 0;
 }
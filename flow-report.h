@@ -0,0 +1,399 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef FLOW_REPORT_H
+#define FLOW_REPORT_H
+
+#include "ns3/abort.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/nstime.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief End-of-run statistics of one flow.
+ */
+struct FlowSummary
+{
+    FlowId flowId{0};                    //!< Flow ID
+    Ipv4FlowClassifier::FiveTuple tuple; //!< Flow 5-tuple
+    uint8_t tos{0};                      //!< Most frequent ToS byte of the flow
+    uint64_t txPackets{0};               //!< Transmitted packets
+    uint64_t txBytes{0};                 //!< Transmitted bytes
+    uint64_t rxPackets{0};               //!< Received packets
+    uint64_t rxBytes{0};                 //!< Received bytes
+    uint64_t lostPackets{0};             //!< Lost packets
+    Time delaySum;                       //!< Sum of the end-to-end delays
+    Time jitterSum;                      //!< Sum of the delay variations
+    Time timeFirstRxPacket;              //!< First reception
+    Time timeLastRxPacket;               //!< Last reception
+
+    /// \return the goodput over the reception window, in Mbit/s.
+    double GetThroughputMbps() const
+    {
+        double window = (timeLastRxPacket - timeFirstRxPacket).GetSeconds();
+        return window > 0 ? rxBytes * 8.0 / window / 1e6 : 0;
+    }
+
+    /// \return the lost fraction of the transmitted packets.
+    double GetLossRatio() const
+    {
+        return txPackets > 0 ? static_cast<double>(lostPackets) / txPackets : 0;
+    }
+
+    /// \return the mean delay in seconds.
+    double GetMeanDelay() const
+    {
+        return rxPackets > 0 ? delaySum.GetSeconds() / rxPackets : 0;
+    }
+
+    /// \return the mean jitter in seconds.
+    double GetMeanJitter() const
+    {
+        return rxPackets > 1 ? jitterSum.GetSeconds() / (rxPackets - 1) : 0;
+    }
+};
+
+/**
+ * \brief Aggregated statistics of a class of flows.
+ */
+struct FlowClassSummary
+{
+    std::string label;         //!< Class label, e.g. "tos=0xb8" or "src=10.1.1.0/24"
+    uint32_t flows{0};         //!< Number of flows
+    uint64_t txPackets{0};     //!< Transmitted packets
+    uint64_t rxPackets{0};     //!< Received packets
+    uint64_t rxBytes{0};       //!< Received bytes
+    uint64_t lostPackets{0};   //!< Lost packets
+    uint64_t jitterSamples{0}; //!< Number of delay variations
+    double throughputMbps{0};  //!< Sum of the flow throughputs
+    Time delaySum;             //!< Sum of the end-to-end delays
+    Time jitterSum;            //!< Sum of the delay variations
+};
+
+/**
+ * \brief Per-flow FlowMonitor report shared by the lab programs.
+ *
+ * The statistics are copied once, in a single pass over the monitor, into a
+ * flat vector; the monitor's map is only read.  Flows are then aggregated per
+ * ToS and per source subnet, and the report can be printed or written as CSV
+ * or JSON.
+ */
+class FlowReport
+{
+  public:
+    /**
+     * \param subnetPrefixLength Prefix length of the source subnet classes.
+     */
+    explicit FlowReport(uint8_t subnetPrefixLength = 24);
+
+    /**
+     * Collect the statistics of all the flows of a monitor.
+     *
+     * \param monitor The flow monitor.
+     * \param classifier Its IPv4 classifier.
+     */
+    void AddFlows(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier);
+
+    /**
+     * Add one flow.
+     *
+     * \param flow The flow statistics.
+     */
+    void AddFlow(const FlowSummary& flow);
+
+    /// \return the flows, in the order they were added.
+    const std::vector<FlowSummary>& GetFlows() const
+    {
+        return m_flows;
+    }
+
+    /// \return the flows aggregated per ToS.
+    std::vector<FlowClassSummary> GetTosClasses() const;
+
+    /// \return the flows aggregated per source subnet.
+    std::vector<FlowClassSummary> GetSourceSubnetClasses() const;
+
+    /**
+     * Print the per-flow and per-class statistics in human readable form.
+     *
+     * \param os The output stream.
+     */
+    void Print(std::ostream& os) const;
+
+    /**
+     * Write one CSV line per flow, with a header line.
+     *
+     * \param os The output stream.
+     */
+    void WriteCsv(std::ostream& os) const;
+
+    /**
+     * Write the flows and the classes as a JSON document.
+     *
+     * \param os The output stream.
+     */
+    void WriteJson(std::ostream& os) const;
+
+    /**
+     * Write the report to a file, as JSON if the name ends in ".json" and as
+     * CSV otherwise.
+     *
+     * \param fileName The file name.
+     */
+    void WriteFile(const std::string& fileName) const;
+
+  private:
+    /**
+     * \param flow A flow.
+     * \return the source subnet of the flow.
+     */
+    Ipv4Address GetSourceSubnet(const FlowSummary& flow) const;
+
+    /**
+     * Aggregate the flows by key.
+     *
+     * \param key Function giving the class key of a flow.
+     * \param label Function giving the label of a flow's class.
+     * \return the classes, in order of first appearance.
+     */
+    template <typename KEY, typename LABEL>
+    std::vector<FlowClassSummary> Aggregate(KEY key, LABEL label) const;
+
+    /**
+     * Write a list of classes as a JSON array.
+     *
+     * \param os The output stream.
+     * \param classes The classes.
+     */
+    static void WriteJsonClasses(std::ostream& os, const std::vector<FlowClassSummary>& classes);
+
+    Ipv4Mask m_subnetMask;            //!< Mask of the source subnet classes
+    uint8_t m_subnetPrefixLength;     //!< Prefix length of the source subnet classes
+    std::vector<FlowSummary> m_flows; //!< Collected flows
+};
+
+inline FlowReport::FlowReport(uint8_t subnetPrefixLength)
+    : m_subnetMask(("/" + std::to_string(subnetPrefixLength)).c_str()),
+      m_subnetPrefixLength(subnetPrefixLength)
+{
+}
+
+inline void
+FlowReport::AddFlows(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier)
+{
+    const FlowMonitor::FlowStatsContainer& stats = monitor->GetFlowStats();
+    m_flows.reserve(m_flows.size() + stats.size());
+    for (const auto& [id, st] : stats)
+    {
+        FlowSummary flow;
+        flow.flowId = id;
+        flow.tuple = classifier->FindFlow(id);
+        auto dscps = classifier->GetDscpCounts(id);
+        if (!dscps.empty())
+        {
+            flow.tos = static_cast<uint8_t>(dscps.front().first << 2);
+        }
+        flow.txPackets = st.txPackets;
+        flow.txBytes = st.txBytes;
+        flow.rxPackets = st.rxPackets;
+        flow.rxBytes = st.rxBytes;
+        flow.lostPackets = st.lostPackets;
+        flow.delaySum = st.delaySum;
+        flow.jitterSum = st.jitterSum;
+        flow.timeFirstRxPacket = st.timeFirstRxPacket;
+        flow.timeLastRxPacket = st.timeLastRxPacket;
+        m_flows.push_back(flow);
+    }
+}
+
+inline void
+FlowReport::AddFlow(const FlowSummary& flow)
+{
+    m_flows.push_back(flow);
+}
+
+inline Ipv4Address
+FlowReport::GetSourceSubnet(const FlowSummary& flow) const
+{
+    return flow.tuple.sourceAddress.CombineMask(m_subnetMask);
+}
+
+template <typename KEY, typename LABEL>
+std::vector<FlowClassSummary>
+FlowReport::Aggregate(KEY key, LABEL label) const
+{
+    std::vector<FlowClassSummary> classes;
+    std::unordered_map<uint32_t, std::size_t> index;
+    for (const auto& flow : m_flows)
+    {
+        auto [it, inserted] = index.emplace(key(flow), classes.size());
+        if (inserted)
+        {
+            classes.emplace_back();
+            classes.back().label = label(flow);
+        }
+        FlowClassSummary& c = classes[it->second];
+        c.flows++;
+        c.txPackets += flow.txPackets;
+        c.rxPackets += flow.rxPackets;
+        c.rxBytes += flow.rxBytes;
+        c.lostPackets += flow.lostPackets;
+        c.jitterSamples += flow.rxPackets > 1 ? flow.rxPackets - 1 : 0;
+        c.throughputMbps += flow.GetThroughputMbps();
+        c.delaySum += flow.delaySum;
+        c.jitterSum += flow.jitterSum;
+    }
+    return classes;
+}
+
+inline std::vector<FlowClassSummary>
+FlowReport::GetTosClasses() const
+{
+    return Aggregate([](const FlowSummary& f) { return f.tos; },
+                     [](const FlowSummary& f) {
+                         std::ostringstream oss;
+                         oss << "tos=0x" << std::hex << +f.tos;
+                         return oss.str();
+                     });
+}
+
+inline std::vector<FlowClassSummary>
+FlowReport::GetSourceSubnetClasses() const
+{
+    return Aggregate([this](const FlowSummary& f) { return GetSourceSubnet(f).Get(); },
+                     [this](const FlowSummary& f) {
+                         std::ostringstream oss;
+                         oss << "src=" << GetSourceSubnet(f) << "/" << +m_subnetPrefixLength;
+                         return oss.str();
+                     });
+}
+
+inline void
+FlowReport::Print(std::ostream& os) const
+{
+    os << std::endl << "*** Flow monitor statistics ***" << std::endl;
+    for (const auto& flow : m_flows)
+    {
+        os << "Flow ID: " << flow.flowId << " Src Addr " << flow.tuple.sourceAddress
+           << " Dst Addr " << flow.tuple.destinationAddress << std::endl;
+        os << "  Tx Packets/Bytes:   " << flow.txPackets << " / " << flow.txBytes << std::endl;
+        os << "  Rx Packets/Bytes:   " << flow.rxPackets << " / " << flow.rxBytes << std::endl;
+        os << "  Throughput: " << flow.GetThroughputMbps() << " Mbps" << std::endl;
+        os << "  Packets Dropped:   " << flow.lostPackets << std::endl;
+        os << "  Mean delay:   " << flow.GetMeanDelay() << std::endl;
+        os << "  Mean jitter:   " << flow.GetMeanJitter() << std::endl;
+    }
+
+    for (const auto& classes : {GetTosClasses(), GetSourceSubnetClasses()})
+    {
+        if (classes.size() < 2)
+        {
+            continue;
+        }
+        for (const auto& c : classes)
+        {
+            os << c.label << ": " << c.flows << " flows, " << c.throughputMbps << " Mbps, "
+               << c.lostPackets << " lost, mean delay "
+               << (c.rxPackets > 0 ? c.delaySum.GetSeconds() / c.rxPackets : 0)
+               << ", mean jitter "
+               << (c.jitterSamples > 0 ? c.jitterSum.GetSeconds() / c.jitterSamples : 0)
+               << std::endl;
+        }
+    }
+}
+
+inline void
+FlowReport::WriteCsv(std::ostream& os) const
+{
+    os << "flow_id,src_addr,dst_addr,src_port,dst_port,protocol,tos,src_subnet,tx_packets,"
+          "tx_bytes,rx_packets,rx_bytes,lost_packets,loss_ratio,throughput_mbps,mean_delay_s,"
+          "mean_jitter_s\n";
+    for (const auto& flow : m_flows)
+    {
+        os << flow.flowId << "," << flow.tuple.sourceAddress << ","
+           << flow.tuple.destinationAddress << "," << flow.tuple.sourcePort << ","
+           << flow.tuple.destinationPort << "," << +flow.tuple.protocol << "," << +flow.tos
+           << "," << GetSourceSubnet(flow) << "/" << +m_subnetPrefixLength << ","
+           << flow.txPackets << "," << flow.txBytes << "," << flow.rxPackets << ","
+           << flow.rxBytes << "," << flow.lostPackets << "," << flow.GetLossRatio() << ","
+           << flow.GetThroughputMbps() << "," << flow.GetMeanDelay() << ","
+           << flow.GetMeanJitter() << "\n";
+    }
+}
+
+inline void
+FlowReport::WriteJsonClasses(std::ostream& os, const std::vector<FlowClassSummary>& classes)
+{
+    os << "[";
+    for (std::size_t i = 0; i < classes.size(); i++)
+    {
+        const FlowClassSummary& c = classes[i];
+        os << (i ? ",\n    " : "\n    ") << "{\"class\": \"" << c.label
+           << "\", \"flows\": " << c.flows << ", \"tx_packets\": " << c.txPackets
+           << ", \"rx_packets\": " << c.rxPackets << ", \"rx_bytes\": " << c.rxBytes
+           << ", \"lost_packets\": " << c.lostPackets
+           << ", \"throughput_mbps\": " << c.throughputMbps << ", \"mean_delay_s\": "
+           << (c.rxPackets > 0 ? c.delaySum.GetSeconds() / c.rxPackets : 0)
+           << ", \"mean_jitter_s\": "
+           << (c.jitterSamples > 0 ? c.jitterSum.GetSeconds() / c.jitterSamples : 0) << "}";
+    }
+    os << "\n  ]";
+}
+
+inline void
+FlowReport::WriteJson(std::ostream& os) const
+{
+    os << "{\n  \"flows\": [";
+    for (std::size_t i = 0; i < m_flows.size(); i++)
+    {
+        const FlowSummary& flow = m_flows[i];
+        os << (i ? ",\n    " : "\n    ") << "{\"flow_id\": " << flow.flowId
+           << ", \"src_addr\": \"" << flow.tuple.sourceAddress << "\", \"dst_addr\": \""
+           << flow.tuple.destinationAddress << "\", \"src_port\": " << flow.tuple.sourcePort
+           << ", \"dst_port\": " << flow.tuple.destinationPort
+           << ", \"protocol\": " << +flow.tuple.protocol << ", \"tos\": " << +flow.tos
+           << ", \"tx_packets\": " << flow.txPackets << ", \"tx_bytes\": " << flow.txBytes
+           << ", \"rx_packets\": " << flow.rxPackets << ", \"rx_bytes\": " << flow.rxBytes
+           << ", \"lost_packets\": " << flow.lostPackets
+           << ", \"throughput_mbps\": " << flow.GetThroughputMbps()
+           << ", \"mean_delay_s\": " << flow.GetMeanDelay()
+           << ", \"mean_jitter_s\": " << flow.GetMeanJitter() << "}";
+    }
+    os << "\n  ],\n  \"by_tos\": ";
+    WriteJsonClasses(os, GetTosClasses());
+    os << ",\n  \"by_src_subnet\": ";
+    WriteJsonClasses(os, GetSourceSubnetClasses());
+    os << "\n}\n";
+}
+
+inline void
+FlowReport::WriteFile(const std::string& fileName) const
+{
+    std::ofstream out(fileName);
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open flow report file " << fileName);
+    const std::string json = ".json";
+    if (fileName.size() >= json.size() &&
+        fileName.compare(fileName.size() - json.size(), json.size(), json) == 0)
+    {
+        WriteJson(out);
+    }
+    else
+    {
+        WriteCsv(out);
+    }
+}
+
+} // namespace ns3
+
+#endif /* FLOW_REPORT_H */
@@ -0,0 +1,237 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef FLOW_SAMPLER_H
+#define FLOW_SAMPLER_H
+
+#include "ns3/abort.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Per-flow FlowMonitor deltas over one sampling interval.
+ */
+struct FlowSample
+{
+    Time time;               //!< End of the interval
+    FlowId flowId{0};        //!< Flow ID
+    uint64_t rxBytes{0};     //!< Bytes received in the interval
+    uint32_t rxPackets{0};   //!< Packets received in the interval
+    uint32_t lostPackets{0}; //!< Packets declared lost in the interval
+    Time delaySum;           //!< Sum of the delays of the packets received in the interval
+};
+
+/**
+ * \brief Periodic sampler of the FlowMonitor statistics.
+ *
+ * Every interval the sampler snapshots the rx bytes, rx packets, lost packets
+ * and delay sum of each flow, and appends the deltas since the previous
+ * snapshot to a fixed-size ring buffer.  The ring is written to the output file
+ * in one batch whenever it fills up, and when the sampler is flushed.
+ *
+ * Optionally, the sampler stops the simulation once the aggregate throughput
+ * of the last few intervals stays within a relative tolerance of its mean.
+ */
+class FlowStatsSampler : public SimpleRefCount<FlowStatsSampler>
+{
+  public:
+    /**
+     * \param monitor The flow monitor to sample.
+     * \param interval The sampling interval.
+     * \param fileName Output file, one CSV line per flow and interval.
+     * \param ringSize Number of samples buffered before a batch is written.
+     */
+    FlowStatsSampler(Ptr<FlowMonitor> monitor,
+                     Time interval,
+                     const std::string& fileName,
+                     uint32_t ringSize = 4096);
+    ~FlowStatsSampler();
+
+    /**
+     * Start sampling.
+     *
+     * \param start Time of the first snapshot, from which deltas are taken.
+     */
+    void Start(Time start);
+
+    /**
+     * Stop the simulation once the aggregate throughput has converged.
+     *
+     * \param tolerance Maximum (max - min) / mean of the aggregate throughput.
+     * \param intervals Number of consecutive intervals the criterion applies to.
+     */
+    void SetConvergenceStop(double tolerance, uint32_t intervals);
+
+    /// \return the aggregate throughput of the last interval, in Mbit/s.
+    double GetLastThroughputMbps() const
+    {
+        return m_history.empty() ? 0 : m_history.back();
+    }
+
+    /// Write the buffered samples to the file.
+    void Flush();
+
+  private:
+    /// Take a snapshot and schedule the next one.
+    void Sample();
+
+    /**
+     * Append a sample to the ring, writing the ring out when it is full.
+     *
+     * \param sample The sample.
+     */
+    void Push(const FlowSample& sample);
+
+    /// Previous snapshot of one flow.
+    struct Snapshot
+    {
+        uint64_t rxBytes{0};     //!< Received bytes
+        uint32_t rxPackets{0};   //!< Received packets
+        uint32_t lostPackets{0}; //!< Lost packets
+        Time delaySum;           //!< Delay sum
+    };
+
+    Ptr<FlowMonitor> m_monitor;     //!< Sampled monitor
+    Time m_interval;                //!< Sampling interval
+    std::ofstream m_file;           //!< Output file
+    std::vector<FlowSample> m_ring; //!< Ring of pending samples
+    std::size_t m_head{0};          //!< Index of the oldest pending sample
+    std::size_t m_count{0};         //!< Number of pending samples
+    std::vector<Snapshot> m_last;   //!< Previous snapshots, indexed by flow ID
+    std::deque<double> m_history;   //!< Aggregate throughput of the recent intervals (Mbit/s)
+    double m_tolerance{0};          //!< Convergence tolerance (0 disables the stop)
+    uint32_t m_intervals{0};        //!< Intervals considered for convergence
+};
+
+inline FlowStatsSampler::FlowStatsSampler(Ptr<FlowMonitor> monitor,
+                                          Time interval,
+                                          const std::string& fileName,
+                                          uint32_t ringSize)
+    : m_monitor(monitor),
+      m_interval(interval),
+      m_ring(ringSize)
+{
+    NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(), "Sampling interval must be positive");
+    NS_ABORT_MSG_IF(ringSize == 0, "Ring size must be positive");
+    m_file.open(fileName);
+    NS_ABORT_MSG_UNLESS(m_file.is_open(), "Cannot open sample file " << fileName);
+    m_file << "time_s,flow_id,rx_bytes,rx_packets,lost_packets,throughput_mbps,mean_delay_s\n";
+}
+
+inline FlowStatsSampler::~FlowStatsSampler()
+{
+    Flush();
+}
+
+inline void
+FlowStatsSampler::Start(Time start)
+{
+    Simulator::Schedule(start, &FlowStatsSampler::Sample, this);
+}
+
+inline void
+FlowStatsSampler::SetConvergenceStop(double tolerance, uint32_t intervals)
+{
+    NS_ABORT_MSG_IF(intervals < 2, "Convergence needs at least two intervals");
+    m_tolerance = tolerance;
+    m_intervals = intervals;
+}
+
+inline void
+FlowStatsSampler::Sample()
+{
+    m_monitor->CheckForLostPackets();
+    const FlowMonitor::FlowStatsContainer& stats = m_monitor->GetFlowStats();
+
+    double seconds = m_interval.GetSeconds();
+    uint64_t totalRxBytes = 0;
+    for (const auto& [id, st] : stats)
+    {
+        if (id >= m_last.size())
+        {
+            m_last.resize(id + 1);
+        }
+        Snapshot& last = m_last[id];
+
+        FlowSample sample;
+        sample.time = Simulator::Now();
+        sample.flowId = id;
+        sample.rxBytes = st.rxBytes - last.rxBytes;
+        sample.rxPackets = st.rxPackets - last.rxPackets;
+        sample.lostPackets = st.lostPackets - last.lostPackets;
+        sample.delaySum = st.delaySum - last.delaySum;
+        Push(sample);
+        totalRxBytes += sample.rxBytes;
+
+        last.rxBytes = st.rxBytes;
+        last.rxPackets = st.rxPackets;
+        last.lostPackets = st.lostPackets;
+        last.delaySum = st.delaySum;
+    }
+
+    m_history.push_back(totalRxBytes * 8.0 / seconds / 1e6);
+    if (m_history.size() > std::max<uint32_t>(m_intervals, 1))
+    {
+        m_history.pop_front();
+    }
+
+    if (m_tolerance > 0 && m_history.size() == m_intervals)
+    {
+        auto [min, max] = std::minmax_element(m_history.begin(), m_history.end());
+        double mean = 0;
+        for (double t : m_history)
+        {
+            mean += t / m_history.size();
+        }
+        if (mean > 0 && (*max - *min) / mean <= m_tolerance)
+        {
+            Flush();
+            Simulator::Stop();
+            return;
+        }
+    }
+
+    Simulator::Schedule(m_interval, &FlowStatsSampler::Sample, this);
+}
+
+inline void
+FlowStatsSampler::Push(const FlowSample& sample)
+{
+    if (m_count == m_ring.size())
+    {
+        Flush();
+    }
+    m_ring[(m_head + m_count) % m_ring.size()] = sample;
+    m_count++;
+}
+
+inline void
+FlowStatsSampler::Flush()
+{
+    double seconds = m_interval.GetSeconds();
+    for (; m_count > 0; m_count--)
+    {
+        const FlowSample& s = m_ring[m_head];
+        m_file << s.time.GetSeconds() << "," << s.flowId << "," << s.rxBytes << "," << s.rxPackets
+               << "," << s.lostPackets << "," << s.rxBytes * 8.0 / seconds / 1e6 << ","
+               << (s.rxPackets > 0 ? s.delaySum.GetSeconds() / s.rxPackets : 0) << "\n";
+        m_head = (m_head + 1) % m_ring.size();
+    }
+    m_file.flush();
+}
+
+} // namespace ns3
+
+#endif /* FLOW_SAMPLER_H */
@@ -38,6 +38,10 @@
 // tcpdump -r wifi-simple-adhoc-0-0.pcap -nn -tt
 //
 
+#include "flow-report.h"
+#include "matrix-propagation-loss-model.h"
+#include "spatial-wifi-channel.h"
+
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/double.h"
@@ -69,6 +73,10 @@ main(int argc, char* argv[])
     uint32_t numPackets{1};
     Time interPacketInterval{"1s"};
     bool verbose{false};
+    std::string flowReport;
+    bool spatialChannel{false};
+    double maxRange{0}; // meters, 0 = derive from the loss model
+    bool lossMatrix{false};
    double simulationTime = 10; // seconds
     std::string transportProt = "Udp";
     std::string socketType;
@@ -91,6 +99,16 @@ main(int argc, char* argv[])
     cmd.AddValue("numPackets", "number of packets generated", numPackets);
     cmd.AddValue("interval", "interval between packets", interPacketInterval);
     cmd.AddValue("verbose", "turn on all WifiNetDevice log components", verbose);
+    cmd.AddValue("flowReport", "Write the flow report to this file (.csv or .json)", flowReport);
+    cmd.AddValue("spatialChannel",
+                 "Use a grid-indexed channel delivering only to receivers in range",
+                 spatialChannel);
+    cmd.AddValue("maxRange",
+                 "Cutoff range of the spatial channel in meters (0 = from the loss model)",
+                 maxRange);
+    cmd.AddValue("lossMatrix",
+                 "Precompute the loss between static nodes once and look it up per packet",
+                 lossMatrix);
     cmd.Parse(argc, argv);
 
     // Fix non-unicast data rate to be the same as that of unicast
@@ -107,7 +125,9 @@ main(int argc, char* argv[])
     }
     wifi.SetStandard(WIFI_STANDARD_80211b);
 
-    YansWifiPhyHelper wifiPhy;
+    YansWifiPhyHelper yansPhy;
+    SpatialYansWifiPhyHelper spatialPhy;
+    YansWifiPhyHelper& wifiPhy = spatialChannel ? spatialPhy : yansPhy;
     // This is one parameter that matters when using FixedRssLossModel
     // set it to zero; otherwise, gain will be added
     wifiPhy.Set("RxGain", DoubleValue(0));
@@ -119,7 +139,23 @@ main(int argc, char* argv[])
     // The below FixedRssLossModel will cause the rss to be fixed regardless
     // of the distance between the two stations, and the transmit power
     wifiChannel.AddPropagationLoss("ns3::FixedRssLossModel", "Rss", DoubleValue(rss));
-    wifiPhy.SetChannel(wifiChannel.Create());
+    Ptr<YansWifiChannel> yansChannel;
+    if (spatialChannel)
+    {
+        // FixedRss never fades below sensitivity, so without a maxRange every node stays a
+        // candidate; only the sensitivity test is saved
+        yansChannel = SpatialYansWifiChannel::FromHelper(wifiChannel, maxRange);
+    }
+    else
+    {
+        yansChannel = wifiChannel.Create();
+    }
+    Ptr<MatrixPropagationLossModel> matrix;
+    if (lossMatrix)
+    {
+        matrix = MatrixPropagationLossModel::Install(yansChannel);
+    }
+    wifiPhy.SetChannel(yansChannel);
 
     // Add a mac and disable rate control
     WifiMacHelper wifiMac;
@@ -182,27 +218,18 @@ main(int argc, char* argv[])
     Simulator::Run();
 
     Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-    std::cout << std::endl << "* Flow monitor statistics *" << std::endl;
-    std::cout << "  Tx Packets/Bytes:   " << stats[1].txPackets << " / " << stats[1].txBytes
-              << std::endl;
-   
-    std::cout << "  Rx Packets/Bytes:   " << stats[1].rxPackets << " / " << stats[1].rxBytes
-              << std::endl;
-     
-    std::cout << "  Dropped Packets/Bytes:   " << stats[1].lostPackets   << std::endl;
- 
-    std::cout << "  Throughput: "
-              << stats[1].rxBytes * 8.0 /
-                     (stats[1].timeLastRxPacket.GetSeconds() -
-                      stats[1].timeFirstRxPacket.GetSeconds()) /
-                     1000000
-              << " Mbps" << std::endl;
-    std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets
-              << std::endl;
-    std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1)
-              << std::endl;
-   
+    FlowReport report;
+    report.AddFlows(monitor, classifier);
+    report.Print(std::cout);
+    if (matrix)
+    {
+        std::cout << "Loss matrix: " << matrix->GetSize() << " nodes, " << matrix->GetHits()
+                  << " lookups, " << matrix->GetMisses() << " live computations" << std::endl;
+    }
+    if (!flowReport.empty())
+    {
+        report.WriteFile(flowReport);
+    }
 
     Simulator::Destroy();
 
@@ -0,0 +1,335 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef HEAP_HOOKS_H
+#define HEAP_HOOKS_H
+
+// Replacement of the global operator new/delete that counts the allocations
+// of the calling thread, and can serve small allocations from size-class
+// freelists.  It is compiled in only when NS3_HEAP_HOOKS is defined, e.g.
+// with CXXFLAGS="-DNS3_HEAP_HOOKS" ./ns3 configure, so that normal builds
+// keep the standard allocator; without it the counters stay at zero and the
+// pool cannot be enabled.  Replacement functions cannot be inline, so this
+// header must be included by exactly one translation unit of a program; the
+// scratch programs are a single file, which is where it belongs.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <sys/mman.h>
+
+namespace ns3
+{
+namespace heap
+{
+
+/**
+ * \brief Allocation counters of one thread.
+ */
+struct Counters
+{
+    uint64_t allocations{0}; //!< Number of operator new calls
+    uint64_t bytes{0};       //!< Bytes requested from operator new
+    uint64_t poolHits{0};    //!< Allocations served from a freelist
+    uint64_t poolCarves{0};  //!< Allocations carved from a fresh slab
+};
+
+/// Counters of the current thread.
+inline thread_local Counters counters;
+
+#ifdef NS3_HEAP_HOOKS
+/// Whether the counting operator new is compiled in.
+inline constexpr bool ENABLED = true;
+
+// The pool serves every allocation up to MAX_POOLED bytes, which covers the
+// per-packet objects of the forwarding path: Packet, its Buffer data and tag
+// and metadata lists, and the QueueItem / QueueDiscItem wrappers.  ns-3
+// allocates them all through the global operator new, so pooling by size
+// class here reaches them without touching the library.
+//
+// Pooled blocks live in one reserved virtual range cut into SLAB_SIZE slabs,
+// each holding blocks of a single size class; operator delete recognises a
+// pooled block by its address and finds its class from the slab, so blocks
+// carry no header.  Freed blocks go on the freelist of the freeing thread.
+// The classes are generic sizes, not per-type pools: objects of different
+// types but similar size share a freelist.
+
+constexpr std::size_t MAX_POOLED = 4096;                //!< Largest pooled allocation
+constexpr std::size_t SLAB_SIZE = 64 * 1024;            //!< Bytes per slab
+constexpr std::size_t ARENA_SIZE = 16ULL << 30;         //!< Reserved virtual range
+constexpr std::size_t N_SLABS = ARENA_SIZE / SLAB_SIZE; //!< Slabs in the range
+constexpr std::size_t N_CLASSES = 32 + 14;              //!< 16 B steps to 512, 256 B to 4096
+
+/**
+ * \param size Requested size, at most MAX_POOLED.
+ * \return its size class.
+ */
+constexpr std::size_t
+SizeClass(std::size_t size)
+{
+    return size <= 512 ? (size + 15) / 16 - (size > 0) : 31 + (size - 512 + 255) / 256;
+}
+
+/**
+ * \param sizeClass A size class.
+ * \return the block size of the class.
+ */
+constexpr std::size_t
+ClassSize(std::size_t sizeClass)
+{
+    return sizeClass < 32 ? (sizeClass + 1) * 16 : 512 + (sizeClass - 31) * 256;
+}
+
+/// The reserved range shared by all threads.
+struct Arena
+{
+    char* base{nullptr};                  //!< Start of the range, nullptr until enabled
+    std::atomic<std::size_t> nextSlab{0}; //!< Next slab never handed out
+    uint8_t slabClass[N_SLABS]{};         //!< Size class of each handed-out slab
+    std::atomic<bool> enabled{false};     //!< Whether new allocations are pooled
+};
+
+/// The arena; zero-initialised static storage, usable before any constructor runs.
+inline Arena arena;
+
+/// Freelists and slab cursors of one thread.
+struct Pool
+{
+    void* freeList[N_CLASSES]{};  //!< Freed blocks of each class
+    char* cursor[N_CLASSES]{};    //!< Next uncarved block of the current slab
+    char* slabEnd[N_CLASSES]{};   //!< End of the current slab
+    uint64_t hits[N_CLASSES]{};   //!< Freelist allocations per class
+    uint64_t carves[N_CLASSES]{}; //!< Slab allocations per class
+};
+
+/// Pool of the current thread.
+inline thread_local Pool pool;
+
+/**
+ * Turn pooling of new allocations on or off.  Blocks already pooled keep returning
+ * to their freelists after it is turned off.
+ *
+ * \param enable Whether to pool.
+ * \return false if the arena could not be reserved.
+ */
+inline bool
+SetPoolEnabled(bool enable)
+{
+    if (enable && arena.base == nullptr)
+    {
+        void* base = mmap(nullptr,
+                          ARENA_SIZE,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1,
+                          0);
+        if (base == MAP_FAILED)
+        {
+            return false;
+        }
+        arena.base = static_cast<char*>(base);
+    }
+    arena.enabled.store(enable, std::memory_order_release);
+    return true;
+}
+
+/**
+ * \param sizeClass A size class.
+ * \return a block carved from the slab of the class, nullptr if the arena is exhausted.
+ */
+inline void*
+Carve(std::size_t sizeClass)
+{
+    std::size_t size = ClassSize(sizeClass);
+    if (pool.cursor[sizeClass] + size > pool.slabEnd[sizeClass])
+    {
+        std::size_t slab = arena.nextSlab.fetch_add(1, std::memory_order_relaxed);
+        if (slab >= N_SLABS)
+        {
+            return nullptr;
+        }
+        arena.slabClass[slab] = sizeClass;
+        pool.cursor[sizeClass] = arena.base + slab * SLAB_SIZE;
+        pool.slabEnd[sizeClass] = pool.cursor[sizeClass] + SLAB_SIZE;
+    }
+    void* p = pool.cursor[sizeClass];
+    pool.cursor[sizeClass] += size;
+    pool.carves[sizeClass]++;
+    counters.poolCarves++;
+    return p;
+}
+
+/**
+ * Allocate and count.
+ *
+ * \param size Requested size.
+ * \return the memory, or nullptr.
+ */
+inline void*
+Allocate(std::size_t size) noexcept
+{
+    counters.allocations++;
+    counters.bytes += size;
+    if (size <= MAX_POOLED && arena.enabled.load(std::memory_order_relaxed))
+    {
+        std::size_t sizeClass = SizeClass(size);
+        if (void* p = pool.freeList[sizeClass])
+        {
+            pool.freeList[sizeClass] = *static_cast<void**>(p);
+            pool.hits[sizeClass]++;
+            counters.poolHits++;
+            return p;
+        }
+        if (void* p = Carve(sizeClass))
+        {
+            return p;
+        }
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+/**
+ * Release memory from Allocate.
+ *
+ * \param p The memory, or nullptr.
+ */
+inline void
+Deallocate(void* p) noexcept
+{
+    char* c = static_cast<char*>(p);
+    if (arena.base != nullptr && c >= arena.base && c < arena.base + ARENA_SIZE)
+    {
+        std::size_t sizeClass = arena.slabClass[(c - arena.base) / SLAB_SIZE];
+        *static_cast<void**>(p) = pool.freeList[sizeClass];
+        pool.freeList[sizeClass] = p;
+        return;
+    }
+    std::free(p);
+}
+
+/**
+ * Print the pool activity of the calling thread, one line per size class used.
+ * The scratch programs run the simulation on their main thread, which is
+ * where this is called from.
+ *
+ * \param os Output stream.
+ */
+inline void
+PrintPoolStats(std::ostream& os)
+{
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "Allocation pool, this thread:\n";
+    os << std::setw(8) << "class" << std::setw(14) << "hits" << std::setw(12) << "carved"
+       << std::setw(10) << "hit%"
+       << "\n";
+    for (std::size_t i = 0; i < N_CLASSES; ++i)
+    {
+        uint64_t total = pool.hits[i] + pool.carves[i];
+        if (total > 0)
+        {
+            os << std::setw(8) << ClassSize(i) << std::setw(14) << pool.hits[i] << std::setw(12)
+               << pool.carves[i] << std::setw(10) << std::fixed << std::setprecision(2)
+               << 100.0 * pool.hits[i] / total << "\n";
+        }
+    }
+    uint64_t pooled = counters.poolHits + counters.poolCarves;
+    os << "this thread pooled " << pooled << " of " << counters.allocations
+       << " allocations; all threads used " << arena.nextSlab.load() << " slabs of "
+       << SLAB_SIZE / 1024 << " KB\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+#else
+/// Whether the counting operator new is compiled in.
+inline constexpr bool ENABLED = false;
+
+/**
+ * The pool needs the operator new replacement.
+ *
+ * \param enable Whether to pool.
+ * \return false if pooling was requested.
+ */
+inline bool
+SetPoolEnabled(bool enable)
+{
+    return !enable;
+}
+
+/**
+ * Report that the pool is not compiled in.
+ *
+ * \param os Output stream.
+ */
+inline void
+PrintPoolStats(std::ostream& os)
+{
+    os << "No allocation pool: build with -DNS3_HEAP_HOOKS\n";
+}
+#endif /* NS3_HEAP_HOOKS */
+
+} // namespace heap
+} // namespace ns3
+
+#ifdef NS3_HEAP_HOOKS
+
+void*
+operator new(std::size_t size)
+{
+    void* p = ns3::heap::Allocate(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void*
+operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ns3::heap::Allocate(size);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ns3::heap::Allocate(size);
+}
+
+void
+operator delete(void* p) noexcept
+{
+    ns3::heap::Deallocate(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+    ns3::heap::Deallocate(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    ns3::heap::Deallocate(p);
+}
+
+void
+operator delete[](void* p, std::size_t) noexcept
+{
+    ns3::heap::Deallocate(p);
+}
+
+#endif /* NS3_HEAP_HOOKS */
+
+#endif /* HEAP_HOOKS_H */
@@ -7,6 +7,13 @@
  * Author: Stefano Avallone <stefano.avallone@unina.it>
  */
 
+#include "compact-routing.h"
+#include "flow-report.h"
+#include "heap-hooks.h"
+#include "ladder-scheduler.h"
+#include "run-stats.h"
+#include "topology-builder.h"
+
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/flow-monitor-module.h"
@@ -94,13 +101,35 @@ main(int argc, char* argv[])
 {
     double simulationTime = 10; // simulation time in seconds
     std::string transportProt = "Udp"; //tcp or udp
+    std::string flowReport;
+    std::string edgeList;
+    bool compactRouting = false;
+    bool pool = false;
     {
     std::string socketType;
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("transportProt", "Transport protocol to use: Tcp, Udp", transportProt);
+    cmd.AddValue("edgeList",
+                 "Edge list file replacing the five-node mesh (traffic goes from node 0 to the "
+                 "last node)",
+                 edgeList);
+    cmd.AddValue("compactRouting",
+                 "Route with precomputed all-pairs next hops instead of global routing",
+                 compactRouting);
+    cmd.AddValue("flowReport", "Write the flow report to this file (.csv or .json)", flowReport);
+    cmd.AddValue("pool",
+                 "Serve packets, buffers and queue items from size-class freelists (needs a "
+                 "build with -DNS3_HEAP_HOOKS)",
+                 pool);
     cmd.Parse(argc, argv);
 
+    NS_ABORT_MSG_IF(pool && !heap::ENABLED, "--pool needs a build with -DNS3_HEAP_HOOKS");
+    if (pool && !heap::SetPoolEnabled(true))
+    {
+        std::cout << "Could not reserve the allocation pool, using the heap" << std::endl;
+    }
+
     if (transportProt == "Tcp") {
         socketType = "ns3::TcpSocketFactory";
     }
@@ -109,71 +138,53 @@ main(int argc, char* argv[])
         socketType = "ns3::UdpSocketFactory";
     }
 
-    NodeContainer nodes;
-    nodes.Create(5);
-
-    PointToPointHelper pointToPoint;
-    pointToPoint.SetDeviceAttribute("DataRate", StringValue("30Mbps")); //bandwidth change from 5, 15, 30
-    pointToPoint.SetChannelAttribute("Delay", StringValue("2ms")); //delay
-    pointToPoint.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue("10p"));
+    LinkAttributes link;
+    link.dataRate = "30Mbps"; //bandwidth change from 5, 15, 30
+    link.delay = "2ms"; //delay
+    link.queueSize = "10p";
 
-    //node connectivity
-    NetDeviceContainer devices01;
-    devices01 = pointToPoint.Install(nodes.Get(0), nodes.Get(1));
-    
-    NetDeviceContainer devices12;
-    devices12 = pointToPoint.Install(nodes.Get(1), nodes.Get(2));
-    
-    NetDeviceContainer devices02;
-    devices02 = pointToPoint.Install(nodes.Get(0), nodes.Get(2));
-    
-    NetDeviceContainer devices13;
-    devices13 = pointToPoint.Install(nodes.Get(1), nodes.Get(3));
-    
-    NetDeviceContainer devices34;
-    devices34 = pointToPoint.Install(nodes.Get(3), nodes.Get(4));
-    
-      
-    NetDeviceContainer devices24;
-    devices24= pointToPoint.Install(nodes.Get(2), nodes.Get(4));
+    //node connectivity: five-node mesh unless an edge list is given
+    Topology topology;
+    if (edgeList.empty())
+    {
+        topology.AddLink(link);
+        topology.AddEdge(0, 1);
+        topology.AddEdge(1, 2);
+        topology.AddEdge(0, 2);
+        topology.AddEdge(1, 3);
+        topology.AddEdge(3, 4);
+        topology.AddEdge(2, 4);
+    }
+    else
+    {
+        topology = Topology::FromEdgeList(edgeList, link);
+    }
 
-    InternetStackHelper stack;
-    stack.Install(nodes);
-    
-    //Node interfaces and node address declaration
-    Ipv4AddressHelper address01;
-    address01.SetBase("10.1.1.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces01 = address01.Assign(devices01);
-    
-    Ipv4AddressHelper address12;
-    address12.SetBase("10.1.2.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces12 = address12.Assign(devices12);
-    
-    Ipv4AddressHelper address02;
-    address02.SetBase("10.1.3.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces02 = address02.Assign(devices02);
-    
-    Ipv4AddressHelper address13;
-    address13.SetBase("10.1.4.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces13 = address13.Assign(devices13);
-     
-     Ipv4AddressHelper address34;
-     address34.SetBase("10.1.5.0", "255.255.255.0");
-     Ipv4InterfaceContainer interfaces34 = address34.Assign(devices34);
-     
-    Ipv4AddressHelper address24;
-    address24.SetBase("10.1.6.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces24 = address24.Assign(devices24);
+    //Node interfaces and node address declaration: one /30 per link
+    TopologyHelper topologyHelper;
+    if (compactRouting)
+    {
+        Ipv4ListRoutingHelper list;
+        list.Add(Ipv4StaticRoutingHelper(), 0);
+        list.Add(CompactRoutingHelper(topology, topologyHelper.GetBase()), -10);
+        InternetStackHelper stack;
+        stack.SetRoutingHelper(list);
+        topologyHelper.SetStackHelper(stack);
+    }
+    NodeContainer nodes = topologyHelper.Install(topology);
+    uint32_t destination = nodes.GetN() - 1;
 
-    
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    if (!compactRouting)
+    {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    }
 
 
     // Flow
     uint16_t port = 7;
     Address localAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
     PacketSinkHelper packetSinkHelper(socketType, localAddress);
-    ApplicationContainer sinkApp = packetSinkHelper.Install(nodes.Get(4)); //4-destiation node
+    ApplicationContainer sinkApp = packetSinkHelper.Install(nodes.Get(destination));
 
     sinkApp.Start(Seconds(0.0));
     sinkApp.Stop(Seconds(simulationTime + 0.1));
@@ -187,7 +198,7 @@ main(int argc, char* argv[])
     onoff.SetAttribute("DataRate", StringValue("50Mbps")); // dataraate
     ApplicationContainer apps;
 
-    InetSocketAddress rmt(interfaces34.GetAddress(1), port); //34: interface - destination & 1: neighbour node address
+    InetSocketAddress rmt(topologyHelper.GetNodeAddress(destination), port);
     onoff.SetAttribute("Remote", AddressValue(rmt));
     onoff.SetAttribute("Tos", UintegerValue(0xb8));
     apps.Add(onoff.Install(nodes.Get(0))); //sender
@@ -198,31 +209,22 @@ main(int argc, char* argv[])
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
 
     Simulator::Stop(Seconds(simulationTime + 5));
-    Simulator::Run();
+    RunWithStats();
+
+    if (pool)
+    {
+        heap::PrintPoolStats(std::cout);
+    }
 
     Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-    std::cout << std::endl << "*** Flow monitor statistics ***" << std::endl;
-    std::cout << "  Tx Packets/Bytes:   " << stats[1].txPackets << " / " << stats[1].txBytes
-              << std::endl;
-   
-    std::cout << "  Rx Packets/Bytes:   " << stats[1].rxPackets << " / " << stats[1].rxBytes
-              << std::endl;
-    
-    std::cout << "  Throughput: "
-              << stats[1].rxBytes * 8.0 /
-                     (stats[1].timeLastRxPacket.GetSeconds() -
-                      stats[1].timeFirstRxPacket.GetSeconds()) /
-                     1000000
-              << " Mbps" << std::endl;
-    std::cout << "  Packets/Bytes Dropped:   " << stats[1].lostPackets
-              << std::endl;
-    
-    std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets
-              << std::endl;
-    std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1)
-              << std::endl;
-    
+    FlowReport report;
+    report.AddFlows(monitor, classifier);
+    report.Print(std::cout);
+    if (!flowReport.empty())
+    {
+        report.WriteFile(flowReport);
+    }
+
     Simulator::Destroy();
 
     
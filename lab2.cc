@@ -7,6 +7,9 @@
  * Author: Stefano Avallone <stefano.avallone@unina.it>
  */
 
+#include "flow-report.h"
+#include "topology-builder.h"
+
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/flow-monitor-module.h"
@@ -65,6 +68,11 @@ int main(int argc, char* argv[]) {
     double simulationTime = 10; // seconds
     std::string transportProt = "Udp";
     std::string socketType;
+    std::string flowReport;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("flowReport", "Write the flow report to this file (.csv or .json)", flowReport);
+    cmd.Parse(argc, argv);
 
     if (transportProt == "Tcp") {
         socketType = "ns3::TcpSocketFactory";
@@ -72,60 +80,24 @@ int main(int argc, char* argv[]) {
         socketType = "ns3::UdpSocketFactory";
     }
 
-    NodeContainer nodes;
-    nodes.Create(5);
-
-    PointToPointHelper pointToPoint;
-    pointToPoint.SetDeviceAttribute("DataRate", StringValue("15Mbps")); // bandwidth -5,10,15
-    pointToPoint.SetChannelAttribute("Delay", StringValue("2ms")); // delay
-    pointToPoint.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue("10p"));
+    LinkAttributes link;
+    link.dataRate = "15Mbps"; // bandwidth -5,10,15
+    link.delay = "2ms";       // delay
+    link.queueSize = "10p";
 
     // node connectivity
-    NetDeviceContainer devices01;
-    devices01 = pointToPoint.Install(nodes.Get(0), nodes.Get(1));
-
-    NetDeviceContainer devices12;
-    devices12 = pointToPoint.Install(nodes.Get(1), nodes.Get(2));
-
-    NetDeviceContainer devices02;
-    devices02 = pointToPoint.Install(nodes.Get(0), nodes.Get(2));
-
-    NetDeviceContainer devices13;
-    devices13 = pointToPoint.Install(nodes.Get(1), nodes.Get(3));
-
-    NetDeviceContainer devices34;
-    devices34 = pointToPoint.Install(nodes.Get(3), nodes.Get(4));
-
-    NetDeviceContainer devices24;
-    devices24 = pointToPoint.Install(nodes.Get(2), nodes.Get(4));
-
-    InternetStackHelper stack;
-    stack.Install(nodes);
-
-    // Node interfaces and node address declaration
-    Ipv4AddressHelper address01;
-    address01.SetBase("10.1.1.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces01 = address01.Assign(devices01);
-
-    Ipv4AddressHelper address12;
-    address12.SetBase("10.1.2.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces12 = address12.Assign(devices12);
-
-    Ipv4AddressHelper address02;
-    address02.SetBase("10.1.3.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces02 = address02.Assign(devices02);
-
-    Ipv4AddressHelper address13;
-    address13.SetBase("10.1.4.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces13 = address13.Assign(devices13);
-
-    Ipv4AddressHelper address34;
-    address34.SetBase("10.1.5.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces34 = address34.Assign(devices34);
-
-    Ipv4AddressHelper address24;
-    address24.SetBase("10.1.6.0", "255.255.255.0");
-    Ipv4InterfaceContainer interfaces24 = address24.Assign(devices24);
+    Topology topology;
+    topology.AddLink(link);
+    topology.AddEdge(0, 1);
+    topology.AddEdge(1, 2);
+    topology.AddEdge(0, 2);
+    topology.AddEdge(1, 3);
+    topology.AddEdge(3, 4);
+    uint32_t edge24 = topology.AddEdge(2, 4);
+
+    // Node interfaces and node address declaration: one /30 per link
+    TopologyHelper topologyHelper;
+    NodeContainer nodes = topologyHelper.Install(topology);
 
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
     
@@ -149,7 +121,7 @@ int main(int argc, char* argv[]) {
     onoff.SetAttribute("DataRate", StringValue("50Mbps")); // bit/s
     ApplicationContainer apps;
 
-    InetSocketAddress rmt(interfaces24.GetAddress(1), port);
+    InetSocketAddress rmt(topologyHelper.GetAddress(edge24, 1), port);
     onoff.SetAttribute("Remote", AddressValue(rmt));
     onoff.SetAttribute("Tos", UintegerValue(0xb8));
     apps.Add(onoff.Install(nodes.Get(0)));
@@ -176,7 +148,7 @@ int main(int argc, char* argv[]) {
     onofftcp.SetAttribute("DataRate", StringValue("5Mbps")); // bit/s
     ApplicationContainer appstcp;
 
-    InetSocketAddress rmttcp(interfaces24.GetAddress(1), porttcp);
+    InetSocketAddress rmttcp(topologyHelper.GetAddress(edge24, 1), porttcp);
     onofftcp.SetAttribute("Remote", AddressValue(rmttcp));
     onofftcp.SetAttribute("Tos", UintegerValue(0xb8));
     appstcp.Add(onofftcp.Install(nodes.Get(1)));
@@ -190,15 +162,12 @@ int main(int argc, char* argv[]) {
     Simulator::Run();
 
     Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-
-    for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator iter = stats.begin(); iter != stats.end(); ++iter) {
-        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(iter->first);
-        std::cout << "Flow ID: " << iter->first << " Src Addr " << t.sourceAddress << " Dst Addr " << t.destinationAddress << std::endl;
-        std::cout << "Tx Packets   = " << iter->second.txPackets << std::endl;
-        std::cout << "Rx Packets   = " << iter->second.rxPackets << std::endl;
-        std::cout << "Lost Packets = " << iter->second.lostPackets << std::endl;
-        std::cout << "Throughput   = " << iter->second.rxBytes * 8.0 / (iter->second.timeLastRxPacket.GetSeconds() - iter->second.timeFirstTxPacket.GetSeconds()) / 1000000 << " Kbps" << std::endl;
+    FlowReport report;
+    report.AddFlows(monitor, classifier);
+    report.Print(std::cout);
+    if (!flowReport.empty())
+    {
+        report.WriteFile(flowReport);
     }
 
     Simulator::Destroy();
@@ -20,6 +20,11 @@
  * of TCP i.e. congestion control algorithm to use.
  */
 
+#include "flow-report.h"
+#include "flow-sampler.h"
+#include "matrix-propagation-loss-model.h"
+#include "run-stats.h"
+
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/internet-stack-helper.h"
@@ -42,23 +47,6 @@ NS_LOG_COMPONENT_DEFINE("wifi-tcp");
 
 using namespace ns3;
 
-Ptr<PacketSink> sink;     //!< Pointer to the packet sink application
-uint64_t lastTotalRx = 0; //!< The value of the last total received bytes
-
-/**
- * Calculate the throughput
- */
-void
-CalculateThroughput()
-{
-    Time now = Simulator::Now(); /* Return the simulator's virtual time. */
-    double cur = (sink->GetTotalRx() - lastTotalRx) * 8.0 /
-                 1e5; /* Convert Application RX Packets to MBits. */
-    std::cout << now.GetSeconds() << "s: \t" << cur << " Mbit/s" << std::endl;
-    lastTotalRx = sink->GetTotalRx();
-    Simulator::Schedule(MilliSeconds(100), &CalculateThroughput);
-}
-
 int
 main(int argc, char* argv[])
 {
@@ -69,6 +57,12 @@ main(int argc, char* argv[])
     std::string phyRate{"HtMcs7"};        /* Physical layer bitrate. */
     Time simulationTime{"10s"};           /* Simulation time. */
     bool pcapTracing{false};              /* PCAP Tracing is enabled or not. */
+    std::string flowReport;
+    Time sampleInterval{"0s"};                  /* Sampling interval, 0 disables sampling. */
+    std::string sampleFile{"lab6-samples.csv"}; /* Per-flow samples output file. */
+    double convergenceTolerance{0};             /* Throughput spread that stops the run. */
+    uint32_t convergenceIntervals{10};          /* Intervals the spread is measured over. */
+    bool lossMatrix{false};                     /* Precompute the loss between static nodes. */
 
     /* Command line argument parser setup. */
     CommandLine cmd(__FILE__);
@@ -82,6 +76,20 @@ main(int argc, char* argv[])
     cmd.AddValue("phyRate", "Physical layer bitrate", phyRate);
     cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
     cmd.AddValue("pcap", "Enable/disable PCAP Tracing", pcapTracing);
+    cmd.AddValue("flowReport", "Write the flow report to this file (.csv or .json)", flowReport);
+    cmd.AddValue("sampleInterval",
+                 "Write per-flow statistics every interval (0 disables)",
+                 sampleInterval);
+    cmd.AddValue("sampleFile", "File receiving the per-flow samples", sampleFile);
+    cmd.AddValue("convergenceTolerance",
+                 "Stop once the aggregate throughput spread is below this fraction (0 disables)",
+                 convergenceTolerance);
+    cmd.AddValue("convergenceIntervals",
+                 "Number of sampling intervals the convergence test looks at",
+                 convergenceIntervals);
+    cmd.AddValue("lossMatrix",
+                 "Precompute the loss between static nodes once and look it up per packet",
+                 lossMatrix);
     cmd.Parse(argc, argv);
 
     tcpVariant = std::string("ns3::") + tcpVariant;
@@ -106,7 +114,13 @@ main(int argc, char* argv[])
 
     /* Setup Physical Layer */
     YansWifiPhyHelper wifiPhy;
-    wifiPhy.SetChannel(wifiChannel.Create());
+    Ptr<YansWifiChannel> yansChannel = wifiChannel.Create();
+    Ptr<MatrixPropagationLossModel> matrix;
+    if (lossMatrix)
+    {
+        matrix = MatrixPropagationLossModel::Install(yansChannel);
+    }
+    wifiPhy.SetChannel(yansChannel);
     wifiPhy.SetErrorRateModel("ns3::YansErrorRateModel");
     wifiHelper.SetRemoteStationManager("ns3::ConstantRateWifiManager",
                                        "DataMode",
@@ -176,7 +190,6 @@ staDevices.Add(wifiHelper.Install(wifiPhy, wifiMac, staWifiNode4));
     PacketSinkHelper sinkHelper("ns3::TcpSocketFactory",
                                 InetSocketAddress(Ipv4Address::GetAny(), 9));
     ApplicationContainer sinkApp = sinkHelper.Install(apWifiNode);
-    sink = StaticCast<PacketSink>(sinkApp.Get(0)); //receiver
 
     /* Install TCP/UDP Transmitter on the station */
     OnOffHelper server("ns3::TcpSocketFactory", (InetSocketAddress(apInterface.GetAddress(0), 9))); 
@@ -189,7 +202,6 @@ staDevices.Add(wifiHelper.Install(wifiPhy, wifiMac, staWifiNode4));
     /* Start Applications */
     sinkApp.Start(Seconds(0.0));
     serverApp.Start(Seconds(1.0));
-   // Simulator::Schedule(Seconds(1.1), &CalculateThroughput);
 
     /* Enable Traces */
     if (pcapTracing)
@@ -204,24 +216,40 @@ staDevices.Add(wifiHelper.Install(wifiPhy, wifiMac, staWifiNode4));
 
     FlowMonitorHelper flowmon;
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+
+    Ptr<FlowStatsSampler> sampler;
+    if (sampleInterval.IsStrictlyPositive())
+    {
+        sampler = Create<FlowStatsSampler>(monitor, sampleInterval, sampleFile);
+        if (convergenceTolerance > 0)
+        {
+            sampler->SetConvergenceStop(convergenceTolerance, convergenceIntervals);
+        }
+        sampler->Start(Seconds(1.0));
+    }
     
      Simulator::Stop(simulationTime + Seconds(1.0));
-     Simulator::Run();
-
+     RunWithStats();
+    if (sampler)
+    {
+        sampler->Flush();
+    }
     
 
     Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-
-    for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator iter = stats.begin(); iter != stats.end(); ++iter) {
-        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(iter->first);
-        std::cout << "Flow ID: " << iter->first << " Src Addr " << t.sourceAddress << " Dst Addr " << t.destinationAddress << std::endl;
-        std::cout << "Tx Packets   = " << iter->second.txPackets << std::endl;
-        std::cout << "Rx Packets   = " << iter->second.rxPackets << std::endl;
-        std::cout << "Lost Packets = " << iter->second.txPackets- iter->second.rxPackets << std::endl;
-        std::cout << "Throughput   = " << iter->second.rxBytes * 8.0 / (iter->second.timeLastRxPacket.GetSeconds() - iter->second.timeFirstTxPacket.GetSeconds()) / 1000000 << " Kbps" << std::endl;
-        
+    FlowReport report;
+    report.AddFlows(monitor, classifier);
+    report.Print(std::cout);
+    if (matrix)
+    {
+        std::cout << "Loss matrix: " << matrix->GetSize() << " nodes, " << matrix->GetHits()
+                  << " lookups, " << matrix->GetMisses() << " live computations" << std::endl;
+    }
+    if (!flowReport.empty())
+    {
+        report.WriteFile(flowReport);
     }
+
        Simulator::Destroy();
 
     return 0;
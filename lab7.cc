@@ -6,9 +6,16 @@
  * Author: Sebastien Deronne <sebastien.deronne@gmail.com>
  */
 
+#include "ladder-scheduler.h"
+#include "profiling-simulator-impl.h"
+#include "run-stats.h"
+#include "spatial-wifi-channel.h"
+#include "wifi-ac-stats.h"
+
 #include "ns3/boolean.h"
 #include "ns3/command-line.h"
 #include "ns3/config.h"
+#include "ns3/global-value.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-global-routing-helper.h"
@@ -43,6 +50,10 @@ main(int argc, char* argv[])
     uint8_t channelWidth{40}; // MHz
     bool useShortGuardInterval{false}; //true or false
     bool useRts{false}; //true or false
+    bool profile{false}; //per-event wall time and allocation report
+    bool spatialChannel{false}; //only deliver to receivers in range
+    double maxRange{0}; //m, 0 = derive from the loss model
+    bool acStats{false}; //per-station, per-AC EDCA breakdown
     
     CommandLine cmd(__FILE__);
     cmd.AddValue("nWifi", "Number of stations", nWifi);
@@ -56,16 +67,46 @@ main(int argc, char* argv[])
     cmd.AddValue("useShortGuardInterval",
                  "Enable/disable short guard interval",
                  useShortGuardInterval);
+    cmd.AddValue("profile",
+                 "Print the wall time and, in NS3_HEAP_HOOKS builds, the heap allocations of "
+                 "each event type",
+                 profile);
+    cmd.AddValue("spatialChannel",
+                 "Use a grid-indexed channel delivering only to receivers in range",
+                 spatialChannel);
+    cmd.AddValue("maxRange",
+                 "Cutoff range of the spatial channel in meters (0 = from the loss model)",
+                 maxRange);
+    cmd.AddValue("acStats",
+                 "Report queue sojourn, TXOPs, retries and throughput per station and AC",
+                 acStats);
     cmd.Parse(argc, argv);
 
+    if (profile)
+    {
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue("ns3::ProfilingSimulatorImpl"));
+    }
+
     NodeContainer wifiStaNodes;
     wifiStaNodes.Create(nWifi);
     NodeContainer wifiApNode;
     wifiApNode.Create(1);
 
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
-    YansWifiPhyHelper phy;
-    phy.SetChannel(channel.Create());
+    YansWifiPhyHelper yansPhy;
+    SpatialYansWifiPhyHelper spatialPhy;
+    YansWifiPhyHelper& phy = spatialChannel ? spatialPhy : yansPhy;
+    Ptr<SpatialYansWifiChannel> spatial;
+    if (spatialChannel)
+    {
+        spatial = SpatialYansWifiChannel::FromHelper(channel, maxRange);
+        phy.SetChannel(spatial);
+    }
+    else
+    {
+        phy.SetChannel(channel.Create());
+    }
 
     WifiMacHelper mac;
     WifiHelper wifi;
@@ -128,6 +169,16 @@ main(int argc, char* argv[])
     staNodeInterfaces = address.Assign(staDevices);
     apNodeInterface = address.Assign(apDevice);
 
+    Ptr<WifiAcStats> stats;
+    if (acStats)
+    {
+        stats = Create<WifiAcStats>(nWifi);
+        for (uint32_t index = 0; index < nWifi; ++index)
+        {
+            stats->Install(index, DynamicCast<WifiNetDevice>(staDevices.Get(index)));
+        }
+    }
+
     // Setting applications
     ApplicationContainer sourceApplications;
     ApplicationContainer sinkApplications;
@@ -151,6 +202,7 @@ main(int argc, char* argv[])
             sourceApplications.Add(onOffHelper.Install(wifiStaNodes.Get(index)));
             PacketSinkHelper packetSinkHelper("ns3::UdpSocketFactory", sinkSocket);
             sinkApplications.Add(packetSinkHelper.Install(wifiApNode.Get(0))); //dont change the sender and receiver
+        }
     }
 
     sinkApplications.Start(Seconds(0.0));
@@ -161,7 +213,17 @@ main(int argc, char* argv[])
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
 
     Simulator::Stop(simulationTime + Seconds(1.0));
-    Simulator::Run();
+    RunWithStats();
+
+    if (profile)
+    {
+        DynamicCast<ProfilingSimulatorImpl>(Simulator::GetImplementation())->Print(std::cout);
+    }
+    if (spatial)
+    {
+        std::cout << "Spatial channel: cutoff " << spatial->GetCutoff() << " m, "
+                  << spatial->GetDeliveries() << " receptions scheduled" << std::endl;
+    }
 
     double throughput = 0;
     for (uint32_t index = 0; index < sinkApplications.GetN(); ++index)
@@ -169,6 +231,18 @@ main(int argc, char* argv[])
         double totalPacketsThrough =
             DynamicCast<PacketSink>(sinkApplications.Get(index))->GetTotalRx();
         throughput += ((totalPacketsThrough * 8) / simulationTime.GetMicroSeconds()); // Mbit/s
+        if (stats)
+        {
+            // One sink per station and ToS, in the order they were installed
+            uint8_t tosValue = tosValues[index % tosValues.size()];
+            stats->AddSinkBytes(index / tosValues.size(),
+                                QosUtilsMapTidToAc(tosValue >> 5),
+                                static_cast<uint64_t>(totalPacketsThrough));
+        }
+    }
+    if (stats)
+    {
+        stats->Print(std::cout, simulationTime);
     }
 
     Simulator::Destroy();
@@ -185,4 +259,3 @@ main(int argc, char* argv[])
 
     return 0;
 }
-}
@@ -0,0 +1,443 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/abort.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Ladder queue event scheduler (Tang, Goh and Thng, 2005).
+ *
+ * Events are kept in three tiers:
+ * - Top, an unsorted list of the far-future events, those at or after TopStart;
+ * - the ladder, a stack of rungs of unsorted buckets, each rung spanning one bucket of the
+ *   rung above it with finer buckets;
+ * - Bottom, a short sorted list of the earliest events.
+ *
+ * Insert appends to Top, to the bucket of the finest rung that still covers the event, or
+ * sorts into Bottom.  When Bottom runs dry, the next non-empty bucket of the lowest rung is
+ * moved to it and sorted if it holds at most THRESHOLD events, or split into a new, finer
+ * rung otherwise; when the ladder is exhausted, Top becomes its first rung.  Every event is
+ * therefore moved a bounded number of times and sorted only in small groups, which makes
+ * insert and remove O(1) amortised, independently of the number of pending events.
+ *
+ * Remove (of a cancelled event) looks the event up in the tier that covers its time stamp,
+ * and is linear in that bucket.
+ */
+class LadderScheduler : public Scheduler
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    LadderScheduler();
+    ~LadderScheduler() override;
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+  private:
+    static constexpr std::size_t THRESHOLD = 50;             //!< Largest bucket sorted into Bottom
+    static constexpr std::size_t MAX_BOTTOM = 4 * THRESHOLD; //!< Bottom size that spawns a rung
+    static constexpr std::size_t MAX_RUNGS = 8;              //!< Deepest ladder
+    static constexpr std::size_t MAX_BUCKETS = 1 << 16;      //!< Buckets per rung
+
+    /// One rung of the ladder.
+    struct Rung
+    {
+        uint64_t start{0};                       //!< Time of the first bucket
+        uint64_t width{1};                       //!< Time span of a bucket
+        std::size_t current{0};                  //!< First bucket not yet consumed
+        std::size_t count{0};                    //!< Events in the rung
+        std::vector<std::vector<Event>> buckets; //!< Buckets
+    };
+
+    /**
+     * Make a rung of events, reusing the storage of a previous rung.
+     * \param events The events, left empty.
+     * \param start Time of the first bucket.
+     * \param width Bucket width.
+     * \param nBuckets Number of buckets.
+     */
+    void PushRung(std::vector<Event>& events,
+                  uint64_t start,
+                  uint64_t width,
+                  std::size_t nBuckets);
+    /**
+     * \param rung A rung.
+     * \return the start time of its current bucket.
+     */
+    static uint64_t CurrentStart(const Rung& rung)
+    {
+        return rung.start + rung.current * rung.width;
+    }
+    /// Fill Bottom from the ladder or Top, if Bottom is empty.
+    void Refill();
+    /**
+     * Insert into the sorted Bottom, moving Bottom to a new rung if it grew past MAX_BOTTOM.
+     * \param ev The event.
+     */
+    void InsertBottom(const Event& ev);
+    /**
+     * Remove an event from an unsorted list.
+     * \param list The list.
+     * \param ev The event.
+     * \return true if it was found.
+     */
+    static bool RemoveFrom(std::vector<Event>& list, const Event& ev);
+
+    std::vector<Event> m_top;      //!< Events at or after m_topStart
+    uint64_t m_topStart{0};        //!< Lower bound of Top
+    uint64_t m_topMin{UINT64_MAX}; //!< Earliest time in Top
+    uint64_t m_topMax{0};          //!< Latest time in Top
+    std::vector<Rung> m_rungs;     //!< Rung storage, m_nRungs of them in use
+    std::size_t m_nRungs{0};       //!< Rungs in use, 0 the coarsest
+    std::vector<Event> m_bottom;   //!< Earliest events, sorted latest first
+    std::size_t m_size{0};         //!< Events held
+};
+
+/**
+ * \brief Scheduler checking LadderScheduler against MapScheduler.
+ *
+ * Every operation goes to both a LadderScheduler and a MapScheduler, and the
+ * program aborts as soon as they disagree on the next event, so a run selecting
+ * it with --SchedulerType=ns3::LadderCheckScheduler replays its own event
+ * stream through both.  Meant for correctness runs, as it pays for both
+ * schedulers.
+ */
+class LadderCheckScheduler : public Scheduler
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    LadderCheckScheduler();
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+  private:
+    /**
+     * Abort unless both schedulers returned the same event.
+     * \param ladder Event from the ladder.
+     * \param reference Event from the reference.
+     */
+    static void Compare(const Event& ladder, const Event& reference);
+
+    Ptr<LadderScheduler> m_ladder; //!< Scheduler under test
+    Ptr<MapScheduler> m_reference; //!< Reference scheduler
+};
+
+// Registering from a header is safe here because every scratch program is a
+// single translation unit; a library build would move the registrations and
+// the definitions to a .cc file.
+NS_OBJECT_ENSURE_REGISTERED(LadderScheduler);
+NS_OBJECT_ENSURE_REGISTERED(LadderCheckScheduler);
+
+inline TypeId
+LadderScheduler::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LadderScheduler")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<LadderScheduler>();
+    return tid;
+}
+
+inline LadderScheduler::LadderScheduler()
+    : m_rungs(MAX_RUNGS)
+{
+}
+
+inline LadderScheduler::~LadderScheduler()
+{
+}
+
+inline bool
+LadderScheduler::IsEmpty() const
+{
+    return m_size == 0;
+}
+
+inline void
+LadderScheduler::InsertBottom(const Event& ev)
+{
+    // Latest first, so the next event is at the back
+    auto it = std::upper_bound(m_bottom.begin(),
+                               m_bottom.end(),
+                               ev,
+                               [](const Event& a, const Event& b) { return b < a; });
+    m_bottom.insert(it, ev);
+    if (m_bottom.size() > MAX_BOTTOM && m_nRungs < MAX_RUNGS)
+    {
+        // The new rung must reach the tier above, which later inserts may fall just below
+        uint64_t start = m_bottom.back().key.m_ts;
+        uint64_t end = m_nRungs > 0 ? CurrentStart(m_rungs[m_nRungs - 1]) : m_topStart;
+        uint64_t width = (end - start) / std::min(m_bottom.size(), MAX_BUCKETS) + 1;
+        PushRung(m_bottom, start, width, (end - start + width - 1) / width);
+    }
+}
+
+inline void
+LadderScheduler::Insert(const Event& ev)
+{
+    m_size++;
+    uint64_t ts = ev.key.m_ts;
+    if (ts >= m_topStart)
+    {
+        m_top.push_back(ev);
+        m_topMin = std::min(m_topMin, ts);
+        m_topMax = std::max(m_topMax, ts);
+        return;
+    }
+    for (std::size_t i = 0; i < m_nRungs; ++i)
+    {
+        Rung& rung = m_rungs[i];
+        if (ts >= CurrentStart(rung))
+        {
+            rung.buckets[(ts - rung.start) / rung.width].push_back(ev);
+            rung.count++;
+            return;
+        }
+    }
+    InsertBottom(ev);
+}
+
+inline void
+LadderScheduler::PushRung(std::vector<Event>& events,
+                          uint64_t start,
+                          uint64_t width,
+                          std::size_t nBuckets)
+{
+    NS_ASSERT(m_nRungs < MAX_RUNGS);
+    Rung& rung = m_rungs[m_nRungs++];
+    rung.start = start;
+    rung.width = width;
+    rung.current = 0;
+    rung.count = events.size();
+    if (rung.buckets.size() < nBuckets)
+    {
+        rung.buckets.resize(nBuckets);
+    }
+    for (const Event& ev : events)
+    {
+        rung.buckets[(ev.key.m_ts - start) / width].push_back(ev);
+    }
+    events.clear();
+}
+
+inline void
+LadderScheduler::Refill()
+{
+    while (m_bottom.empty())
+    {
+        if (m_nRungs == 0)
+        {
+            if (m_top.empty())
+            {
+                return;
+            }
+            // Top becomes the first rung; later events past its span start a new Top
+            uint64_t span = m_topMax - m_topMin;
+            uint64_t width = span / std::min(m_top.size(), MAX_BUCKETS) + 1;
+            std::size_t nBuckets = span / width + 1;
+            uint64_t start = m_topMin;
+            m_topStart = m_topMax + 1;
+            m_topMin = UINT64_MAX;
+            m_topMax = 0;
+            PushRung(m_top, start, width, nBuckets);
+            continue;
+        }
+
+        Rung& rung = m_rungs[m_nRungs - 1];
+        while (rung.count > 0 && rung.buckets[rung.current].empty())
+        {
+            rung.current++;
+        }
+        if (rung.count == 0)
+        {
+            m_nRungs--;
+            continue;
+        }
+
+        std::vector<Event>& bucket = rung.buckets[rung.current];
+        uint64_t bucketStart = CurrentStart(rung);
+        rung.count -= bucket.size();
+        rung.current++;
+        if (bucket.size() <= THRESHOLD || rung.width == 1 || m_nRungs == MAX_RUNGS)
+        {
+            m_bottom.swap(bucket);
+            bucket.clear();
+            std::sort(m_bottom.begin(), m_bottom.end(), [](const Event& a, const Event& b) {
+                return b < a;
+            });
+        }
+        else
+        {
+            uint64_t width =
+                std::max<uint64_t>(1, rung.width / std::min(bucket.size(), MAX_BUCKETS));
+            std::size_t nBuckets = (rung.width + width - 1) / width;
+            PushRung(bucket, bucketStart, width, nBuckets);
+        }
+    }
+}
+
+inline Scheduler::Event
+LadderScheduler::PeekNext() const
+{
+    NS_ASSERT(!IsEmpty());
+    const_cast<LadderScheduler*>(this)->Refill();
+    return m_bottom.back();
+}
+
+inline Scheduler::Event
+LadderScheduler::RemoveNext()
+{
+    NS_ASSERT(!IsEmpty());
+    Refill();
+    Event ev = m_bottom.back();
+    m_bottom.pop_back();
+    m_size--;
+    return ev;
+}
+
+inline bool
+LadderScheduler::RemoveFrom(std::vector<Event>& list, const Event& ev)
+{
+    for (auto it = list.begin(); it != list.end(); ++it)
+    {
+        if (it->key.m_uid == ev.key.m_uid)
+        {
+            *it = list.back();
+            list.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void
+LadderScheduler::Remove(const Event& ev)
+{
+    uint64_t ts = ev.key.m_ts;
+    m_size--;
+    if (ts >= m_topStart && RemoveFrom(m_top, ev))
+    {
+        return;
+    }
+    for (std::size_t i = 0; i < m_nRungs; ++i)
+    {
+        Rung& rung = m_rungs[i];
+        if (ts >= CurrentStart(rung))
+        {
+            if (RemoveFrom(rung.buckets[(ts - rung.start) / rung.width], ev))
+            {
+                rung.count--;
+                return;
+            }
+            break;
+        }
+    }
+    for (auto it = m_bottom.begin(); it != m_bottom.end(); ++it)
+    {
+        if (it->key.m_uid == ev.key.m_uid)
+        {
+            m_bottom.erase(it);
+            return;
+        }
+    }
+    NS_FATAL_ERROR("Event " << ev.key.m_uid << " is not scheduled");
+}
+
+inline TypeId
+LadderCheckScheduler::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LadderCheckScheduler")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<LadderCheckScheduler>();
+    return tid;
+}
+
+inline LadderCheckScheduler::LadderCheckScheduler()
+    : m_ladder(CreateObject<LadderScheduler>()),
+      m_reference(CreateObject<MapScheduler>())
+{
+}
+
+inline void
+LadderCheckScheduler::Compare(const Event& ladder, const Event& reference)
+{
+    NS_ABORT_MSG_IF(ladder.key.m_ts != reference.key.m_ts ||
+                        ladder.key.m_uid != reference.key.m_uid,
+                    "LadderScheduler returned event " << ladder.key.m_uid << " at "
+                                                      << ladder.key.m_ts << ", MapScheduler "
+                                                      << reference.key.m_uid << " at "
+                                                      << reference.key.m_ts);
+}
+
+inline void
+LadderCheckScheduler::Insert(const Event& ev)
+{
+    m_ladder->Insert(ev);
+    m_reference->Insert(ev);
+}
+
+inline bool
+LadderCheckScheduler::IsEmpty() const
+{
+    bool empty = m_ladder->IsEmpty();
+    NS_ABORT_MSG_IF(empty != m_reference->IsEmpty(),
+                    "LadderScheduler and MapScheduler disagree on emptiness");
+    return empty;
+}
+
+inline Scheduler::Event
+LadderCheckScheduler::PeekNext() const
+{
+    Event ev = m_ladder->PeekNext();
+    Compare(ev, m_reference->PeekNext());
+    return ev;
+}
+
+inline Scheduler::Event
+LadderCheckScheduler::RemoveNext()
+{
+    Event ev = m_ladder->RemoveNext();
+    Compare(ev, m_reference->RemoveNext());
+    return ev;
+}
+
+inline void
+LadderCheckScheduler::Remove(const Event& ev)
+{
+    m_ladder->Remove(ev);
+    m_reference->Remove(ev);
+}
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,230 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef MATRIX_PROPAGATION_LOSS_MODEL_H
+#define MATRIX_PROPAGATION_LOSS_MODEL_H
+
+#include "ns3/abort.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/pointer.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/yans-wifi-channel.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Propagation loss looked up in a table precomputed for static nodes.
+ *
+ * Wraps the loss chain of a channel.  On the first query it collects the nodes of the
+ * devices attached to that channel whose mobility model is a ConstantPositionMobilityModel,
+ * and computes the received power of every ordered pair through the wrapped chain, for
+ * the transmit power of that query.  Nodes on other channels do not grow the table.
+ * Later queries between two table nodes at that transmit power are a lookup; any other
+ * query goes to the wrapped chain.
+ *
+ * A CourseChange on any table node drops the table for good and every query is computed
+ * live from then on.  The wrapped chain must be deterministic: fading models would be
+ * frozen to their first draw.
+ */
+class MatrixPropagationLossModel : public PropagationLossModel
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Put a matrix in front of the loss chain of a channel.
+     *
+     * \param channel The channel.
+     * \return the matrix model.
+     */
+    static Ptr<MatrixPropagationLossModel> Install(Ptr<YansWifiChannel> channel);
+
+    /**
+     * \param inner The loss chain to precompute.
+     */
+    void SetInner(Ptr<PropagationLossModel> inner)
+    {
+        m_inner = inner;
+    }
+
+    /**
+     * \param channel The channel whose devices the table covers.
+     */
+    void SetChannel(Ptr<YansWifiChannel> channel)
+    {
+        m_channel = PeekPointer(channel);
+    }
+
+    /// \return the number of queries answered from the table.
+    uint64_t GetHits() const
+    {
+        return m_hits;
+    }
+
+    /// \return the number of queries computed by the wrapped chain.
+    uint64_t GetMisses() const
+    {
+        return m_misses;
+    }
+
+    /// \return the number of nodes in the table, 0 if there is none.
+    uint32_t GetSize() const
+    {
+        return m_size;
+    }
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    /**
+     * Compute the table for a transmit power.
+     * \param txPowerDbm Transmit power.
+     */
+    void Build(double txPowerDbm) const;
+    /**
+     * CourseChange sink: a table node moved.
+     * \param model Its mobility model.
+     */
+    void Moved(Ptr<const MobilityModel> model);
+
+    Ptr<PropagationLossModel> m_inner;     //!< Wrapped chain
+    YansWifiChannel* m_channel{nullptr};   //!< Channel using this model, which owns it
+    mutable bool m_built{false};           //!< Whether Build ran
+    mutable bool m_live{false};            //!< Table dropped
+    mutable double m_txPowerDbm{0};        //!< Transmit power of the table
+    mutable uint32_t m_size{0};            //!< Nodes in the table
+    mutable std::vector<double> m_rxPower; //!< Row-major rx power (dBm)
+    mutable uint64_t m_hits{0};            //!< Table lookups
+    mutable uint64_t m_misses{0};          //!< Live computations
+    /// Row and column of each table node's mobility model
+    mutable std::unordered_map<const MobilityModel*, uint32_t> m_index;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MatrixPropagationLossModel);
+
+inline TypeId
+MatrixPropagationLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MatrixPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<MatrixPropagationLossModel>()
+            .AddAttribute("Inner",
+                          "The loss chain precomputed for static nodes",
+                          PointerValue(),
+                          MakePointerAccessor(&MatrixPropagationLossModel::m_inner),
+                          MakePointerChecker<PropagationLossModel>());
+    return tid;
+}
+
+inline Ptr<MatrixPropagationLossModel>
+MatrixPropagationLossModel::Install(Ptr<YansWifiChannel> channel)
+{
+    PointerValue loss;
+    channel->GetAttribute("PropagationLossModel", loss);
+    Ptr<MatrixPropagationLossModel> matrix = CreateObject<MatrixPropagationLossModel>();
+    matrix->SetInner(loss.Get<PropagationLossModel>());
+    matrix->SetChannel(channel);
+    channel->SetPropagationLossModel(matrix);
+    return matrix;
+}
+
+inline void
+MatrixPropagationLossModel::Build(double txPowerDbm) const
+{
+    NS_ABORT_MSG_UNLESS(m_channel,
+                        "MatrixPropagationLossModel has no channel; use "
+                        "MatrixPropagationLossModel::Install");
+    std::vector<Ptr<MobilityModel>> models;
+    for (std::size_t i = 0; i < m_channel->GetNDevices(); ++i)
+    {
+        Ptr<ConstantPositionMobilityModel> model =
+            m_channel->GetDevice(i)->GetNode()->GetObject<ConstantPositionMobilityModel>();
+        if (model && m_index.emplace(PeekPointer(model), models.size()).second)
+        {
+            models.push_back(model);
+            model->TraceConnectWithoutContext(
+                "CourseChange",
+                MakeCallback(&MatrixPropagationLossModel::Moved,
+                             const_cast<MatrixPropagationLossModel*>(this)));
+        }
+    }
+
+    m_size = models.size();
+    m_txPowerDbm = txPowerDbm;
+    m_rxPower.assign(static_cast<std::size_t>(m_size) * m_size, txPowerDbm);
+    for (uint32_t i = 0; i < m_size; ++i)
+    {
+        double* row = &m_rxPower[static_cast<std::size_t>(i) * m_size];
+        for (uint32_t j = 0; j < m_size; ++j)
+        {
+            if (i != j)
+            {
+                row[j] = m_inner->CalcRxPower(txPowerDbm, models[i], models[j]);
+            }
+        }
+    }
+    m_built = true;
+}
+
+inline void
+MatrixPropagationLossModel::Moved(Ptr<const MobilityModel> model)
+{
+    if (m_built && m_index.count(PeekPointer(model)))
+    {
+        m_live = true;
+        m_index.clear();
+        m_rxPower.clear();
+        m_rxPower.shrink_to_fit();
+        m_size = 0;
+    }
+}
+
+inline double
+MatrixPropagationLossModel::DoCalcRxPower(double txPowerDbm,
+                                          Ptr<MobilityModel> a,
+                                          Ptr<MobilityModel> b) const
+{
+    NS_ABORT_MSG_UNLESS(m_inner, "MatrixPropagationLossModel has no inner loss model");
+    if (!m_built)
+    {
+        Build(txPowerDbm);
+    }
+    if (!m_live && txPowerDbm == m_txPowerDbm)
+    {
+        auto i = m_index.find(PeekPointer(a));
+        auto j = m_index.find(PeekPointer(b));
+        if (i != m_index.end() && j != m_index.end())
+        {
+            ++m_hits;
+            return m_rxPower[static_cast<std::size_t>(i->second) * m_size + j->second];
+        }
+    }
+    ++m_misses;
+    return m_inner->CalcRxPower(txPowerDbm, a, b);
+}
+
+inline int64_t
+MatrixPropagationLossModel::DoAssignStreams(int64_t stream)
+{
+    return m_inner ? m_inner->AssignStreams(stream) : 0;
+}
+
+} // namespace ns3
+
+#endif /* MATRIX_PROPAGATION_LOSS_MODEL_H */
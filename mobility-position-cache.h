@@ -0,0 +1,338 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef MOBILITY_POSITION_CACHE_H
+#define MOBILITY_POSITION_CACHE_H
+
+#include "ns3/double.h"
+#include "ns3/mobility-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Positions of mobility models, evaluated at most once per simulation time.
+ *
+ * A Wi-Fi transmission asks the loss and delay models for the distance to every receiver,
+ * and each query walks both mobility models to the current time through a virtual call.
+ * The cache gives each model a slot in plain coordinate arrays, refreshed the first time
+ * the slot is read at a new timestamp and invalidated by the model's CourseChange trace,
+ * which covers SetPosition and any jump within one timestamp.
+ *
+ * Slots hold a reference to their model until Simulator::Destroy, when the cache empties
+ * itself so a later simulation in the same process starts clean.
+ */
+class MobilityPositionCache : public SimpleRefCount<MobilityPositionCache>
+{
+  public:
+    /// \return the cache shared by the Cached* propagation models.
+    static Ptr<MobilityPositionCache> GetDefault();
+
+    /**
+     * \param model A mobility model.
+     * \return the slot of the model, registering it on first use.
+     */
+    uint32_t GetSlot(Ptr<const MobilityModel> model);
+
+    /**
+     * \param slot A slot.
+     * \return the current position of its model.
+     */
+    Vector GetPosition(uint32_t slot);
+
+    /**
+     * \param a First model.
+     * \param b Second model.
+     * \return the distance between the current positions of the two models.
+     */
+    double GetDistance(Ptr<const MobilityModel> a, Ptr<const MobilityModel> b);
+
+    /// Drop every slot.
+    void Clear();
+
+    /// \return the number of positions read from the cache.
+    uint64_t GetHits() const
+    {
+        return m_hits;
+    }
+
+    /// \return the number of positions computed by the mobility models.
+    uint64_t GetMisses() const
+    {
+        return m_misses;
+    }
+
+  private:
+    /**
+     * CourseChange sink.
+     * \param model The model that changed course.
+     */
+    void Invalidate(Ptr<const MobilityModel> model);
+
+    std::unordered_map<const MobilityModel*, uint32_t> m_slots; //!< Slot of each model
+    std::vector<Ptr<const MobilityModel>> m_models;             //!< Model of each slot
+    std::vector<double> m_x;                                    //!< Cached x per slot
+    std::vector<double> m_y;                                    //!< Cached y per slot
+    std::vector<double> m_z;                                    //!< Cached z per slot
+    std::vector<int64_t> m_stamp;                               //!< Time step cached, -1 if stale
+    uint64_t m_hits{0};                                         //!< Positions served from the cache
+    uint64_t m_misses{0};                                       //!< Positions computed
+};
+
+/**
+ * \brief LogDistancePropagationLossModel reading positions from a MobilityPositionCache.
+ *
+ * Same attributes and results as LogDistancePropagationLossModel.
+ */
+class CachedLogDistancePropagationLossModel : public PropagationLossModel
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * \param cache Cache to read positions from, instead of the default one.
+     */
+    void SetPositionCache(Ptr<MobilityPositionCache> cache)
+    {
+        m_cache = cache;
+    }
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    double m_exponent;                          //!< Path loss exponent
+    double m_referenceDistance;                 //!< Reference distance (m)
+    double m_referenceLoss;                     //!< Loss at the reference distance (dB)
+    mutable Ptr<MobilityPositionCache> m_cache; //!< Position cache
+};
+
+/**
+ * \brief ConstantSpeedPropagationDelayModel reading positions from a MobilityPositionCache.
+ */
+class CachedConstantSpeedPropagationDelayModel : public PropagationDelayModel
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * \param cache Cache to read positions from, instead of the default one.
+     */
+    void SetPositionCache(Ptr<MobilityPositionCache> cache)
+    {
+        m_cache = cache;
+    }
+
+    Time GetDelay(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override;
+
+  private:
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    double m_speed;                             //!< Propagation speed (m/s)
+    mutable Ptr<MobilityPositionCache> m_cache; //!< Position cache
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachedLogDistancePropagationLossModel);
+NS_OBJECT_ENSURE_REGISTERED(CachedConstantSpeedPropagationDelayModel);
+
+inline Ptr<MobilityPositionCache>
+MobilityPositionCache::GetDefault()
+{
+    static Ptr<MobilityPositionCache> cache = Create<MobilityPositionCache>();
+    return cache;
+}
+
+inline uint32_t
+MobilityPositionCache::GetSlot(Ptr<const MobilityModel> model)
+{
+    auto it = m_slots.find(PeekPointer(model));
+    if (it != m_slots.end())
+    {
+        return it->second;
+    }
+
+    if (m_slots.empty())
+    {
+        Simulator::ScheduleDestroy(&MobilityPositionCache::Clear, Ptr<MobilityPositionCache>(this));
+    }
+    uint32_t slot = m_models.size();
+    m_slots.emplace(PeekPointer(model), slot);
+    m_models.push_back(model);
+    m_x.push_back(0);
+    m_y.push_back(0);
+    m_z.push_back(0);
+    m_stamp.push_back(-1);
+    ConstCast<MobilityModel>(model)->TraceConnectWithoutContext(
+        "CourseChange",
+        MakeCallback(&MobilityPositionCache::Invalidate, this));
+    return slot;
+}
+
+inline Vector
+MobilityPositionCache::GetPosition(uint32_t slot)
+{
+    int64_t now = Simulator::Now().GetTimeStep();
+    if (m_stamp[slot] != now)
+    {
+        Vector position = m_models[slot]->GetPosition();
+        m_x[slot] = position.x;
+        m_y[slot] = position.y;
+        m_z[slot] = position.z;
+        m_stamp[slot] = now;
+        ++m_misses;
+    }
+    else
+    {
+        ++m_hits;
+    }
+    return Vector(m_x[slot], m_y[slot], m_z[slot]);
+}
+
+inline double
+MobilityPositionCache::GetDistance(Ptr<const MobilityModel> a, Ptr<const MobilityModel> b)
+{
+    uint32_t i = GetSlot(a);
+    uint32_t j = GetSlot(b);
+    GetPosition(i);
+    GetPosition(j);
+    double dx = m_x[i] - m_x[j];
+    double dy = m_y[i] - m_y[j];
+    double dz = m_z[i] - m_z[j];
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+inline void
+MobilityPositionCache::Invalidate(Ptr<const MobilityModel> model)
+{
+    auto it = m_slots.find(PeekPointer(model));
+    if (it != m_slots.end())
+    {
+        m_stamp[it->second] = -1;
+    }
+}
+
+inline void
+MobilityPositionCache::Clear()
+{
+    for (const auto& model : m_models)
+    {
+        ConstCast<MobilityModel>(model)->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&MobilityPositionCache::Invalidate, this));
+    }
+    m_slots.clear();
+    m_models.clear();
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_stamp.clear();
+}
+
+inline TypeId
+CachedLogDistancePropagationLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedLogDistancePropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedLogDistancePropagationLossModel>()
+            .AddAttribute("Exponent",
+                          "The exponent of the Path Loss propagation model",
+                          DoubleValue(3.0),
+                          MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_exponent),
+                          MakeDoubleChecker<double>())
+            .AddAttribute(
+                "ReferenceDistance",
+                "The distance at which the reference loss is calculated (m)",
+                DoubleValue(1.0),
+                MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_referenceDistance),
+                MakeDoubleChecker<double>())
+            .AddAttribute(
+                "ReferenceLoss",
+                "The reference loss at reference distance (dB). (Default is Friis at 1m with "
+                "5.15 GHz)",
+                DoubleValue(46.6777),
+                MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_referenceLoss),
+                MakeDoubleChecker<double>());
+    return tid;
+}
+
+inline double
+CachedLogDistancePropagationLossModel::DoCalcRxPower(double txPowerDbm,
+                                                     Ptr<MobilityModel> a,
+                                                     Ptr<MobilityModel> b) const
+{
+    if (!m_cache)
+    {
+        m_cache = MobilityPositionCache::GetDefault();
+    }
+    double distance = m_cache->GetDistance(a, b);
+    if (distance <= m_referenceDistance)
+    {
+        return txPowerDbm - m_referenceLoss;
+    }
+    double pathLossDb = 10 * m_exponent * std::log10(distance / m_referenceDistance);
+    return txPowerDbm - m_referenceLoss - pathLossDb;
+}
+
+inline int64_t
+CachedLogDistancePropagationLossModel::DoAssignStreams(int64_t stream)
+{
+    return 0;
+}
+
+inline TypeId
+CachedConstantSpeedPropagationDelayModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedConstantSpeedPropagationDelayModel")
+            .SetParent<PropagationDelayModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedConstantSpeedPropagationDelayModel>()
+            .AddAttribute("Speed",
+                          "The propagation speed (m/s) in the propagation medium being considered.",
+                          DoubleValue(300000000.0),
+                          MakeDoubleAccessor(&CachedConstantSpeedPropagationDelayModel::m_speed),
+                          MakeDoubleChecker<double>());
+    return tid;
+}
+
+inline Time
+CachedConstantSpeedPropagationDelayModel::GetDelay(Ptr<MobilityModel> a,
+                                                   Ptr<MobilityModel> b) const
+{
+    if (!m_cache)
+    {
+        m_cache = MobilityPositionCache::GetDefault();
+    }
+    return Seconds(m_cache->GetDistance(a, b) / m_speed);
+}
+
+inline int64_t
+CachedConstantSpeedPropagationDelayModel::DoAssignStreams(int64_t stream)
+{
+    return 0;
+}
+
+} // namespace ns3
+
+#endif /* MOBILITY_POSITION_CACHE_H */
@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef PROCESS_RUNNER_H
+#define PROCESS_RUNNER_H
+
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Outcome of one child process.
+ */
+struct ProcessResult
+{
+    int exitStatus{-1};    //!< Exit status, or 128 + signal number
+    double wallSeconds{0}; //!< Wall clock time between fork and exit
+    long maxRssKb{0};      //!< Peak resident set size reported by wait4
+};
+
+/**
+ * \brief Run independent programs on a fixed number of worker processes.
+ *
+ * Every job is a separate fork/exec, so runs share no simulator state.  The
+ * output of each job goes to its own log file.
+ */
+class ProcessPool
+{
+  public:
+    /**
+     * \param workers Maximum number of concurrent children; 0 uses one per core.
+     */
+    explicit ProcessPool(uint32_t workers = 0);
+
+    /**
+     * Queue a job.
+     *
+     * \param argv Program path followed by its arguments.
+     * \param logFile File receiving the job's stdout and stderr.
+     * \return the job index.
+     */
+    std::size_t Add(const std::vector<std::string>& argv, const std::string& logFile);
+
+    /**
+     * Run all queued jobs.
+     *
+     * \return the results, in the order the jobs were added.
+     */
+    std::vector<ProcessResult> Run();
+
+    /// \return the number of concurrent workers.
+    uint32_t GetWorkers() const
+    {
+        return m_workers;
+    }
+
+  private:
+    /// A queued job.
+    struct Job
+    {
+        std::vector<std::string> argv; //!< Program and arguments
+        std::string logFile;           //!< Output file
+    };
+
+    /**
+     * Fork and exec a job.
+     *
+     * \param job The job.
+     * \return the child PID.
+     */
+    static pid_t Spawn(const Job& job);
+
+    uint32_t m_workers;      //!< Concurrent children
+    std::vector<Job> m_jobs; //!< Queued jobs
+};
+
+inline ProcessPool::ProcessPool(uint32_t workers)
+    : m_workers(workers)
+{
+    if (m_workers == 0)
+    {
+        m_workers = std::max(1U, std::thread::hardware_concurrency());
+    }
+}
+
+inline std::size_t
+ProcessPool::Add(const std::vector<std::string>& argv, const std::string& logFile)
+{
+    NS_ABORT_MSG_IF(argv.empty(), "Empty command line");
+    m_jobs.push_back({argv, logFile});
+    return m_jobs.size() - 1;
+}
+
+inline pid_t
+ProcessPool::Spawn(const Job& job)
+{
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "fork failed");
+    if (pid == 0)
+    {
+        int fd = open(job.logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        std::vector<char*> args;
+        for (const auto& a : job.argv)
+        {
+            args.push_back(const_cast<char*>(a.c_str()));
+        }
+        args.push_back(nullptr);
+        execv(args[0], args.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+inline std::vector<ProcessResult>
+ProcessPool::Run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<ProcessResult> results(m_jobs.size());
+    std::vector<Clock::time_point> started(m_jobs.size());
+    std::map<pid_t, std::size_t> running;
+    std::size_t next = 0;
+    std::size_t done = 0;
+
+    while (done < m_jobs.size())
+    {
+        while (next < m_jobs.size() && running.size() < m_workers)
+        {
+            started[next] = Clock::now();
+            running[Spawn(m_jobs[next])] = next;
+            next++;
+        }
+
+        int status;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        NS_ABORT_MSG_IF(pid < 0, "wait4 failed");
+        auto it = running.find(pid);
+        if (it == running.end())
+        {
+            continue;
+        }
+        std::size_t job = it->second;
+        running.erase(it);
+        done++;
+
+        ProcessResult& r = results[job];
+        r.wallSeconds = std::chrono::duration<double>(Clock::now() - started[job]).count();
+        r.maxRssKb = usage.ru_maxrss;
+        r.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+        std::cout << "[" << done << "/" << m_jobs.size() << "] exit " << r.exitStatus << ", "
+                  << r.wallSeconds << " s: " << m_jobs[job].logFile << std::endl;
+    }
+    m_jobs.clear();
+    return results;
+}
+
+/**
+ * Split a string on a separator, dropping empty items.
+ *
+ * \param list The string.
+ * \param sep The separator.
+ * \return the items.
+ */
+inline std::vector<std::string>
+SplitList(const std::string& list, char sep)
+{
+    std::vector<std::string> items;
+    std::istringstream iss(list);
+    std::string item;
+    while (std::getline(iss, item, sep))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+} // namespace ns3
+
+#endif /* PROCESS_RUNNER_H */
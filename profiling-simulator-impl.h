@@ -0,0 +1,457 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef PROFILING_SIMULATOR_IMPL_H
+#define PROFILING_SIMULATOR_IMPL_H
+
+// Pulls in the counting operator new of heap-hooks.h when NS3_HEAP_HOOKS is
+// defined: include it from the program's single translation unit only.
+#include "heap-hooks.h"
+
+#include "ns3/event-impl.h"
+#include "ns3/object-factory.h"
+#include "ns3/simulator-impl.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cxxabi.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Simulator implementation that profiles the events of another one.
+ *
+ * Every scheduled event is wrapped in a small EventImpl that times the
+ * original event and counts the heap allocations made while it runs.  Events
+ * are classified by the dynamic type of their EventImpl, which for events
+ * made with MakeEvent names the member function or function pointer type of
+ * the target, e.g. "void (ns3::PhyEntity::*)(ns3::Ptr<ns3::Event>)".  The
+ * actual scheduling is delegated to the wrapped implementation.
+ *
+ * Select it before the first Simulator call:
+ * \code
+ *   GlobalValue::Bind("SimulatorImplementationType",
+ *                     StringValue("ns3::ProfilingSimulatorImpl"));
+ * \endcode
+ * Programs that do not select it pay nothing.  The allocation columns need a
+ * build with NS3_HEAP_HOOKS defined (see heap-hooks.h) and are left blank
+ * otherwise.
+ */
+class ProfilingSimulatorImpl : public SimulatorImpl
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Print the per-category report, most expensive first.
+     *
+     * \param os The output stream.
+     */
+    void Print(std::ostream& os) const;
+
+    // Inherited from SimulatorImpl
+    void Destroy() override;
+    bool IsFinished() const override;
+    void Stop() override;
+    EventId Stop(const Time& delay) override;
+    EventId Schedule(const Time& delay, EventImpl* event) override;
+    void ScheduleWithContext(uint32_t context, const Time& delay, EventImpl* event) override;
+    EventId ScheduleNow(EventImpl* event) override;
+    EventId ScheduleDestroy(EventImpl* event) override;
+    void Remove(const EventId& id) override;
+    void Cancel(const EventId& id) override;
+    bool IsExpired(const EventId& id) const override;
+    void Run() override;
+    Time Now() const override;
+    Time GetDelayLeft(const EventId& id) const override;
+    Time GetMaximumSimulationTime() const override;
+    void SetScheduler(ObjectFactory schedulerFactory) override;
+    uint32_t GetSystemId() const override;
+    uint32_t GetContext() const override;
+    uint64_t GetEventCount() const override;
+
+  protected:
+    void NotifyConstructionCompleted() override;
+    void DoDispose() override;
+
+  private:
+    using Clock = std::chrono::steady_clock; //!< Wall clock
+
+    /// Accumulated cost of one event type.
+    struct Category
+    {
+        const std::type_info* type; //!< Type of the EventImpl
+        uint64_t count{0};          //!< Events run
+        Clock::duration wall{0};    //!< Wall time spent in the events
+        uint64_t allocations{0};    //!< Heap allocations made by the events
+        uint64_t bytes{0};          //!< Heap bytes requested by the events
+    };
+
+    /// Event wrapper charging the wrapped event to its category.
+    class ProfiledEvent : public EventImpl
+    {
+      public:
+        /**
+         * \param inner The wrapped event, whose reference is taken over.
+         * \param profiler The profiler.
+         * \param category The category of the wrapped event.
+         */
+        ProfiledEvent(EventImpl* inner, ProfilingSimulatorImpl* profiler, uint32_t category)
+            : m_inner(inner),
+              m_profiler(profiler),
+              m_category(category)
+        {
+        }
+
+        ~ProfiledEvent() override
+        {
+            m_inner->Unref();
+        }
+
+      protected:
+        void Notify() override
+        {
+            m_profiler->Invoke(m_inner, m_category);
+        }
+
+      private:
+        EventImpl* m_inner;                 //!< Wrapped event
+        ProfilingSimulatorImpl* m_profiler; //!< Profiler
+        uint32_t m_category;                //!< Category of the wrapped event
+    };
+
+    /**
+     * Wrap an event.
+     *
+     * \param event The event.
+     * \return the wrapper.
+     */
+    EventImpl* Wrap(EventImpl* event);
+
+    /**
+     * Run an event and charge it to a category.
+     *
+     * \param event The event.
+     * \param category The category.
+     */
+    void Invoke(EventImpl* event, uint32_t category);
+
+    /**
+     * \param type An EventImpl type.
+     * \return a readable name of the event target.
+     */
+    static std::string GetName(const std::type_info& type);
+
+    std::string m_implementationType;                      //!< Wrapped implementation type
+    Ptr<SimulatorImpl> m_impl;                             //!< Wrapped implementation
+    std::vector<Category> m_categories;                    //!< Event categories
+    std::unordered_map<std::type_index, uint32_t> m_index; //!< Category of each type
+    const std::type_info* m_lastType{nullptr};             //!< Type classified last
+    uint32_t m_lastCategory{0};                            //!< Category of m_lastType
+    Clock::duration m_runWall{0};                          //!< Wall time spent in Run
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ProfilingSimulatorImpl);
+
+inline TypeId
+ProfilingSimulatorImpl::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::ProfilingSimulatorImpl")
+            .SetParent<SimulatorImpl>()
+            .SetGroupName("Core")
+            .AddConstructor<ProfilingSimulatorImpl>()
+            .AddAttribute("Implementation",
+                          "The simulator implementation whose events are profiled.",
+                          StringValue("ns3::DefaultSimulatorImpl"),
+                          MakeStringAccessor(&ProfilingSimulatorImpl::m_implementationType),
+                          MakeStringChecker());
+    return tid;
+}
+
+inline void
+ProfilingSimulatorImpl::NotifyConstructionCompleted()
+{
+    // The attributes are only set once the constructor has returned
+    ObjectFactory factory;
+    factory.SetTypeId(m_implementationType);
+    m_impl = factory.Create<SimulatorImpl>();
+    SimulatorImpl::NotifyConstructionCompleted();
+}
+
+inline void
+ProfilingSimulatorImpl::DoDispose()
+{
+    m_impl->Dispose();
+    m_impl = nullptr;
+    SimulatorImpl::DoDispose();
+}
+
+inline EventImpl*
+ProfilingSimulatorImpl::Wrap(EventImpl* event)
+{
+    // The wrapper and the category bookkeeping are the profiler's own allocations: keep
+    // them out of the figures of the event that is scheduling
+    uint64_t allocations = heap::counters.allocations;
+    uint64_t bytes = heap::counters.bytes;
+    const std::type_info& type = typeid(*event);
+    if (&type != m_lastType)
+    {
+        auto [it, inserted] = m_index.emplace(type, m_categories.size());
+        if (inserted)
+        {
+            m_categories.push_back({&type});
+        }
+        m_lastType = &type;
+        m_lastCategory = it->second;
+    }
+    EventImpl* wrapped = new ProfiledEvent(event, this, m_lastCategory);
+    heap::counters.allocations = allocations;
+    heap::counters.bytes = bytes;
+    return wrapped;
+}
+
+inline void
+ProfilingSimulatorImpl::Invoke(EventImpl* event, uint32_t category)
+{
+    heap::Counters before = heap::counters;
+    Clock::time_point start = Clock::now();
+    event->Invoke();
+    Clock::duration wall = Clock::now() - start;
+
+    Category& c = m_categories[category];
+    c.count++;
+    c.wall += wall;
+    c.allocations += heap::counters.allocations - before.allocations;
+    c.bytes += heap::counters.bytes - before.bytes;
+}
+
+inline std::string
+ProfilingSimulatorImpl::GetName(const std::type_info& type)
+{
+    int status;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    std::string name = (status == 0) ? demangled : type.name();
+    std::free(demangled);
+
+    // MakeEvent<F, ...>(...)::EventMemberImpl: keep the target type F
+    std::size_t open = name.find("MakeEvent<");
+    if (open == std::string::npos)
+    {
+        return name;
+    }
+    open += 10;
+    int depth = 0;
+    for (std::size_t i = open; i < name.size(); i++)
+    {
+        char ch = name[i];
+        if (ch == '<' || ch == '(')
+        {
+            depth++;
+        }
+        else if ((ch == '>' || ch == ')') && depth > 0)
+        {
+            depth--;
+        }
+        else if ((ch == ',' || ch == '>') && depth == 0)
+        {
+            return name.substr(open, i - open);
+        }
+    }
+    return name;
+}
+
+inline void
+ProfilingSimulatorImpl::Print(std::ostream& os) const
+{
+    // Different EventImpl types may name the same target
+    std::map<std::string, Category> merged;
+    for (const auto& c : m_categories)
+    {
+        Category& m = merged.emplace(GetName(*c.type), Category{c.type}).first->second;
+        m.count += c.count;
+        m.wall += c.wall;
+        m.allocations += c.allocations;
+        m.bytes += c.bytes;
+    }
+    std::vector<std::pair<std::string, Category>> rows(merged.begin(), merged.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.wall > b.second.wall;
+    });
+
+    uint64_t events = 0;
+    Clock::duration inEvents{0};
+    for (const auto& [name, c] : rows)
+    {
+        events += c.count;
+        inEvents += c.wall;
+    }
+    double run = std::chrono::duration<double>(m_runWall).count();
+    double total = std::chrono::duration<double>(inEvents).count();
+
+    os << "Event profile: " << events << " events, " << total << " s in events, " << run
+       << " s in Simulator::Run" << std::endl;
+    if (!heap::ENABLED)
+    {
+        os << "Heap allocations are not counted: build with -DNS3_HEAP_HOOKS" << std::endl;
+    }
+    os << std::setw(12) << "events" << std::setw(11) << "total_s" << std::setw(8) << "%"
+       << std::setw(10) << "ns/event" << std::setw(13) << "allocs/event" << std::setw(12)
+       << "bytes/event"
+       << "  target" << std::endl;
+    for (const auto& [name, c] : rows)
+    {
+        double wall = std::chrono::duration<double>(c.wall).count();
+        double n = std::max<uint64_t>(c.count, 1);
+        os << std::setw(12) << c.count << std::setw(11) << std::fixed << std::setprecision(3)
+           << wall << std::setw(8) << std::setprecision(1) << (total > 0 ? 100 * wall / total : 0)
+           << std::setw(10) << std::setprecision(0) << wall * 1e9 / n;
+        if (heap::ENABLED)
+        {
+            os << std::setw(13) << std::setprecision(2) << c.allocations / n << std::setw(12)
+               << std::setprecision(0) << c.bytes / n;
+        }
+        else
+        {
+            os << std::setw(13) << "-" << std::setw(12) << "-";
+        }
+        os << "  " << name << std::endl;
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
+
+inline void
+ProfilingSimulatorImpl::Destroy()
+{
+    m_impl->Destroy();
+}
+
+inline bool
+ProfilingSimulatorImpl::IsFinished() const
+{
+    return m_impl->IsFinished();
+}
+
+inline void
+ProfilingSimulatorImpl::Stop()
+{
+    m_impl->Stop();
+}
+
+inline EventId
+ProfilingSimulatorImpl::Stop(const Time& delay)
+{
+    return m_impl->Stop(delay);
+}
+
+inline EventId
+ProfilingSimulatorImpl::Schedule(const Time& delay, EventImpl* event)
+{
+    return m_impl->Schedule(delay, Wrap(event));
+}
+
+inline void
+ProfilingSimulatorImpl::ScheduleWithContext(uint32_t context, const Time& delay, EventImpl* event)
+{
+    m_impl->ScheduleWithContext(context, delay, Wrap(event));
+}
+
+inline EventId
+ProfilingSimulatorImpl::ScheduleNow(EventImpl* event)
+{
+    return m_impl->ScheduleNow(Wrap(event));
+}
+
+inline EventId
+ProfilingSimulatorImpl::ScheduleDestroy(EventImpl* event)
+{
+    return m_impl->ScheduleDestroy(Wrap(event));
+}
+
+inline void
+ProfilingSimulatorImpl::Remove(const EventId& id)
+{
+    m_impl->Remove(id);
+}
+
+inline void
+ProfilingSimulatorImpl::Cancel(const EventId& id)
+{
+    m_impl->Cancel(id);
+}
+
+inline bool
+ProfilingSimulatorImpl::IsExpired(const EventId& id) const
+{
+    return m_impl->IsExpired(id);
+}
+
+inline void
+ProfilingSimulatorImpl::Run()
+{
+    Clock::time_point start = Clock::now();
+    m_impl->Run();
+    m_runWall += Clock::now() - start;
+}
+
+inline Time
+ProfilingSimulatorImpl::Now() const
+{
+    return m_impl->Now();
+}
+
+inline Time
+ProfilingSimulatorImpl::GetDelayLeft(const EventId& id) const
+{
+    return m_impl->GetDelayLeft(id);
+}
+
+inline Time
+ProfilingSimulatorImpl::GetMaximumSimulationTime() const
+{
+    return m_impl->GetMaximumSimulationTime();
+}
+
+inline void
+ProfilingSimulatorImpl::SetScheduler(ObjectFactory schedulerFactory)
+{
+    m_impl->SetScheduler(schedulerFactory);
+}
+
+inline uint32_t
+ProfilingSimulatorImpl::GetSystemId() const
+{
+    return m_impl->GetSystemId();
+}
+
+inline uint32_t
+ProfilingSimulatorImpl::GetContext() const
+{
+    return m_impl->GetContext();
+}
+
+inline uint64_t
+ProfilingSimulatorImpl::GetEventCount() const
+{
+    return m_impl->GetEventCount();
+}
+
+} // namespace ns3
+
+#endif /* PROFILING_SIMULATOR_IMPL_H */
@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include "ns3/abort.h"
+#include "ns3/global-value.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * \brief Where RunWithStats writes its figures; empty for nowhere.
+ *
+ * A GlobalValue, so every program that includes this header accepts
+ * --RunStatsFile=path next to --SchedulerType, which is what the scheduler
+ * benchmark drives them with.
+ */
+inline GlobalValue g_runStatsFile("RunStatsFile",
+                                  "File receiving the event count and wall time of the run",
+                                  StringValue(""),
+                                  MakeStringChecker());
+
+/**
+ * Run the simulation and, if RunStatsFile is set, write a one-row CSV table with the
+ * scheduler type, the number of events executed, the wall time of Simulator::Run and
+ * the event rate.
+ */
+inline void
+RunWithStats()
+{
+    auto start = std::chrono::steady_clock::now();
+    Simulator::Run();
+    double wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    StringValue file;
+    g_runStatsFile.GetValue(file);
+    if (file.Get().empty())
+    {
+        return;
+    }
+    StringValue scheduler;
+    GlobalValue::GetValueByName("SchedulerType", scheduler);
+    uint64_t events = Simulator::GetEventCount();
+
+    std::ofstream out(file.Get());
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open " << file.Get());
+    out << "scheduler,events,wall_s,events_per_s\n"
+        << scheduler.Get() << "," << events << "," << wallSeconds << ","
+        << (wallSeconds > 0 ? events / wallSeconds : 0) << "\n";
+}
+
+/// Figures of one run, read back from its RunStatsFile.
+struct RunStats
+{
+    std::string scheduler; //!< Scheduler type
+    uint64_t events{0};    //!< Events executed
+    double wallSeconds{0}; //!< Wall time of Simulator::Run
+};
+
+/**
+ * Read the file written by RunWithStats.
+ *
+ * \param path The file.
+ * \param stats The figures read.
+ * \return false if the file is missing or malformed.
+ */
+inline bool
+ReadRunStats(const std::string& path, RunStats& stats)
+{
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || !std::getline(in, line))
+    {
+        return false;
+    }
+    std::istringstream row(line);
+    std::string events;
+    std::string wall;
+    if (!std::getline(row, stats.scheduler, ',') || !std::getline(row, events, ',') ||
+        !std::getline(row, wall, ','))
+    {
+        return false;
+    }
+    try
+    {
+        stats.events = std::stoull(events);
+        stats.wallSeconds = std::stod(wall);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+} // namespace ns3
+
+#endif /* RUN_STATS_H */
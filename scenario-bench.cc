@@ -0,0 +1,335 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Scenario benchmark with regression tracking for five.cc, lab6.cc and lab7.cc.
+//
+// Runs each program in small, medium and large canonical configurations, each
+// as its own process with --RunStatsFile, and records the median wall time,
+// the events executed, the event rate of Simulator::Run and the peak RSS of
+// every scenario.  The figures are compared against a baseline JSON file: a
+// scenario regresses when its wall time or peak RSS grows, or its event rate
+// drops, by more than the tolerance.  A changed event count means the model
+// itself behaves differently, which is reported but not counted as a
+// regression.  The exit status is 1 if any scenario regressed or failed.
+//
+// Record the baseline once, on a quiet machine:
+//
+// ./ns3 run "scenario-bench --update_baseline=true"
+//
+// and compare later builds with it:
+//
+// ./ns3 run "scenario-bench --tolerance=0.1"
+
+#include "process-runner.h"
+#include "run-stats.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("ScenarioBench");
+
+/// One canonical configuration.
+struct Scenario
+{
+    std::string name;              //!< Name in the tables and the baseline
+    std::string program;           //!< Scratch program
+    std::vector<std::string> args; //!< Program arguments
+};
+
+/// The canonical configurations: flows for five.cc, load for lab6.cc, stations for lab7.cc.
+static const std::vector<Scenario> SCENARIOS = {
+    {"five-small", "five", {"--num_flows=1", "--tracing=false"}},
+    {"five-medium", "five", {"--num_flows=10", "--tracing=false"}},
+    {"five-large", "five", {"--num_flows=50", "--tracing=false"}},
+    {"lab6-small", "lab6", {"--dataRate=10Mb/s", "--simulationTime=5s"}},
+    {"lab6-medium", "lab6", {"--dataRate=50Mb/s", "--simulationTime=10s"}},
+    {"lab6-large", "lab6", {"--dataRate=100Mb/s", "--simulationTime=30s"}},
+    {"lab7-small", "lab7", {"--nWifi=1", "--simulationTime=5s"}},
+    {"lab7-medium", "lab7", {"--nWifi=4", "--simulationTime=10s"}},
+    {"lab7-large", "lab7", {"--nWifi=16", "--simulationTime=10s"}},
+};
+
+/// Figures of one scenario.
+struct ScenarioFigures
+{
+    double wallSeconds{0};  //!< Median process wall time
+    uint64_t events{0};     //!< Events executed
+    double eventsPerSec{0}; //!< Event rate of Simulator::Run
+    uint64_t maxRssKb{0};   //!< Peak resident set size
+};
+
+/**
+ * Write the figures as a baseline, one scenario per line.
+ *
+ * \param path The file.
+ * \param figures The figures by scenario.
+ */
+static void
+WriteBaseline(const std::string& path, const std::map<std::string, ScenarioFigures>& figures)
+{
+    std::ofstream out(path);
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open " << path);
+    out << "{\n";
+    std::size_t n = 0;
+    for (const auto& [name, f] : figures)
+    {
+        out << "  \"" << name << "\": {\"wall_s\": " << f.wallSeconds
+            << ", \"events\": " << f.events << ", \"events_per_s\": " << f.eventsPerSec
+            << ", \"max_rss_kb\": " << f.maxRssKb << "}" << (++n < figures.size() ? "," : "")
+            << "\n";
+    }
+    out << "}\n";
+}
+
+/**
+ * Read a baseline written by WriteBaseline.  Only that layout is understood: one
+ * scenario object of numeric fields per line.
+ *
+ * \param path The file.
+ * \param figures The figures by scenario.
+ * \return false if the file cannot be opened.
+ */
+static bool
+ReadBaseline(const std::string& path, std::map<std::string, ScenarioFigures>& figures)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::size_t open = line.find('"');
+        std::size_t close = line.find('"', open + 1);
+        std::size_t brace = line.find('{', close);
+        if (open == std::string::npos || close == std::string::npos ||
+            brace == std::string::npos)
+        {
+            continue;
+        }
+        ScenarioFigures& f = figures[line.substr(open + 1, close - open - 1)];
+        std::size_t pos = brace;
+        while ((open = line.find('"', pos)) != std::string::npos &&
+               (close = line.find('"', open + 1)) != std::string::npos)
+        {
+            std::string key = line.substr(open + 1, close - open - 1);
+            std::size_t colon = line.find(':', close);
+            NS_ABORT_MSG_IF(colon == std::string::npos, "Malformed baseline line: " << line);
+            double value = std::stod(line.substr(colon + 1));
+            if (key == "wall_s")
+            {
+                f.wallSeconds = value;
+            }
+            else if (key == "events")
+            {
+                f.events = value;
+            }
+            else if (key == "events_per_s")
+            {
+                f.eventsPerSec = value;
+            }
+            else if (key == "max_rss_kb")
+            {
+                f.maxRssKb = value;
+            }
+            pos = colon + 1;
+        }
+    }
+    return true;
+}
+
+/**
+ * \param current The current figure.
+ * \param baseline The baseline figure.
+ * \return the relative change, 0 without a baseline.
+ */
+static double
+Change(double current, double baseline)
+{
+    return baseline > 0 ? current / baseline - 1 : 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string build_dir = "build/scratch";
+    std::string scenarios;
+    std::string baseline = "scenario-bench-baseline.json";
+    std::string output_dir = "scenario-bench";
+    double tolerance = 0.1;
+    uint32_t repetitions = 3;
+    uint32_t jobs = 1;
+    bool update_baseline = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("build_dir", "Directory of the scratch executables", build_dir);
+    cmd.AddValue("scenarios", "Comma-separated scenario names (empty: all)", scenarios);
+    cmd.AddValue("baseline", "Baseline JSON file", baseline);
+    cmd.AddValue("tolerance", "Relative change allowed before a regression", tolerance);
+    cmd.AddValue("repetitions", "Number of runs of each scenario", repetitions);
+    cmd.AddValue("jobs", "Number of concurrent runs (0: one per core)", jobs);
+    cmd.AddValue("output_dir", "Directory for logs, run statistics and results", output_dir);
+    cmd.AddValue("update_baseline",
+                 "Write the figures of this run to the baseline instead of comparing",
+                 update_baseline);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(repetitions == 0, "At least one repetition is needed");
+
+    std::vector<Scenario> selected;
+    std::vector<std::string> names = SplitList(scenarios, ',');
+    for (const auto& scenario : SCENARIOS)
+    {
+        if (names.empty() || std::find(names.begin(), names.end(), scenario.name) != names.end())
+        {
+            selected.push_back(scenario);
+        }
+    }
+    NS_ABORT_MSG_IF(selected.empty(), "No scenario matches " << scenarios);
+
+    std::map<std::string, ScenarioFigures> reference;
+    if (!update_baseline && !ReadBaseline(baseline, reference))
+    {
+        std::cout << "No baseline in " << baseline << ", recording figures only" << std::endl;
+    }
+
+    std::filesystem::create_directories(output_dir);
+    ProcessPool pool(jobs);
+    for (const auto& scenario : selected)
+    {
+        for (uint32_t r = 0; r < repetitions; r++)
+        {
+            std::string name = output_dir + "/" + scenario.name + "-rep" + std::to_string(r);
+            std::vector<std::string> argv = {build_dir + "/ns3.44-" + scenario.program +
+                                             "-default"};
+            argv.insert(argv.end(), scenario.args.begin(), scenario.args.end());
+            argv.push_back("--RunStatsFile=" + name + ".csv");
+            pool.Add(argv, name + ".log");
+        }
+    }
+
+    std::cout << "Running " << selected.size() * repetitions << " simulations on "
+              << pool.GetWorkers() << " workers" << std::endl;
+    std::vector<ProcessResult> results = pool.Run();
+
+    std::string table = output_dir + "/results.csv";
+    std::ofstream out(table);
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open " << table);
+    out << "scenario,wall_s,events,events_per_s,max_rss_kb,wall_change,rate_change,rss_change,"
+           "status\n";
+
+    std::cout << std::left << std::setw(14) << "scenario" << std::right << std::setw(10)
+              << "wall s" << std::setw(12) << "events" << std::setw(14) << "events/s"
+              << std::setw(12) << "max RSS kB" << std::setw(9) << "wall" << std::setw(9)
+              << "rate" << std::setw(9) << "RSS"
+              << "  status" << std::endl;
+
+    std::map<std::string, ScenarioFigures> figures;
+    uint32_t failed = 0;
+    uint32_t regressed = 0;
+    for (std::size_t s = 0; s < selected.size(); s++)
+    {
+        const std::string& name = selected[s].name;
+        std::vector<double> walls;
+        std::vector<double> rates;
+        ScenarioFigures f;
+        for (uint32_t r = 0; r < repetitions; r++)
+        {
+            const ProcessResult& result = results[s * repetitions + r];
+            RunStats stats;
+            std::string file = output_dir + "/" + name + "-rep" + std::to_string(r) + ".csv";
+            if (result.exitStatus != 0 || !ReadRunStats(file, stats))
+            {
+                continue;
+            }
+            walls.push_back(result.wallSeconds);
+            rates.push_back(stats.wallSeconds > 0 ? stats.events / stats.wallSeconds : 0);
+            f.events = stats.events;
+            f.maxRssKb = std::max<uint64_t>(f.maxRssKb, result.maxRssKb);
+        }
+        if (walls.size() < repetitions)
+        {
+            failed++;
+            std::cout << std::left << std::setw(14) << name << "failed, see its .log files"
+                      << std::endl;
+            out << name << ",,,,,,,,failed\n";
+            continue;
+        }
+        std::sort(walls.begin(), walls.end());
+        std::sort(rates.begin(), rates.end());
+        f.wallSeconds = walls[walls.size() / 2];
+        f.eventsPerSec = rates[rates.size() / 2];
+        figures[name] = f;
+
+        double wallChange = 0;
+        double rateChange = 0;
+        double rssChange = 0;
+        std::string status = "new";
+        auto it = reference.find(name);
+        if (update_baseline)
+        {
+            status = "recorded";
+        }
+        else if (it != reference.end())
+        {
+            const ScenarioFigures& b = it->second;
+            wallChange = Change(f.wallSeconds, b.wallSeconds);
+            rateChange = Change(f.eventsPerSec, b.eventsPerSec);
+            rssChange = Change(f.maxRssKb, b.maxRssKb);
+            status = "ok";
+            if (wallChange > tolerance || rateChange < -tolerance || rssChange > tolerance)
+            {
+                status = "REGRESSION";
+                regressed++;
+            }
+            if (f.events != b.events)
+            {
+                status += " (events " + std::to_string(b.events) + " -> " +
+                          std::to_string(f.events) + ")";
+            }
+        }
+
+        out << name << "," << f.wallSeconds << "," << f.events << "," << f.eventsPerSec << ","
+            << f.maxRssKb << "," << wallChange << "," << rateChange << "," << rssChange << ","
+            << status << "\n";
+        std::cout << std::left << std::setw(14) << name << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(10) << f.wallSeconds << std::setw(12)
+                  << f.events << std::setprecision(0) << std::setw(14) << f.eventsPerSec
+                  << std::setw(12) << f.maxRssKb << std::showpos << std::setprecision(1)
+                  << std::setw(8) << 100 * wallChange << "%" << std::setw(8) << 100 * rateChange
+                  << "%" << std::setw(8) << 100 * rssChange << "%" << std::noshowpos << "  "
+                  << status << std::defaultfloat << std::endl;
+    }
+
+    if (update_baseline)
+    {
+        // Keep the baseline of scenarios that were not run this time
+        std::map<std::string, ScenarioFigures> merged;
+        ReadBaseline(baseline, merged);
+        for (const auto& [name, f] : figures)
+        {
+            merged[name] = f;
+        }
+        WriteBaseline(baseline, merged);
+        std::cout << "Baseline of " << figures.size() << " scenarios written to " << baseline
+                  << std::endl;
+    }
+
+    std::cout << "Results written to " << table;
+    if (regressed > 0 || failed > 0)
+    {
+        std::cout << " (" << regressed << " regressions, " << failed << " failed scenarios)";
+    }
+    std::cout << std::endl;
+
+    return (regressed > 0 || failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+// Event scheduler benchmark over the lab scenarios.
+//
+// Runs every scenario once per scheduler and repetition, each as its own
+// process with --SchedulerType and --RunStatsFile, and reports the events
+// executed, the median wall time of Simulator::Run and the event rate, next to
+// the speedup over the first scheduler of the list.  Runs are sequential by
+// default so that they do not compete for cores and caches.
+//
+// With --check, every scenario also runs once under ns3::LadderCheckScheduler,
+// which feeds its event stream to both LadderScheduler and MapScheduler and
+// aborts when they disagree on the next event.
+//
+// ./ns3 run "scheduler-bench --repetitions=5"
+// ./ns3 run "scheduler-bench --programs=five
+//            --schedulers=ns3::HeapScheduler,ns3::LadderScheduler --extra_args=--num_flows=10"
+
+#include "process-runner.h"
+#include "run-stats.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("SchedulerBench");
+
+int
+main(int argc, char* argv[])
+{
+    std::string build_dir = "build/scratch";
+    std::string programs = "lab1,five,lab7";
+    std::string schedulers = "ns3::MapScheduler,ns3::HeapScheduler,ns3::ListScheduler,"
+                             "ns3::CalendarScheduler,ns3::LadderScheduler";
+    std::string extra_args;
+    std::string output_dir = "scheduler-bench";
+    uint32_t repetitions = 3;
+    uint32_t jobs = 1;
+    bool check = true;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("build_dir", "Directory of the scratch executables", build_dir);
+    cmd.AddValue("programs", "Comma-separated scenarios", programs);
+    cmd.AddValue("schedulers",
+                 "Comma-separated scheduler types, the first the reference",
+                 schedulers);
+    cmd.AddValue("extra_args", "Space-separated arguments passed to every run", extra_args);
+    cmd.AddValue("repetitions", "Number of runs of each scenario and scheduler", repetitions);
+    cmd.AddValue("jobs", "Number of concurrent runs (0: one per core)", jobs);
+    cmd.AddValue("output_dir",
+                 "Directory for logs, run statistics and the results table",
+                 output_dir);
+    cmd.AddValue("check",
+                 "Also run every scenario once with LadderScheduler checked against MapScheduler",
+                 check);
+    cmd.Parse(argc, argv);
+
+    std::vector<std::string> programList = SplitList(programs, ',');
+    std::vector<std::string> schedulerList = SplitList(schedulers, ',');
+    NS_ABORT_MSG_IF(programList.empty() || schedulerList.empty(), "Empty benchmark");
+    NS_ABORT_MSG_IF(repetitions == 0, "At least one repetition is needed");
+
+    std::filesystem::create_directories(output_dir);
+    std::vector<std::string> extra = SplitList(extra_args, ' ');
+
+    ProcessPool pool(jobs);
+    std::vector<std::string> statsFiles;
+    for (std::size_t p = 0; p < programList.size(); p++)
+    {
+        for (std::size_t s = 0; s < schedulerList.size(); s++)
+        {
+            for (uint32_t r = 0; r < repetitions; r++)
+            {
+                std::string name = output_dir + "/" + programList[p] + "-sched" +
+                                   std::to_string(s) + "-rep" + std::to_string(r);
+                std::vector<std::string> argv = {build_dir + "/ns3.44-" + programList[p] +
+                                                 "-default"};
+                argv.insert(argv.end(), extra.begin(), extra.end());
+                argv.push_back("--SchedulerType=" + schedulerList[s]);
+                argv.push_back("--RunStatsFile=" + name + ".csv");
+                pool.Add(argv, name + ".log");
+                statsFiles.push_back(name + ".csv");
+            }
+        }
+    }
+    std::vector<std::string> checkFiles;
+    for (std::size_t p = 0; check && p < programList.size(); p++)
+    {
+        std::string name = output_dir + "/" + programList[p] + "-check";
+        std::vector<std::string> argv = {build_dir + "/ns3.44-" + programList[p] + "-default"};
+        argv.insert(argv.end(), extra.begin(), extra.end());
+        argv.push_back("--SchedulerType=ns3::LadderCheckScheduler");
+        argv.push_back("--RunStatsFile=" + name + ".csv");
+        pool.Add(argv, name + ".log");
+        checkFiles.push_back(name + ".csv");
+    }
+
+    std::cout << "Running " << statsFiles.size() + checkFiles.size() << " simulations on "
+              << pool.GetWorkers() << " workers" << std::endl;
+    std::vector<ProcessResult> results = pool.Run();
+
+    std::string table = output_dir + "/results.csv";
+    std::ofstream out(table);
+    NS_ABORT_MSG_UNLESS(out.is_open(), "Cannot open " << table);
+    out << "program,scheduler,events,wall_s,events_per_s,speedup\n";
+
+    std::cout << std::left << std::setw(10) << "program" << std::setw(26) << "scheduler"
+              << std::right << std::setw(12) << "events" << std::setw(10) << "wall s"
+              << std::setw(14) << "events/s" << std::setw(9) << "speedup" << std::endl;
+
+    uint32_t failed = 0;
+    std::size_t job = 0;
+    for (const auto& program : programList)
+    {
+        double reference = 0;
+        for (const auto& scheduler : schedulerList)
+        {
+            std::vector<double> walls;
+            uint64_t events = 0;
+            for (uint32_t r = 0; r < repetitions; r++, job++)
+            {
+                RunStats stats;
+                if (results[job].exitStatus != 0 || !ReadRunStats(statsFiles[job], stats))
+                {
+                    failed++;
+                    continue;
+                }
+                walls.push_back(stats.wallSeconds);
+                events = stats.events;
+            }
+            if (walls.empty())
+            {
+                std::cout << std::left << std::setw(10) << program << std::setw(26) << scheduler
+                          << "failed" << std::endl;
+                continue;
+            }
+            std::sort(walls.begin(), walls.end());
+            double wall = walls[walls.size() / 2];
+            if (reference == 0)
+            {
+                reference = wall;
+            }
+            double speedup = wall > 0 ? reference / wall : 0;
+            double rate = wall > 0 ? events / wall : 0;
+
+            out << program << "," << scheduler << "," << events << "," << wall << "," << rate
+                << "," << speedup << "\n";
+            std::cout << std::left << std::setw(10) << program << std::setw(26) << scheduler
+                      << std::right << std::setw(12) << events << std::fixed
+                      << std::setprecision(3) << std::setw(10) << wall << std::setprecision(0)
+                      << std::setw(14) << rate << std::setprecision(2) << std::setw(9) << speedup
+                      << std::defaultfloat << std::endl;
+        }
+    }
+
+    for (std::size_t p = 0; p < checkFiles.size(); p++, job++)
+    {
+        RunStats stats;
+        std::cout << "check " << programList[p] << ": ";
+        if (results[job].exitStatus != 0 || !ReadRunStats(checkFiles[p], stats))
+        {
+            failed++;
+            std::cout << "FAILED (exit " << results[job].exitStatus << ")" << std::endl;
+            continue;
+        }
+        std::cout << stats.events << " events in the same order under LadderScheduler and "
+                  << "MapScheduler" << std::endl;
+    }
+
+    std::cout << "Results written to " << table;
+    if (failed > 0)
+    {
+        std::cout << " (" << failed << " runs failed, see their .log files)";
+    }
+    std::cout << std::endl;
+
+    return failed > 0 ? 1 : 0;
+}
@@ -1,24 +1,41 @@
+/*
+ * Interactive TCP client, or with -b a bulk sender that streams a file (or
+ * the pipe on stdin with -b -) to `server-real -b` without copying it
+ * through user space: sendfile for files, splice for pipes, and with -z
+ * MSG_ZEROCOPY sends from a mapping of the file.
+ *
+ *   client-real [-a address] [-p port] [-b file|-] [-z]
+ */
+#define _GNU_SOURCE
 #include "/usr/include/arpa/inet.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
+#define BULK_CHUNK (1 << 20) /* bytes per sendfile/splice/send call */
 
-int main() {
-  int sock = 0;
-  struct sockaddr_in server_addr;
-  char buffer[BUFFER_SIZE] = {0};
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
 
-  sock = socket(AF_INET, SOCK_STREAM, 0);
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(PORT);
-  server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-  connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr));
+static void interactive(int sock) {
+  char buffer[BUFFER_SIZE] = {0};
 
   while (1) {
     printf("Enter the message: ");
@@ -30,6 +47,221 @@ int main() {
     recv(sock, buffer, BUFFER_SIZE, 0);
     printf("Server Reply: %s", buffer);
   }
+}
+
+static uint64_t send_file(int sock, int fd, off_t size) {
+  off_t offset = 0;
+  while (offset < size) {
+    ssize_t n = sendfile(sock, fd, &offset, BULK_CHUNK);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("sendfile");
+      exit(1);
+    }
+    if (n == 0) {
+      break; /* file shrank under us */
+    }
+  }
+  return offset;
+}
+
+static uint64_t send_pipe(int sock, int fd) {
+  uint64_t total = 0;
+  for (;;) {
+    ssize_t n = splice(fd, NULL, sock, NULL, BULK_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("splice");
+      exit(1);
+    }
+    if (n == 0) {
+      return total;
+    }
+    total += n;
+  }
+}
+
+/* Plain read/send, for inputs that neither sendfile nor splice accept */
+static uint64_t send_copy(int sock, int fd) {
+  static char buffer[BULK_CHUNK];
+  uint64_t total = 0;
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t off = 0; off < n;) {
+      ssize_t sent = send(sock, buffer + off, n - off, 0);
+      if (sent < 0) {
+        perror("send");
+        exit(1);
+      }
+      off += sent;
+    }
+    total += n;
+  }
+  return total;
+}
+
+#ifdef SO_ZEROCOPY
+/* Drain the MSG_ZEROCOPY completion notifications, returning how many sends
+ * they cover */
+static uint32_t reap_completions(int sock, int wait) {
+  uint32_t done = 0;
+  for (;;) {
+    char control[128];
+    struct msghdr msg = {.msg_control = control, .msg_controllen = sizeof(control)};
+    if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno != EAGAIN || !wait || done > 0) {
+        return done;
+      }
+      struct pollfd pfd = {.fd = sock, .events = 0}; /* POLLERR is always reported */
+      poll(&pfd, 1, 100);
+      continue;
+    }
+    struct cmsghdr *cm;
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+      if (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+        done += err->ee_data - err->ee_info + 1; /* inclusive range of send ids */
+      }
+    }
+  }
+}
+
+/* Send from a read-only mapping of the file with MSG_ZEROCOPY.  The pages
+ * are only released when the kernel has reported every send complete. */
+static uint64_t send_zerocopy(int sock, int fd, off_t size) {
+  int one = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+    perror("SO_ZEROCOPY not supported, using sendfile");
+    return send_file(sock, fd, size);
+  }
+  char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+
+  uint32_t pending = 0;
+  off_t offset = 0;
+  while (offset < size) {
+    size_t len = size - offset < BULK_CHUNK ? size - offset : BULK_CHUNK;
+    ssize_t n = send(sock, map + offset, len, MSG_ZEROCOPY);
+    int copied = 0;
+    if (n < 0 && errno == ENOBUFS && pending == 0) {
+      /* out of optmem with nothing in flight to wait for: copy this chunk */
+      n = send(sock, map + offset, len, 0);
+      copied = 1;
+    }
+    if (n < 0) {
+      if (errno == ENOBUFS && pending > 0) {
+        pending -= reap_completions(sock, 1); /* out of optmem, wait for some */
+        continue;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("send");
+      exit(1);
+    }
+    offset += n;
+    pending += !copied; /* copied sends have no completion */
+    pending -= reap_completions(sock, 0);
+  }
+  while (pending > 0) {
+    pending -= reap_completions(sock, 1);
+  }
+  munmap(map, size);
+  return offset;
+}
+#endif
+
+static void bulk(int sock, const char *path, int zerocopy) {
+  int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0) {
+    perror("open");
+    exit(1);
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    exit(1);
+  }
+
+  double start = now();
+  uint64_t total;
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+#ifdef SO_ZEROCOPY
+    total = zerocopy ? send_zerocopy(sock, fd, st.st_size) : send_file(sock, fd, st.st_size);
+#else
+    if (zerocopy) {
+      fprintf(stderr, "MSG_ZEROCOPY not available, using sendfile\n");
+    }
+    total = send_file(sock, fd, st.st_size);
+#endif
+  } else if (S_ISFIFO(st.st_mode)) {
+    total = send_pipe(sock, fd);
+  } else {
+    total = send_copy(sock, fd);
+  }
+
+  /* The server answers once it has everything on disk */
+  shutdown(sock, SHUT_WR);
+  char reply[BUFFER_SIZE] = {0};
+  ssize_t n = recv(sock, reply, BUFFER_SIZE - 1, MSG_WAITALL);
+  double seconds = now() - start;
+  printf("sent %llu bytes in %.3f s: %.1f Mbit/s\n", (unsigned long long)total, seconds,
+         total * 8 / seconds / 1e6);
+  if (n > 0) {
+    printf("Server Reply: %s", reply);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int sock = 0;
+  struct sockaddr_in server_addr;
+  const char *address = "127.0.0.1";
+  const char *path = NULL;
+  int port = PORT;
+  int zerocopy = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "a:p:b:z")) != -1) {
+    switch (opt) {
+    case 'a':
+      address = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'b':
+      path = optarg;
+      break;
+    case 'z':
+      zerocopy = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-a address] [-p port] [-b file|-] [-z]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  server_addr.sin_addr.s_addr = inet_addr(address);
+  if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    perror("connect");
+    exit(1);
+  }
+
+  if (path != NULL) {
+    bulk(sock, path, zerocopy);
+  } else {
+    interactive(sock);
+  }
 
   close(sock);
   return 0;
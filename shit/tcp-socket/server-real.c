@@ -1,44 +1,349 @@
+/*
+ * Interactive TCP server, or with -b a bulk receiver that moves everything
+ * the client sends into a file with splice (socket -> pipe -> file), without
+ * copying it through user space.
+ *
+ * With -u the same two modes run on io_uring instead: multishot accept,
+ * multishot recv into a provided buffer ring, and every request generated
+ * while handling a batch of completions submitted with one io_uring_enter.
+ * The interactive mode then serves any number of clients concurrently.
+ *
+ *   server-real [-p port] [-b output_file] [-u]
+ */
+#define _GNU_SOURCE
 #include "/usr/include/arpa/inet.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../uring.h"
+
 #define PORT 8080
 #define BUFFER_SIZE 1024
+#define PIPE_SIZE (1 << 20)
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void interactive(int client_d) {
+  char buffer[BUFFER_SIZE] = {0};
+
+  while (1) {
+
+    memset(buffer, 0, BUFFER_SIZE);
+    if (recv(client_d, buffer, BUFFER_SIZE, 0) <= 0) {
+      break;
+    }
+    printf("received %s", buffer);
+    send(client_d, "message received \n", 17, 0);
+    if (strncmp(buffer, "exit", 4) == 0) {
+      break;
+    }
+  }
+}
+
+/* Move len bytes from the pipe to the file */
+static void drain(int pipe_rd, int fd, size_t len) {
+  while (len > 0) {
+    ssize_t n = splice(pipe_rd, NULL, fd, NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("splice to file");
+      exit(1);
+    }
+    len -= n;
+  }
+}
+
+static void bulk(int client_d, const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("open");
+    exit(1);
+  }
+  int pipefd[2];
+  if (pipe2(pipefd, 0) < 0) {
+    perror("pipe2");
+    exit(1);
+  }
+  fcntl(pipefd[1], F_SETPIPE_SZ, PIPE_SIZE); /* best effort, bounded by pipe-max-size */
+
+  double start = now();
+  uint64_t total = 0;
+  for (;;) {
+    ssize_t n = splice(client_d, NULL, pipefd[1], NULL, PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("splice from socket");
+      exit(1);
+    }
+    if (n == 0) {
+      break;
+    }
+    drain(pipefd[0], fd, n);
+    total += n;
+  }
+  double seconds = now() - start;
+
+  char reply[BUFFER_SIZE];
+  int len = snprintf(reply, sizeof(reply), "received %llu bytes\n", (unsigned long long)total);
+  send(client_d, reply, len, 0);
+  printf("received %llu bytes into %s in %.3f s: %.1f Mbit/s\n", (unsigned long long)total,
+         path, seconds, total * 8 / seconds / 1e6);
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+  close(fd);
+}
+
+#ifdef URING_SUPPORTED
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256
+#define URING_BUFFER_SIZE 65536
+#define MAX_FDS 65536
+
+/* user_data of a request: operation, buffer id (for OP_SEND: whether to shut
+   the connection down once the reply is out) and file descriptor */
+enum { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_WRITE };
+#define USER_DATA(op, bid, fd) ((uint64_t)(op) << 56 | (uint64_t)(bid) << 32 | (uint32_t)(fd))
+#define USER_OP(data) ((int)((data) >> 56))
+#define USER_BID(data) ((uint16_t)((data) >> 32))
+#define USER_FD(data) ((int)(uint32_t)(data))
+
+static const char reply_text[] = "message received \n";
+
+static void arm_accept(struct uring *r, int server_fd, int multishot) {
+  struct io_uring_sqe *sqe = uring_sqe(r);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = server_fd;
+  sqe->ioprio = multishot ? IORING_ACCEPT_MULTISHOT : 0;
+  sqe->user_data = USER_DATA(OP_ACCEPT, 0, server_fd);
+}
+
+static void arm_recv(struct uring *r, struct uring_bufs *b, int fd) {
+  struct io_uring_sqe *sqe = uring_sqe(r);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = b->bgid;
+  sqe->user_data = USER_DATA(OP_RECV, 0, fd);
+}
+
+/* Returns -1 without serving anything when io_uring cannot be set up */
+static int serve_uring(int server_fd, const char *path) {
+  struct uring r;
+  struct uring_bufs bufs;
+  if (uring_init(&r, URING_ENTRIES) < 0 ||
+      uring_bufs_init(&r, &bufs, 0, URING_BUFFERS, URING_BUFFER_SIZE) < 0) {
+    perror("io_uring unavailable, using the blocking loop");
+    return -1;
+  }
+  int out = -1;
+  if (path != NULL && (out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    perror("open");
+    exit(1);
+  }
+
+  /* Connections whose multishot recv stopped for lack of buffers */
+  static uint8_t starved[MAX_FDS];
+  int n_starved = 0;
+  /* Bulk mode state: one client, written sequentially */
+  int bulk_fd = -1;
+  int eof = 0;
+  uint64_t total = 0;
+  uint64_t writes = 0;
+  double start = 0;
+
+  arm_accept(&r, server_fd, path == NULL);
+  for (;;) {
+    int ret = uring_submit(&r, 1, -1);
+    if (ret < 0 && ret != -EINTR) {
+      errno = -ret;
+      perror("io_uring_enter");
+      exit(1);
+    }
+
+    int recycled = 0;
+    struct io_uring_cqe *cqe;
+    for (; (cqe = uring_peek(&r)) != NULL; uring_seen(&r)) {
+      int res = cqe->res;
+      int fd = USER_FD(cqe->user_data);
+      int more = cqe->flags & IORING_CQE_F_MORE;
+
+      switch (USER_OP(cqe->user_data)) {
+      case OP_ACCEPT:
+        if (res >= 0 && res < MAX_FDS) {
+          printf("Client Connected\n");
+          arm_recv(&r, &bufs, res);
+          if (path != NULL) {
+            bulk_fd = res;
+            start = now();
+          }
+        } else if (res >= 0) {
+          close(res);
+        }
+        if (!more && path == NULL) {
+          arm_accept(&r, server_fd, 1);
+        }
+        break;
+
+      case OP_RECV:
+        if (res > 0) {
+          uint16_t bid = uring_cqe_bid(cqe);
+          char *data = uring_bufs_get(&bufs, bid);
+          if (path != NULL) {
+            /* The buffer goes back to the ring once it is on disk */
+            struct io_uring_sqe *sqe = uring_sqe(&r);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = out;
+            sqe->addr = (uint64_t)(uintptr_t)data;
+            sqe->len = res;
+            sqe->off = total;
+            sqe->user_data = USER_DATA(OP_WRITE, bid, res);
+            total += res;
+            writes++;
+          } else {
+            printf("received %.*s", res, data);
+            struct io_uring_sqe *sqe = uring_sqe(&r);
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)reply_text;
+            sqe->len = 17;
+            int last = res >= 4 && strncmp(data, "exit", 4) == 0;
+            sqe->user_data = USER_DATA(OP_SEND, last, fd);
+            uring_bufs_add(&bufs, bid);
+            recycled = 1;
+          }
+          if (!more) {
+            arm_recv(&r, &bufs, fd);
+          }
+        } else if (res == -ENOBUFS) {
+          starved[fd] = 1;
+          n_starved++;
+        } else if (path != NULL) {
+          eof = 1;
+        } else {
+          close(fd);
+        }
+        break;
 
-int main() {
+      case OP_SEND:
+        if (USER_BID(cqe->user_data)) {
+          shutdown(fd, SHUT_RDWR); /* the recv then ends with 0 */
+        }
+        break;
+
+      case OP_WRITE:
+        if (res != fd) { /* fd holds the length of the write */
+          fprintf(stderr, "short write to %s\n", path);
+          exit(1);
+        }
+        uring_bufs_add(&bufs, USER_BID(cqe->user_data));
+        recycled = 1;
+        writes--;
+        break;
+      }
+    }
+    if (recycled) {
+      uring_bufs_publish(&bufs);
+      for (int fd = 0; n_starved > 0 && fd < MAX_FDS; fd++) {
+        if (starved[fd]) {
+          starved[fd] = 0;
+          n_starved--;
+          arm_recv(&r, &bufs, fd);
+        }
+      }
+    }
+
+    if (eof && writes == 0) {
+      double seconds = now() - start;
+      char reply[BUFFER_SIZE];
+      int len =
+          snprintf(reply, sizeof(reply), "received %llu bytes\n", (unsigned long long)total);
+      send(bulk_fd, reply, len, 0);
+      printf("received %llu bytes into %s in %.3f s: %.1f Mbit/s\n", (unsigned long long)total,
+             path, seconds, total * 8 / seconds / 1e6);
+      close(bulk_fd);
+      close(out);
+      return 0;
+    }
+  }
+}
+#endif
+
+int main(int argc, char *argv[]) {
   int server_fd, client_d;
   struct sockaddr_in address;
-  char buffer[BUFFER_SIZE] = {0};
   int addrlen = sizeof(address);
+  const char *path = NULL;
+  int port = PORT;
+  int use_uring = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:b:u")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'b':
+      path = optarg;
+      break;
+    case 'u':
+      use_uring = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-p port] [-b output_file] [-u]\n", argv[0]);
+      exit(1);
+    }
+  }
 
   server_fd = socket(AF_INET, SOCK_STREAM, 0);
 
   address.sin_family = AF_INET;
-  address.sin_port = htons(PORT);
+  address.sin_port = htons(port);
   address.sin_addr.s_addr = INADDR_ANY;
 
-  bind(server_fd, (struct sockaddr *)&address, addrlen);
+  if (bind(server_fd, (struct sockaddr *)&address, addrlen) < 0) {
+    perror("bind");
+    exit(1);
+  }
+
+  listen(server_fd, use_uring ? SOMAXCONN : 3);
+  printf("server running in port %d\n", port);
+  fflush(stdout);
 
-  listen(server_fd, 3);
-  printf("server running in port 8080");
+  if (use_uring) {
+#ifdef URING_SUPPORTED
+    if (serve_uring(server_fd, path) == 0) {
+      close(server_fd);
+      return 0;
+    }
+#else
+    fprintf(stderr, "built without io_uring support, using the blocking loop\n");
+#endif
+  }
   client_d =
       accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen);
 
   printf("Client Connected\n");
-  while (1) {
-
-    memset(buffer, 0, BUFFER_SIZE);
-    if (recv(client_d, buffer, BUFFER_SIZE, 0) <= 0) {
-      break;
-    }
-    printf("received %s", buffer);
-    send(client_d, "message received \n", 17, 0);
-    if (strncmp(buffer, "exit", 4) == 0) {
-      break;
-    }
+  if (path != NULL) {
+    bulk(client_d, path);
+  } else {
+    interactive(client_d);
   }
   close(client_d);
   close(server_fd);
@@ -1,9 +1,479 @@
-#include "/usr/include/arpa/inet.h"
+#define _GNU_SOURCE
+#include "transfer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#define PORT 8080
-#define filesize 1024
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define CONTROL_TRIES 50
+#define CONTROL_TIMEOUT_MS 200
+#define MIN_WINDOW (4 * BATCH) /* chunks in flight whatever the RTT */
+#define MIN_RTO_US 5000
+#define REORDER 16          /* chunks acknowledged past a hole before it counts as lost */
+#define STALL_US 10000000   /* give up after this long without a SACK */
+
+/* Selective-repeat sender state.  Chunk i is in flight when i < next and its
+ * acked bit is clear; it is sent again once the SACKs show it lost or it is
+ * older than the retransmission timeout. */
+struct sender {
+  int sock;
+  int fd;
+  uint64_t size;
+  uint32_t chunk;
+  uint64_t chunks;
+  uint64_t *sent_us;    /* last transmission of each chunk */
+  uint8_t *acked;       /* one bit per chunk */
+  uint64_t cum;         /* every chunk below is acknowledged */
+  uint64_t next;        /* first chunk never sent */
+  uint64_t highest;     /* highest chunk acknowledged */
+  uint64_t acked_sent;  /* latest transmission time among acknowledged chunks */
+  uint64_t srtt;        /* microseconds, RFC 6298 smoothing */
+  uint64_t rttvar;
+  double rate;          /* pacing rate in bytes per microsecond, 0 for none */
+  uint64_t pace_us;     /* when the next batch may leave */
+  uint64_t last_sack_us;
+  uint64_t sent_bytes;
+  uint64_t retransmits;
+};
+
+static int is_acked(struct sender *s, uint64_t seq) {
+  return s->acked[seq / 8] & (1u << (seq % 8));
+}
+
+static void set_acked(struct sender *s, uint64_t seq) {
+  if (is_acked(s, seq)) {
+    return;
+  }
+  s->acked[seq / 8] |= 1u << (seq % 8);
+  if (seq > s->highest) {
+    s->highest = seq;
+  }
+  if (s->sent_us[seq] > s->acked_sent) {
+    s->acked_sent = s->sent_us[seq];
+  }
+}
+
+static void rtt_sample(struct sender *s, uint64_t rtt) {
+  if (s->srtt == 0) {
+    s->srtt = rtt;
+    s->rttvar = rtt / 2;
+    return;
+  }
+  uint64_t err = rtt > s->srtt ? rtt - s->srtt : s->srtt - rtt;
+  s->rttvar = (3 * s->rttvar + err) / 4;
+  s->srtt = (7 * s->srtt + rtt) / 8;
+}
+
+static uint64_t rto(struct sender *s) {
+  uint64_t t = s->srtt + 4 * s->rttvar;
+  return t < MIN_RTO_US ? MIN_RTO_US : t;
+}
+
+/* Twice the bandwidth-delay product at the pacing rate, so that delayed SACKs
+ * do not stall the pipe */
+static uint64_t window(struct sender *s) {
+  uint64_t w = SACK_SPAN;
+  if (s->rate > 0) {
+    w = 2 * s->rate * s->srtt / s->chunk;
+  }
+  if (w < MIN_WINDOW) {
+    w = MIN_WINDOW;
+  }
+  return w < SACK_SPAN ? w : SACK_SPAN;
+}
+
+static uint32_t chunk_len(struct sender *s, uint64_t seq) {
+  return seq + 1 < s->chunks ? s->chunk : s->size - seq * s->chunk;
+}
+
+static void on_sack(struct sender *s, const char *buf, size_t len) {
+  const struct xfer_hdr *h = (const struct xfer_hdr *)buf;
+  const struct xfer_sack *sack = (const struct xfer_sack *)(buf + sizeof(*h));
+  if (len != sizeof(*h) + sizeof(*sack) || h->type != XFER_SACK) {
+    return;
+  }
+  uint64_t now = xfer_now_us();
+  rtt_sample(s, (uint32_t)((uint32_t)now - be32toh(h->ts)));
+  s->last_sack_us = now;
+
+  uint64_t cum = be32toh(sack->cum);
+  if (cum > s->chunks) {
+    return;
+  }
+  for (; s->cum < cum; s->cum++) {
+    set_acked(s, s->cum);
+  }
+  uint64_t base = be32toh(sack->base);
+  for (uint64_t i = 0; i < SACK_SPAN && base + i < s->chunks; i++) {
+    if (sack->bits[i / 8] & (1u << (i % 8))) {
+      set_acked(s, base + i);
+    }
+  }
+  while (s->cum < s->chunks && is_acked(s, s->cum)) {
+    s->cum++;
+  }
+}
+
+/* Process the SACKs that arrived, waiting up to wait_us for the first one */
+static void read_sacks(struct sender *s, uint64_t wait_us) {
+  struct pollfd pfd = {.fd = s->sock, .events = POLLIN};
+  struct timespec timeout = {.tv_sec = wait_us / 1000000, .tv_nsec = wait_us % 1000000 * 1000};
+  if (wait_us > 0 && ppoll(&pfd, 1, &timeout, NULL) <= 0) {
+    return;
+  }
+
+  char bufs[BATCH][sizeof(struct xfer_hdr) + sizeof(struct xfer_sack)];
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+  for (;;) {
+    for (int i = 0; i < BATCH; i++) {
+      iovs[i].iov_base = bufs[i];
+      iovs[i].iov_len = sizeof(bufs[i]);
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = recvmmsg(s->sock, msgs, BATCH, MSG_DONTWAIT, NULL);
+    if (n <= 0) {
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      on_sack(s, bufs[i], msgs[i].msg_len);
+    }
+  }
+}
+
+/* Lost after the retransmission timeout, or once chunks far enough past it
+ * are acknowledged and one of them left later than it did.  Chunks of one
+ * batch, and so of one GSO train, share their send time: a train delivered
+ * out of order among its own segments is not taken for a loss. */
+static int is_lost(struct sender *s, uint64_t seq, uint64_t now) {
+  uint64_t age = now - s->sent_us[seq];
+  return age > rto(s) || (s->highest >= seq + REORDER && s->acked_sent > s->sent_us[seq] &&
+                          age > s->srtt + s->srtt / 4);
+}
+
+/* Send every message of the batch, resuming after partial sendmmsg returns */
+static void send_batch(int sock, struct mmsghdr *msgs, int count) {
+  int sent = 0;
+  while (sent < count) {
+    int n = sendmmsg(sock, msgs + sent, count - sent, 0);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS) {
+        usleep(100); /* queue full, let it drain */
+        continue;
+      }
+      if (errno == ECONNREFUSED) {
+        continue; /* a previous datagram bounced, nothing to do about it */
+      }
+      perror("sendmmsg");
+      exit(1);
+    }
+    sent += n;
+  }
+}
+
+/* Read the payloads of n records, one preadv per run of consecutive chunks */
+static void read_records(struct sender *s, struct iovec *records, uint64_t *seqs, int n) {
+  for (int first = 0; first < n;) {
+    int last = first + 1;
+    while (last < n && seqs[last] == seqs[last - 1] + 1) {
+      last++;
+    }
+    uint64_t want = 0;
+    for (int i = first; i < last; i++) {
+      want += records[i].iov_len;
+    }
+    ssize_t got = preadv(s->fd, records + first, last - first, seqs[first] * s->chunk);
+    if (got < 0 || (uint64_t)got != want) {
+      perror("preadv");
+      exit(1);
+    }
+    first = last;
+  }
+}
+
+/* Send `len` bytes of control message until a reply of type `expect` comes
+ * back, and return the value the reply carries */
+static uint64_t exchange(int sock, const void *msg, size_t len, uint8_t expect) {
+  struct timeval tv = {.tv_sec = 0, .tv_usec = CONTROL_TIMEOUT_MS * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  for (int i = 0; i < CONTROL_TRIES; i++) {
+    if (send(sock, msg, len, 0) < 0 && errno != ECONNREFUSED) {
+      perror("send");
+      exit(1);
+    }
+    struct xfer_hdr h;
+    ssize_t n;
+    while ((n = recv(sock, &h, sizeof(h), 0)) >= 0) {
+      if (n == sizeof(h) && h.type == expect) {
+        return be64toh(h.offset);
+      }
+    }
+  }
+  fprintf(stderr, "no answer from the server\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  struct sender s;
+  struct sockaddr_in server_addr;
+  int port = PORT;
+  size_t datagram = DEFAULT_DATAGRAM;
+  double rate_mbps = 10000;
+  int gso = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:s:r:g")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 's':
+      datagram = strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      rate_mbps = atof(optarg);
+      break;
+    case 'g':
+      gso = 1;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (argc - optind != 2) {
+  usage:
+    fprintf(stderr,
+            "usage: %s [-p port] [-s datagram_size] [-r rate_mbps] [-g] <server_ip> <file>\n",
+            argv[0]);
+    exit(1);
+  }
+  if (datagram <= sizeof(struct xfer_hdr) || datagram > MAX_DATAGRAM) {
+    fprintf(stderr, "datagram size must be in (%zu, %d]\n", sizeof(struct xfer_hdr), MAX_DATAGRAM);
+    exit(1);
+  }
+
+  memset(&s, 0, sizeof(s));
+  s.rate = rate_mbps / 8; /* Mbit/s is bits per microsecond */
+  s.fd = open(argv[optind + 1], O_RDONLY);
+  if (s.fd < 0) {
+    perror("file open failed");
+    exit(1);
+  }
+  struct stat st;
+  if (fstat(s.fd, &st) < 0) {
+    perror("fstat");
+    exit(1);
+  }
+
+  s.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (s.sock < 0) {
+    perror("socket failed");
+    exit(1);
+  }
+  int sndbuf = 16 << 20;
+  if (setsockopt(s.sock, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof(sndbuf)) < 0) {
+    setsockopt(s.sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+  }
+  if (gso) {
+    /* Every datagram on the wire is one GSO_SEGMENT; the kernel (or the NIC)
+     * cuts the GSO_BUFFER sized sends into them */
+    int segment = GSO_SEGMENT;
+    if (setsockopt(s.sock, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) < 0) {
+      perror("UDP_SEGMENT not supported, continuing without");
+      gso = 0;
+    } else {
+      datagram = GSO_SEGMENT;
+    }
+  }
+
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, argv[optind], &server_addr.sin_addr) != 1) {
+    fprintf(stderr, "invalid address %s\n", argv[optind]);
+    exit(1);
+  }
+  if (connect(s.sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    perror("connect");
+    exit(1);
+  }
+
+  s.size = st.st_size;
+  s.chunk = datagram - sizeof(struct xfer_hdr);
+  s.chunks = xfer_chunks(s.size, s.chunk);
+  s.sent_us = calloc(s.chunks + 1, sizeof(uint64_t));
+  s.acked = calloc(s.chunks / 8 + 1, 1);
+  if (s.sent_us == NULL || s.acked == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+
+  struct {
+    struct xfer_hdr h;
+    struct xfer_start s;
+  } __attribute__((packed)) start;
+  xfer_hdr_set(&start.h, XFER_START, 0, 0);
+  start.s.size = htobe64(s.size);
+  start.s.chunk = htobe32(s.chunk);
+  memset(start.s.name, 0, MAX_NAME);
+  strncpy(start.s.name, basename(argv[optind + 1]), MAX_NAME - 1);
+  uint64_t begin = xfer_now_us();
+  exchange(s.sock, &start, sizeof(start), XFER_START_ACK);
+  rtt_sample(&s, xfer_now_us() - begin);
+
+  /* Each message is a run of `per_msg` records [header][chunk]: one record
+   * per message normally, a whole GSO train with -g */
+  int per_msg = gso ? GSO_BUFFER / GSO_SEGMENT : 1;
+  size_t msg_bytes = (size_t)per_msg * datagram;
+  char *buffers = malloc((size_t)BATCH * msg_bytes);
+  struct iovec *records = malloc((size_t)per_msg * sizeof(struct iovec));
+  uint64_t *seqs = malloc((size_t)per_msg * sizeof(uint64_t));
+  /* Every record of the batch, stamped when the batch actually leaves */
+  struct xfer_hdr **batch_hdrs = malloc((size_t)BATCH * per_msg * sizeof(*batch_hdrs));
+  uint64_t *batch_seqs = malloc((size_t)BATCH * per_msg * sizeof(uint64_t));
+  if (buffers == NULL || records == NULL || seqs == NULL || batch_hdrs == NULL ||
+      batch_seqs == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+
+  s.last_sack_us = xfer_now_us();
+  uint64_t scan = 0; /* where the loss scan resumes */
+  while (s.cum < s.chunks) {
+    read_sacks(&s, 0);
+    uint64_t now = xfer_now_us();
+    if (now - s.last_sack_us > STALL_US) {
+      fprintf(stderr, "server stopped acknowledging\n");
+      exit(1);
+    }
+
+    /* Fill the batch with lost chunks first, then new ones while the window
+     * allows */
+    int count = 0;
+    int n = 0;
+    int n_batch = 0;
+    uint64_t batch_bytes = 0;
+    if (scan < s.cum) {
+      scan = s.cum;
+    }
+    uint64_t limit = s.cum + window(&s);
+    while (count < BATCH) {
+      uint64_t seq;
+      while (scan < s.next && (is_acked(&s, scan) || !is_lost(&s, scan, now))) {
+        scan++;
+      }
+      if (scan < s.next) {
+        seq = scan++;
+        s.retransmits++;
+      } else if (s.next < s.chunks && s.next < limit) {
+        seq = s.next++;
+      } else {
+        break;
+      }
+
+      char *rec = buffers + (size_t)count * msg_bytes + (size_t)n * datagram;
+      struct xfer_hdr *h = (struct xfer_hdr *)rec;
+      xfer_hdr_set(h, XFER_DATA, seq, seq * s.chunk);
+      s.sent_us[seq] = now; /* in flight for the scan of this batch already */
+      batch_hdrs[n_batch] = h;
+      batch_seqs[n_batch++] = seq;
+      records[n].iov_base = rec + sizeof(*h);
+      records[n].iov_len = chunk_len(&s, seq);
+      seqs[n] = seq;
+      batch_bytes += sizeof(*h) + records[n].iov_len;
+      if (++n == per_msg) {
+        read_records(&s, records, seqs, n);
+        iovs[count].iov_len = (size_t)(n - 1) * datagram + sizeof(*h) + records[n - 1].iov_len;
+        n = 0;
+        count++;
+      }
+    }
+    if (n > 0) {
+      /* Only the last record of a GSO train may be short, and only the
+       * file's last chunk is short, so the train is well formed as long as
+       * the records are packed at the segment stride */
+      read_records(&s, records, seqs, n);
+      iovs[count].iov_len = (size_t)(n - 1) * datagram + sizeof(struct xfer_hdr) +
+                            records[n - 1].iov_len;
+      count++;
+    }
+    if (scan >= s.next) {
+      scan = s.cum; /* next pass starts over from the first hole */
+    }
+
+    if (count == 0) {
+      /* Window full and nothing due again yet */
+      read_sacks(&s, s.srtt / 4 + 1);
+      continue;
+    }
+    for (int i = 0; i < count; i++) {
+      iovs[i].iov_base = buffers + (size_t)i * msg_bytes;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* Pace: hold the batch until the previous ones have drained at the
+     * configured rate, reading SACKs meanwhile */
+    if (s.rate > 0) {
+      if (s.pace_us < now) {
+        s.pace_us = now;
+      }
+      while ((now = xfer_now_us()) < s.pace_us) {
+        read_sacks(&s, s.pace_us - now);
+      }
+      s.pace_us += batch_bytes / s.rate;
+    }
+    /* Stamp the records now rather than when the batch was built: a paced
+     * batch, the more so one of GSO trains, may have waited for several
+     * RTOs, which made its chunks look lost as soon as it left */
+    now = xfer_now_us();
+    for (int i = 0; i < n_batch; i++) {
+      batch_hdrs[i]->ts = htobe32(now);
+      s.sent_us[batch_seqs[i]] = now;
+    }
+    send_batch(s.sock, msgs, count);
+    s.sent_bytes += batch_bytes;
+  }
+
+  struct xfer_hdr end;
+  xfer_hdr_set(&end, XFER_END, 0, s.size);
+  uint64_t stored = exchange(s.sock, &end, sizeof(end), XFER_END_ACK);
+
+  double seconds = (xfer_now_us() - begin) / 1e6;
+  printf("file sent: %llu bytes in %llu chunks, %llu retransmitted, %.3f s, %.1f Mbit/s, "
+         "server stored %llu\n",
+         (unsigned long long)s.size, (unsigned long long)s.chunks,
+         (unsigned long long)s.retransmits, seconds, s.size * 8 / seconds / 1e6,
+         (unsigned long long)stored);
+  free(batch_seqs);
+  free(batch_hdrs);
+  free(seqs);
+  free(records);
+  free(buffers);
+  free(s.sent_us);
+  free(s.acked);
+  close(s.fd);
+  close(s.sock);
+  return stored == s.size ? 0 : 1;
+}
@@ -1,50 +1,412 @@
+#define _GNU_SOURCE
+#include "transfer.h"
+
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#define PORT 8080
-#define MAXLINE 1024
+#include "../uring.h"
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define RECV_BUFFER 65536 /* a GRO train can fill a whole 64 KB buffer */
+#define RUN_MAX 1024      /* iovecs per pwritev */
+
+struct receiver {
+  int sock;
+  int fd;
+  uint64_t size;
+  uint32_t chunk;
+  uint64_t chunks;
+  uint8_t *seen; /* one bit per chunk */
+  uint64_t stored_chunks;
+  uint64_t stored_bytes;
+  uint64_t cum;     /* first chunk not stored yet */
+  uint32_t last_ts; /* timestamp of the newest DATA, still big endian */
+  int got_data;
+  int done;
+  double loss; /* drop probability, a local stand-in for netem */
+  unsigned int seed;
+  /* Run of contiguous new chunks waiting for one pwritev */
+  uint64_t run_offset;
+  uint64_t run_bytes;
+  int run_len;
+  struct iovec run[RUN_MAX];
+};
+
+static void flush_run(struct receiver *r) {
+  if (r->run_len == 0) {
+    return;
+  }
+  ssize_t n = pwritev(r->fd, r->run, r->run_len, r->run_offset);
+  if (n < 0 || (uint64_t)n != r->run_bytes) {
+    perror("pwritev");
+    exit(1);
+  }
+  r->run_len = 0;
+  r->run_bytes = 0;
+}
+
+static void store(struct receiver *r, uint32_t seq, uint64_t offset, char *data, size_t len) {
+  if (seq >= r->chunks || offset != (uint64_t)seq * r->chunk || offset + len > r->size ||
+      (len != r->chunk && offset + len != r->size)) {
+    return; /* not a chunk of this file */
+  }
+  if (r->seen[seq / 8] & (1u << (seq % 8))) {
+    return; /* duplicate */
+  }
+  r->seen[seq / 8] |= 1u << (seq % 8);
+  r->stored_chunks++;
+  r->stored_bytes += len;
+
+  if (r->run_len == RUN_MAX || (r->run_len > 0 && r->run_offset + r->run_bytes != offset)) {
+    flush_run(r);
+  }
+  if (r->run_len == 0) {
+    r->run_offset = offset;
+  }
+  r->run[r->run_len].iov_base = data;
+  r->run[r->run_len].iov_len = len;
+  r->run_len++;
+  r->run_bytes += len;
+}
+
+static void reply(struct receiver *r, uint8_t type, uint64_t value) {
+  struct xfer_hdr h;
+  xfer_hdr_set(&h, type, 0, value);
+  send(r->sock, &h, sizeof(h), 0);
+}
+
+static int lost(struct receiver *r) {
+  return r->loss > 0 && rand_r(&r->seed) < r->loss * ((double)RAND_MAX + 1);
+}
+
+/* Tell the client what is stored: everything below cum, and a bitmap of the
+ * SACK_SPAN chunks from cum rounded down to a byte */
+static void send_sack(struct receiver *r) {
+  while (r->cum < r->chunks && (r->seen[r->cum / 8] & (1u << (r->cum % 8)))) {
+    r->cum++;
+  }
+  struct {
+    struct xfer_hdr h;
+    struct xfer_sack s;
+  } __attribute__((packed)) sack;
+  uint64_t base = r->cum & ~(uint64_t)7;
+  uint64_t bytes = (r->chunks + 7) / 8 - base / 8;
+  xfer_hdr_set(&sack.h, XFER_SACK, 0, r->stored_bytes);
+  sack.h.ts = r->last_ts;
+  sack.s.cum = htobe32(r->cum);
+  sack.s.base = htobe32(base);
+  memset(sack.s.bits, 0, SACK_BYTES);
+  memcpy(sack.s.bits, r->seen + base / 8, bytes < SACK_BYTES ? bytes : SACK_BYTES);
+  if (!lost(r)) {
+    send(r->sock, &sack, sizeof(sack), 0);
+  }
+  r->got_data = 0;
+}
+
+static void handle(struct receiver *r, char *buf, size_t len) {
+  if (len < sizeof(struct xfer_hdr)) {
+    return;
+  }
+  struct xfer_hdr *h = (struct xfer_hdr *)buf;
+  switch (h->type) {
+  case XFER_DATA:
+    store(r, be32toh(h->seq), be64toh(h->offset), buf + sizeof(*h), len - sizeof(*h));
+    r->last_ts = h->ts;
+    r->got_data = 1;
+    break;
+  case XFER_START:
+    reply(r, XFER_START_ACK, 0); /* our first ack was lost */
+    break;
+  case XFER_END:
+    flush_run(r);
+    reply(r, XFER_END_ACK, r->stored_bytes);
+    r->done = 1;
+    break;
+  }
+}
+
+static void set_timeout(int sock, int ms) {
+  struct timeval tv = {.tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+/* Handle one received buffer.  With GRO it holds a train of datagrams of
+ * `segment` bytes, the last one possibly shorter. */
+static void handle_buffer(struct receiver *r, char *buf, size_t len, size_t segment) {
+  if (segment == 0) {
+    segment = len;
+  }
+  for (size_t off = 0; off < len; off += segment) {
+    if (lost(r)) {
+      continue;
+    }
+    handle(r, buf + off, len - off < segment ? len - off : segment);
+  }
+}
+
+/* End of a batch: write what it brought and acknowledge it */
+static void end_batch(struct receiver *r) {
+  flush_run(r);
+  if (r->got_data) {
+    send_sack(r);
+  }
+}
+
+/* The GRO segment size of a received message, 0 when not coalesced */
+static size_t gro_segment(struct msghdr *msg) {
+  struct cmsghdr *cm;
+  for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+    if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+      return *(int *)CMSG_DATA(cm);
+    }
+  }
+  return 0;
+}
+
+static void serve_blocking(struct receiver *r) {
+  char *buffers = malloc((size_t)BATCH * RECV_BUFFER);
+  if (buffers == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+  char control[BATCH][CMSG_SPACE(sizeof(int))];
+
+  set_timeout(r->sock, 10000);
+  for (;;) {
+    for (int i = 0; i < BATCH; i++) {
+      iovs[i].iov_base = buffers + (size_t)i * RECV_BUFFER;
+      iovs[i].iov_len = RECV_BUFFER;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = control[i];
+      msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    int n = recvmmsg(r->sock, msgs, BATCH, MSG_WAITFORONE, NULL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break; /* idle timeout, or the client went away */
+    }
+    for (int i = 0; i < n; i++) {
+      handle_buffer(r, iovs[i].iov_base, msgs[i].msg_len, gro_segment(&msgs[i].msg_hdr));
+    }
+    end_batch(r);
+
+    if (r->done) {
+      /* Keep answering the END retransmissions for a little while */
+      set_timeout(r->sock, 500);
+    }
+  }
+  free(buffers);
+}
+
+#ifdef URING_SUPPORTED
+#define URING_ENTRIES 64
+#define URING_BUFFERS 256
+
+static void arm_recvmsg(struct uring *u, struct uring_bufs *b, int sock, struct msghdr *tmpl) {
+  struct io_uring_sqe *sqe = uring_sqe(u);
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = sock;
+  sqe->addr = (uint64_t)(uintptr_t)tmpl;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = b->bgid;
+}
+
+/* Multishot recvmsg into a provided buffer ring: one io_uring_enter waits
+ * for, and re-arms after, a whole batch of datagrams.  Returns -1 without
+ * receiving anything when io_uring cannot be set up. */
+static int serve_uring(struct receiver *r) {
+  struct uring u;
+  struct uring_bufs bufs;
+  /* Each buffer holds the io_uring_recvmsg_out header, the control data and
+   * the payload */
+  unsigned size = sizeof(struct io_uring_recvmsg_out) + CMSG_SPACE(sizeof(int)) + RECV_BUFFER;
+  if (uring_init(&u, URING_ENTRIES) < 0 || uring_bufs_init(&u, &bufs, 0, URING_BUFFERS, size) < 0) {
+    perror("io_uring unavailable, using recvmmsg");
+    return -1;
+  }
+  /* Only the lengths of the template are used */
+  struct msghdr tmpl;
+  memset(&tmpl, 0, sizeof(tmpl));
+  tmpl.msg_controllen = CMSG_SPACE(sizeof(int));
+
+  uint16_t bids[URING_BUFFERS];
+  arm_recvmsg(&u, &bufs, r->sock, &tmpl);
+  for (;;) {
+    int ret = uring_submit(&u, 1, r->done ? 500 : 10000);
+    if (ret < 0 && ret != -EINTR) {
+      break; /* idle timeout */
+    }
 
-int main() {
-  int sockfd;
-  char buffer[MAXLINE];
+    int n = 0;
+    int rearm = 0;
+    struct io_uring_cqe *cqe;
+    for (; (cqe = uring_peek(&u)) != NULL; uring_seen(&u)) {
+      if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        rearm = 1; /* out of buffers, or the CQ overflowed */
+      }
+      if (cqe->res < 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+        continue;
+      }
+      uint16_t bid = uring_cqe_bid(cqe);
+      bids[n++] = bid;
+
+      struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)uring_bufs_get(&bufs, bid);
+      char *control = (char *)(out + 1) + tmpl.msg_namelen;
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = out->controllen;
+      handle_buffer(r, control + tmpl.msg_controllen, out->payloadlen, gro_segment(&msg));
+    }
+    end_batch(r);
+
+    /* Buffers go back only after the batch is on disk */
+    for (int i = 0; i < n; i++) {
+      uring_bufs_add(&bufs, bids[i]);
+    }
+    uring_bufs_publish(&bufs);
+    if (rearm) {
+      arm_recvmsg(&u, &bufs, r->sock, &tmpl);
+    }
+  }
+  return 0;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+  struct receiver r;
   struct sockaddr_in server_addr, client_addr;
   socklen_t len = sizeof(client_addr);
-  FILE *fp;
+  int port = PORT;
+  int gro = 0;
+  int opt;
 
-  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+  double loss = 0;
+  int use_uring = 0;
+
+  while ((opt = getopt(argc, argv, "p:gl:u")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'g':
+      gro = 1;
+      break;
+    case 'l':
+      loss = atof(optarg) / 100;
+      break;
+    case 'u':
+      use_uring = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-p port] [-g] [-l loss_percent] [-u]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  memset(&r, 0, sizeof(r));
+  r.loss = loss;
+  r.seed = getpid();
+  if ((r.sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
     perror("socket failed");
     exit(1);
   }
+  int rcvbuf = 64 << 20;
+  if (setsockopt(r.sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+    setsockopt(r.sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+  int one = 1;
+  if (gro && setsockopt(r.sock, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+    perror("UDP_GRO not supported, continuing without");
+    gro = 0;
+  }
 
   memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_port = htons(PORT);
+  server_addr.sin_port = htons(port);
   server_addr.sin_family = AF_INET;
   server_addr.sin_addr.s_addr = INADDR_ANY;
 
-  if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+  if (bind(r.sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
     perror("bind failed");
     exit(1);
   }
-  recvfrom(sockfd, buffer, MAXLINE, 0, (struct sockaddr *)&client_addr, &len);
-  fp = fopen(buffer, "wb");
-  if (!fp) {
+
+  /* Wait for the announcement of a file */
+  struct {
+    struct xfer_hdr h;
+    struct xfer_start s;
+  } __attribute__((packed)) start;
+  for (;;) {
+    ssize_t n = recvfrom(r.sock, &start, sizeof(start), 0, (struct sockaddr *)&client_addr, &len);
+    if (n >= (ssize_t)sizeof(start.h) + (ssize_t)offsetof(struct xfer_start, name) &&
+        start.h.type == XFER_START) {
+      break;
+    }
+  }
+  start.s.name[MAX_NAME - 1] = '\0';
+  r.size = be64toh(start.s.size);
+  r.chunk = be32toh(start.s.chunk);
+  if (r.chunk == 0 || r.chunk > MAX_DATAGRAM - sizeof(struct xfer_hdr)) {
+    fprintf(stderr, "bad chunk size %u\n", r.chunk);
+    exit(1);
+  }
+  r.chunks = xfer_chunks(r.size, r.chunk);
+
+  /* Only the name, never a path from the peer */
+  char *name = basename(start.s.name);
+  r.fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (r.fd < 0) {
     perror("file open failed");
     exit(1);
   }
-  while (1) {
-    int n = recvfrom(sockfd, buffer, MAXLINE, 0,
-                     (struct sockaddr *)&client_addr, &len);
-    if (n <= 0) {
-      break;
-    }
-    fwrite(buffer, 1, n, fp);
+  if (r.size > 0 && posix_fallocate(r.fd, 0, r.size) != 0 && ftruncate(r.fd, r.size) < 0) {
+    perror("preallocation failed");
+    exit(1);
   }
-  printf("file recveied \n");
-  close(fp);
-  close(sockfd);
-  return 0;
+  r.seen = calloc((r.chunks + 7) / 8 + 1, 1);
+  if (r.seen == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+
+  /* From now on only talk to that client */
+  connect(r.sock, (struct sockaddr *)&client_addr, len);
+  reply(&r, XFER_START_ACK, 0);
+  printf("receiving %s: %llu bytes in %llu chunks of %u\n", name, (unsigned long long)r.size,
+         (unsigned long long)r.chunks, r.chunk);
+
+  if (!use_uring || serve_uring(&r) < 0) {
+    serve_blocking(&r);
+  }
+
+  printf("file received: %llu of %llu bytes, %llu chunks missing\n",
+         (unsigned long long)r.stored_bytes, (unsigned long long)r.size,
+         (unsigned long long)(r.chunks - r.stored_chunks));
+  free(r.seen);
+  close(r.fd);
+  close(r.sock);
+  return r.stored_chunks == r.chunks ? 0 : 1;
 }
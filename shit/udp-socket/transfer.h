@@ -0,0 +1,83 @@
+/*
+ * Wire format of the batched UDP file transfer shared by client.c and
+ * server.c.
+ *
+ * The client announces the file with START until it gets START_ACK, then
+ * sends it as DATA datagrams, chunk i carrying bytes [i * chunk, (i + 1) *
+ * chunk) of the file.  The server answers every batch it receives with a SACK
+ * holding the first chunk it is still missing and a bitmap of the chunks it
+ * holds after that, and echoes the send timestamp of the newest DATA so the
+ * client can measure the RTT.  The client retransmits what the SACKs show
+ * missing and, once everything is acknowledged, repeats END until it gets
+ * END_ACK with the number of bytes the server stored.  All header fields are
+ * big endian.
+ */
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define PORT 8080
+#define BATCH 64                 /* messages per sendmmsg/recvmmsg */
+#define MAX_DATAGRAM 65507       /* largest UDP payload over IPv4 */
+#define DEFAULT_DATAGRAM 8192
+#define GSO_SEGMENT 1472         /* one Ethernet MTU worth of UDP payload */
+#define GSO_BUFFER 65000         /* bytes handed to the kernel per GSO send */
+#define MAX_NAME 256
+#define SACK_BYTES 1024
+#define SACK_SPAN (SACK_BYTES * 8) /* chunks a SACK can describe, caps the window */
+
+enum xfer_type {
+  XFER_START = 1,
+  XFER_START_ACK,
+  XFER_DATA,
+  XFER_END,
+  XFER_END_ACK,
+  XFER_SACK,
+};
+
+struct xfer_hdr {
+  uint8_t type;
+  uint8_t pad[3];
+  uint32_t seq;    /* chunk index */
+  uint64_t offset; /* file offset of the payload */
+  uint32_t ts;     /* sender clock in microseconds, echoed in SACKs */
+} __attribute__((packed));
+
+/* Payload of SACK: chunks below cum are all stored, bit i of bits says
+ * whether chunk base + i is */
+struct xfer_sack {
+  uint32_t cum;
+  uint32_t base;
+  uint8_t bits[SACK_BYTES];
+} __attribute__((packed));
+
+/* Payload of START */
+struct xfer_start {
+  uint64_t size;  /* file size */
+  uint32_t chunk; /* file bytes per DATA datagram */
+  char name[MAX_NAME];
+} __attribute__((packed));
+
+static inline void xfer_hdr_set(struct xfer_hdr *h, uint8_t type, uint32_t seq,
+                                uint64_t offset) {
+  memset(h, 0, sizeof(*h));
+  h->type = type;
+  h->seq = htobe32(seq);
+  h->offset = htobe64(offset);
+}
+
+static inline uint64_t xfer_now_us(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static inline uint64_t xfer_chunks(uint64_t size, uint32_t chunk) {
+  return (size + chunk - 1) / chunk;
+}
+
+#endif /* TRANSFER_H */
@@ -0,0 +1,195 @@
+/*
+ * Minimal io_uring plumbing for the socket test servers, written on the raw
+ * system calls so liburing does not have to be installed: ring setup, SQE and
+ * CQE access, waiting with a timeout, and provided buffer rings.
+ *
+ * URING_SUPPORTED is only defined when the kernel headers know about
+ * multishot receive and buffer rings (Linux 6.0); the servers fall back to
+ * their blocking loops otherwise, and also when setting up the ring fails at
+ * run time.
+ */
+#ifndef URING_H
+#define URING_H
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#ifdef IORING_RECV_MULTISHOT
+#define URING_SUPPORTED 1
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct uring {
+  int fd;
+  unsigned sq_entries;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned sqe_tail; /* SQEs handed out, published on submit */
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+};
+
+/* A provided buffer ring: `count` buffers of `size` bytes the kernel picks
+ * from for BUFFER_SELECT receives */
+struct uring_bufs {
+  struct io_uring_buf_ring *ring;
+  char *base;
+  unsigned size;
+  unsigned count;
+  uint16_t tail;
+  uint16_t bgid;
+};
+
+static inline int uring_init(struct uring *r, unsigned entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = entries * 8; /* multishot requests complete many times */
+  r->fd = syscall(__NR_io_uring_setup, entries, &p);
+  if (r->fd < 0) {
+    return -1;
+  }
+
+  size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                  IORING_OFF_SQ_RING);
+  char *cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                  IORING_OFF_CQ_RING);
+  r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (sq == MAP_FAILED || cq == MAP_FAILED || r->sqes == MAP_FAILED) {
+    close(r->fd);
+    return -1;
+  }
+
+  r->sq_entries = p.sq_entries;
+  r->sq_head = (unsigned *)(sq + p.sq_off.head);
+  r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned *)(sq + p.sq_off.array);
+  r->sqe_tail = *r->sq_tail;
+  r->cq_head = (unsigned *)(cq + p.cq_off.head);
+  r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+  return 0;
+}
+
+/* Submit the queued SQEs, and wait for at least wait_nr completions or until
+ * timeout_ms passes (-1 waits forever).  Returns -errno on failure, -ETIME
+ * on timeout. */
+static inline int uring_submit(struct uring *r, unsigned wait_nr, int timeout_ms) {
+  unsigned pending = r->sqe_tail - *r->sq_tail;
+  __atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+
+  unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+  struct __kernel_timespec ts = {.tv_sec = timeout_ms / 1000,
+                                 .tv_nsec = (timeout_ms % 1000) * 1000000LL};
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uint64_t)(uintptr_t)&ts;
+  void *argp = NULL;
+  size_t argsz = 0;
+  if (wait_nr > 0 && timeout_ms >= 0) {
+    flags |= IORING_ENTER_EXT_ARG;
+    argp = &arg;
+    argsz = sizeof(arg);
+  }
+  int ret = syscall(__NR_io_uring_enter, r->fd, pending, wait_nr, flags, argp, argsz);
+  return ret < 0 ? -errno : ret;
+}
+
+/* A zeroed SQE, submitting what is queued first if the ring is full */
+static inline struct io_uring_sqe *uring_sqe(struct uring *r) {
+  while (r->sqe_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+    uring_submit(r, 0, -1);
+  }
+  unsigned index = r->sqe_tail & *r->sq_mask;
+  struct io_uring_sqe *sqe = &r->sqes[index];
+  r->sq_array[index] = index;
+  r->sqe_tail++;
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+static inline struct io_uring_cqe *uring_peek(struct uring *r) {
+  unsigned head = *r->cq_head;
+  if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &r->cqes[head & *r->cq_mask];
+}
+
+static inline void uring_seen(struct uring *r) {
+  __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/* Queue buffer bid for reuse; the kernel sees it after uring_bufs_publish */
+static inline void uring_bufs_add(struct uring_bufs *b, uint16_t bid) {
+  struct io_uring_buf *buf = &b->ring->bufs[b->tail & (b->count - 1)];
+  buf->addr = (uint64_t)(uintptr_t)(b->base + (size_t)bid * b->size);
+  buf->len = b->size;
+  buf->bid = bid;
+  b->tail++;
+}
+
+static inline void uring_bufs_publish(struct uring_bufs *b) {
+  __atomic_store_n(&b->ring->tail, b->tail, __ATOMIC_RELEASE);
+}
+
+static inline char *uring_bufs_get(struct uring_bufs *b, uint16_t bid) {
+  return b->base + (size_t)bid * b->size;
+}
+
+/* Register `count` (a power of two) buffers of `size` bytes as group bgid */
+static inline int uring_bufs_init(struct uring *r, struct uring_bufs *b, uint16_t bgid,
+                                  unsigned count, unsigned size) {
+  b->ring = mmap(NULL, count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  b->base = malloc((size_t)count * size);
+  if (b->ring == MAP_FAILED || b->base == NULL) {
+    return -1;
+  }
+  b->size = size;
+  b->count = count;
+  b->tail = 0;
+  b->bgid = bgid;
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)b->ring;
+  reg.ring_entries = count;
+  reg.bgid = bgid;
+  if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    return -1;
+  }
+  for (unsigned i = 0; i < count; i++) {
+    uring_bufs_add(b, i);
+  }
+  uring_bufs_publish(b);
+  return 0;
+}
+
+/* The buffer a BUFFER_SELECT completion landed in */
+static inline uint16_t uring_cqe_bid(const struct io_uring_cqe *cqe) {
+  return cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+}
+
+#endif /* IORING_RECV_MULTISHOT */
+
+#endif /* URING_H */
@@ -0,0 +1,495 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef SPATIAL_WIFI_CHANNEL_H
+#define SPATIAL_WIFI_CHANNEL_H
+
+#include "ns3/abort.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
+#include "ns3/mobility-model.h"
+#include "ns3/pointer.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-ppdu.h"
+#include "ns3/wifi-utils.h"
+#include "ns3/yans-wifi-channel.h"
+#include "ns3/yans-wifi-helper.h"
+#include "ns3/yans-wifi-phy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief YansWifiChannel that only delivers to receivers within a cutoff range.
+ *
+ * YansWifiChannel schedules a reception on every PHY of the channel for every
+ * transmission, and most of them are dropped on arrival as being below the RX
+ * sensitivity.  This channel keeps the PHYs in a uniform grid whose cells are
+ * one cutoff range wide, so a transmission only looks at the 3x3 cells around
+ * the sender, and it applies the sensitivity test before scheduling rather than
+ * after.  Receivers that pass are scheduled in the same order as
+ * YansWifiChannel would, so a cutoff covering every receiver above sensitivity
+ * gives identical results.
+ *
+ * The cutoff is the MaxRange attribute or, when that is 0, the distance at
+ * which the loss model brings the strongest transmitter below the most
+ * sensitive receiver, found by bisection.  That assumes a loss decreasing with
+ * distance; with fading models set MaxRange explicitly.  A loss that never
+ * drops below sensitivity (e.g. FixedRssLossModel) disables the cutoff.
+ *
+ * Cells are updated from the CourseChange traces.  Nodes moving between course
+ * changes drift from their cells, so the search is widened by the distance the
+ * fastest node can have covered, and the grid rebuilt once that exceeds a
+ * quarter of the range.
+ *
+ * Transmissions only take this path from SpatialYansWifiPhy, which
+ * SpatialYansWifiPhyHelper installs.
+ */
+class SpatialYansWifiChannel : public YansWifiChannel
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Create a channel with the loss and delay models a helper would use.
+     *
+     * \param helper Configured channel helper.
+     * \param maxRange Cutoff range in meters; 0 derives it from the loss model.
+     * \return the channel.
+     */
+    static Ptr<SpatialYansWifiChannel> FromHelper(const YansWifiChannelHelper& helper,
+                                                  double maxRange = 0);
+
+    /**
+     * Deliver a PPDU to the receivers within range.
+     *
+     * \param sender Transmitting PHY.
+     * \param ppdu The PPDU.
+     * \param txPower Transmit power, antenna gain included.
+     */
+    void SendNearby(Ptr<YansWifiPhy> sender, Ptr<const WifiPpdu> ppdu, dBm_u txPower);
+
+    /// \return the cutoff range in use, infinite if none.
+    double GetCutoff();
+
+    /// \return the number of receptions scheduled so far.
+    uint64_t GetDeliveries() const
+    {
+        return m_deliveries;
+    }
+
+  private:
+    /// A PHY of the channel and its grid cell.
+    struct Entry
+    {
+        Ptr<YansWifiPhy> phy;        //!< The PHY
+        Ptr<MobilityModel> mobility; //!< Its mobility model
+        int64_t cell;                //!< Current cell key
+        uint32_t slot;               //!< Position in the cell's list
+    };
+
+    /// Collect the PHYs and build the grid, on the first transmission.
+    void BuildIndex();
+    /// Recompute the cells of all PHYs and the maximum speed.
+    void Rebuild();
+    /**
+     * Move a PHY to the cell of its current position.
+     * \param index Entry index.
+     */
+    void Reindex(uint32_t index);
+    /**
+     * CourseChange sink.
+     * \param model The mobility model that changed course.
+     */
+    void CourseChanged(Ptr<const MobilityModel> model);
+    /// \return the distance beyond which no receiver can sense any transmitter.
+    double EstimateRange() const;
+    /**
+     * \param x Cell column.
+     * \param y Cell row.
+     * \return the cell key.
+     */
+    static int64_t CellKey(int64_t x, int64_t y)
+    {
+        return static_cast<int64_t>(static_cast<uint64_t>(x) << 32 ^ (y & 0xffffffff));
+    }
+    /**
+     * \param coordinate A position coordinate.
+     * \return the cell row or column containing it.
+     */
+    int64_t CellIndex(double coordinate) const
+    {
+        return static_cast<int64_t>(std::floor(coordinate / m_cutoff));
+    }
+    /**
+     * Deliver a PPDU, as YansWifiChannel::Receive does.
+     * \param phy Receiving PHY.
+     * \param ppdu The PPDU.
+     * \param rxPower Received power.
+     */
+    static void Receive(Ptr<YansWifiPhy> phy, Ptr<const WifiPpdu> ppdu, dBm_u rxPower);
+
+    double m_maxRange{0};               //!< MaxRange attribute
+    double m_cutoff{0};                 //!< Cutoff in use
+    bool m_indexed{false};              //!< Whether BuildIndex ran
+    Ptr<PropagationLossModel> m_loss;   //!< Loss model
+    Ptr<PropagationDelayModel> m_delay; //!< Delay model
+    std::vector<Entry> m_entries;       //!< PHYs in channel order
+    std::vector<uint32_t> m_candidates; //!< Scratch list of receivers
+    double m_maxSpeed{0};               //!< Fastest node since the rebuild
+    Time m_indexTime;                   //!< Time of the last rebuild
+    uint64_t m_deliveries{0};           //!< Receptions scheduled
+    /// Entries per grid cell
+    std::unordered_map<int64_t, std::vector<uint32_t>> m_cells;
+    /// Entries per mobility model
+    std::unordered_map<const MobilityModel*, std::vector<uint32_t>> m_byMobility;
+};
+
+/**
+ * \brief YansWifiPhy that transmits through SpatialYansWifiChannel::SendNearby.
+ */
+class SpatialYansWifiPhy : public YansWifiPhy
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    void StartTx(Ptr<const WifiPpdu> ppdu) override;
+};
+
+/**
+ * \brief YansWifiPhyHelper creating SpatialYansWifiPhy objects.
+ */
+class SpatialYansWifiPhyHelper : public YansWifiPhyHelper
+{
+  public:
+    SpatialYansWifiPhyHelper()
+    {
+        m_phys.front().SetTypeId("ns3::SpatialYansWifiPhy");
+    }
+};
+
+NS_OBJECT_ENSURE_REGISTERED(SpatialYansWifiChannel);
+NS_OBJECT_ENSURE_REGISTERED(SpatialYansWifiPhy);
+
+inline TypeId
+SpatialYansWifiChannel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::SpatialYansWifiChannel")
+            .SetParent<YansWifiChannel>()
+            .SetGroupName("Wifi")
+            .AddConstructor<SpatialYansWifiChannel>()
+            .AddAttribute("MaxRange",
+                          "Receivers farther than this (m) are never delivered to; "
+                          "0 derives the range from the loss model",
+                          DoubleValue(0),
+                          MakeDoubleAccessor(&SpatialYansWifiChannel::m_maxRange),
+                          MakeDoubleChecker<double>(0));
+    return tid;
+}
+
+inline Ptr<SpatialYansWifiChannel>
+SpatialYansWifiChannel::FromHelper(const YansWifiChannelHelper& helper, double maxRange)
+{
+    // The helper only builds plain YansWifiChannels; take its models from one
+    Ptr<YansWifiChannel> prototype = helper.Create();
+    PointerValue loss;
+    PointerValue delay;
+    prototype->GetAttribute("PropagationLossModel", loss);
+    prototype->GetAttribute("PropagationDelayModel", delay);
+
+    Ptr<SpatialYansWifiChannel> channel = CreateObject<SpatialYansWifiChannel>();
+    channel->SetPropagationLossModel(loss.Get<PropagationLossModel>());
+    channel->SetPropagationDelayModel(delay.Get<PropagationDelayModel>());
+    channel->SetAttribute("MaxRange", DoubleValue(maxRange));
+    return channel;
+}
+
+inline double
+SpatialYansWifiChannel::GetCutoff()
+{
+    if (!m_indexed)
+    {
+        BuildIndex();
+    }
+    return m_cutoff;
+}
+
+inline void
+SpatialYansWifiChannel::BuildIndex()
+{
+    PointerValue loss;
+    PointerValue delay;
+    GetAttribute("PropagationLossModel", loss);
+    GetAttribute("PropagationDelayModel", delay);
+    m_loss = loss.Get<PropagationLossModel>();
+    m_delay = delay.Get<PropagationDelayModel>();
+
+    // Channel order is the order YansWifiChannel delivers in
+    for (std::size_t i = 0; i < GetNDevices(); ++i)
+    {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(GetDevice(i));
+        NS_ABORT_MSG_UNLESS(device, "SpatialYansWifiChannel only supports WifiNetDevices");
+        for (const auto& phy : device->GetPhys())
+        {
+            Ptr<YansWifiPhy> yans = DynamicCast<YansWifiPhy>(phy);
+            if (!yans || yans->GetChannel() != this ||
+                std::any_of(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+                    return e.phy == yans;
+                }))
+            {
+                continue;
+            }
+            Ptr<MobilityModel> mobility = yans->GetMobility();
+            NS_ABORT_MSG_UNLESS(mobility, "Every PHY of the channel needs a mobility model");
+            m_byMobility[PeekPointer(mobility)].push_back(m_entries.size());
+            if (m_byMobility[PeekPointer(mobility)].size() == 1)
+            {
+                mobility->TraceConnectWithoutContext(
+                    "CourseChange",
+                    MakeCallback(&SpatialYansWifiChannel::CourseChanged, this));
+            }
+            m_entries.push_back({yans, mobility, 0, 0});
+        }
+    }
+
+    m_cutoff = m_maxRange > 0 ? m_maxRange : EstimateRange();
+    m_indexed = true;
+    if (std::isfinite(m_cutoff))
+    {
+        for (auto& entry : m_entries)
+        {
+            Vector position = entry.mobility->GetPosition();
+            entry.cell = CellKey(CellIndex(position.x), CellIndex(position.y));
+            auto& cell = m_cells[entry.cell];
+            entry.slot = cell.size();
+            cell.push_back(&entry - m_entries.data());
+        }
+        Rebuild();
+    }
+}
+
+inline double
+SpatialYansWifiChannel::EstimateRange() const
+{
+    dBm_u txPower = -std::numeric_limits<double>::infinity();
+    dBm_u floor = std::numeric_limits<double>::infinity();
+    for (const auto& entry : m_entries)
+    {
+        txPower = std::max<double>(txPower, entry.phy->GetTxPowerEnd() + entry.phy->GetTxGain());
+        floor = std::min<double>(floor, entry.phy->GetRxSensitivity() - entry.phy->GetRxGain());
+    }
+    if (m_entries.empty())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel>();
+    auto heard = [&](double distance) {
+        b->SetPosition(Vector(distance, 0, 0));
+        return m_loss->CalcRxPower(txPower, a, b) >= floor;
+    };
+
+    double far = 1e6;
+    if (heard(far))
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    double near = 0;
+    for (int i = 0; i < 60 && far - near > 0.01; ++i)
+    {
+        double mid = (near + far) / 2;
+        (heard(mid) ? near : far) = mid;
+    }
+    return far;
+}
+
+inline void
+SpatialYansWifiChannel::Reindex(uint32_t index)
+{
+    Entry& entry = m_entries[index];
+    Vector position = entry.mobility->GetPosition();
+    int64_t key = CellKey(CellIndex(position.x), CellIndex(position.y));
+    if (key == entry.cell)
+    {
+        return;
+    }
+
+    // Swap-remove from the old cell
+    auto& old = m_cells[entry.cell];
+    uint32_t moved = old.back();
+    old[entry.slot] = moved;
+    m_entries[moved].slot = entry.slot;
+    old.pop_back();
+
+    auto& cell = m_cells[key];
+    entry.cell = key;
+    entry.slot = cell.size();
+    cell.push_back(index);
+}
+
+inline void
+SpatialYansWifiChannel::Rebuild()
+{
+    m_maxSpeed = 0;
+    for (uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        Reindex(i);
+        Vector v = m_entries[i].mobility->GetVelocity();
+        m_maxSpeed = std::max(m_maxSpeed, std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z));
+    }
+    m_indexTime = Simulator::Now();
+}
+
+inline void
+SpatialYansWifiChannel::CourseChanged(Ptr<const MobilityModel> model)
+{
+    if (!std::isfinite(m_cutoff))
+    {
+        return;
+    }
+    Vector v = model->GetVelocity();
+    m_maxSpeed = std::max(m_maxSpeed, std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z));
+    for (uint32_t index : m_byMobility[PeekPointer(model)])
+    {
+        Reindex(index);
+    }
+}
+
+inline void
+SpatialYansWifiChannel::SendNearby(Ptr<YansWifiPhy> sender, Ptr<const WifiPpdu> ppdu, dBm_u txPower)
+{
+    if (!m_indexed)
+    {
+        BuildIndex();
+    }
+    Ptr<MobilityModel> senderMobility = sender->GetMobility();
+    NS_ASSERT(senderMobility);
+    Vector from = senderMobility->GetPosition();
+
+    m_candidates.clear();
+    if (std::isfinite(m_cutoff))
+    {
+        double slack = m_maxSpeed * (Simulator::Now() - m_indexTime).GetSeconds();
+        if (slack > m_cutoff / 4)
+        {
+            Rebuild();
+            slack = 0;
+        }
+        int64_t span = 1 + static_cast<int64_t>(std::ceil(slack / m_cutoff));
+        int64_t cx = CellIndex(from.x);
+        int64_t cy = CellIndex(from.y);
+        for (int64_t x = cx - span; x <= cx + span; ++x)
+        {
+            for (int64_t y = cy - span; y <= cy + span; ++y)
+            {
+                auto it = m_cells.find(CellKey(x, y));
+                if (it != m_cells.end())
+                {
+                    m_candidates.insert(m_candidates.end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+        std::sort(m_candidates.begin(), m_candidates.end());
+    }
+    else
+    {
+        for (uint32_t i = 0; i < m_entries.size(); ++i)
+        {
+            m_candidates.push_back(i);
+        }
+    }
+
+    const double cutoff2 = m_cutoff * m_cutoff;
+    const auto widthCorrection = RatioToDb(ppdu->GetTxChannelWidth() / MHz_u{20});
+    for (uint32_t index : m_candidates)
+    {
+        const Entry& entry = m_entries[index];
+        if (entry.phy == sender || entry.phy->GetChannelNumber() != sender->GetChannelNumber())
+        {
+            continue;
+        }
+        Vector to = entry.mobility->GetPosition();
+        double dx = to.x - from.x;
+        double dy = to.y - from.y;
+        double dz = to.z - from.z;
+        if (dx * dx + dy * dy + dz * dz > cutoff2)
+        {
+            continue;
+        }
+
+        dBm_u rxPower = m_loss->CalcRxPower(txPower, senderMobility, entry.mobility);
+        if (rxPower + entry.phy->GetRxGain() < entry.phy->GetRxSensitivity() + widthCorrection)
+        {
+            continue; // Receive would drop it on arrival
+        }
+        Time delay = m_delay->GetDelay(senderMobility, entry.mobility);
+        Ptr<NetDevice> device = entry.phy->GetDevice();
+        uint32_t context = device ? device->GetNode()->GetId() : 0xffffffff;
+        Simulator::ScheduleWithContext(context,
+                                       delay,
+                                       &SpatialYansWifiChannel::Receive,
+                                       entry.phy,
+                                       ppdu->Copy(),
+                                       rxPower);
+        ++m_deliveries;
+    }
+}
+
+inline void
+SpatialYansWifiChannel::Receive(Ptr<YansWifiPhy> phy, Ptr<const WifiPpdu> ppdu, dBm_u rxPower)
+{
+    const auto txWidth = ppdu->GetTxChannelWidth();
+    if ((rxPower + phy->GetRxGain()) < phy->GetRxSensitivity() + RatioToDb(txWidth / MHz_u{20}))
+    {
+        return;
+    }
+    RxPowerWattPerChannelBand rxPowerW;
+    rxPowerW.insert({{{{0, 0}}, {{0, 0}}}, DbmToW(rxPower + phy->GetRxGain())}); // dummy band
+    phy->StartReceivePreamble(ppdu, rxPowerW, ppdu->GetTxDuration());
+}
+
+inline TypeId
+SpatialYansWifiPhy::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::SpatialYansWifiPhy")
+                            .SetParent<YansWifiPhy>()
+                            .SetGroupName("Wifi")
+                            .AddConstructor<SpatialYansWifiPhy>();
+    return tid;
+}
+
+inline void
+SpatialYansWifiPhy::StartTx(Ptr<const WifiPpdu> ppdu)
+{
+    Ptr<SpatialYansWifiChannel> channel = DynamicCast<SpatialYansWifiChannel>(GetChannel());
+    if (!channel)
+    {
+        YansWifiPhy::StartTx(ppdu);
+        return;
+    }
+    channel->SendNearby(this, ppdu, GetTxPowerForTransmission(ppdu) + GetTxGain());
+}
+
+} // namespace ns3
+
+#endif /* SPATIAL_WIFI_CHANNEL_H */
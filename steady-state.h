@@ -0,0 +1,283 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef STEADY_STATE_H
+#define STEADY_STATE_H
+
+#include "ns3/abort.h"
+#include "ns3/nstime.h"
+#include "ns3/packet-sink.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Online steady-state detection of the goodput of a set of flows.
+ *
+ * The goodput of every flow is sampled from its PacketSink at a fixed
+ * interval.  Each time five new samples are in, the series is grouped in
+ * batches of five and the MSER-5 rule picks the truncation point that removes
+ * the warm-up transient.  A flow is in steady state when the truncation point
+ * lies in the first half of the series, at least a minimum number of batches
+ * remain after it, and the confidence interval of the batch means is within a
+ * relative precision of their (non-zero) mean.  A flow is sampled from its
+ * first received byte on, so flows that start late hold the run until they
+ * have settled too.  Once every flow is in steady state the simulation is
+ * stopped.
+ *
+ * The detector never extends a run: the caller keeps its own Simulator::Stop
+ * as the hard cap.
+ */
+class SteadyStateDetector : public SimpleRefCount<SteadyStateDetector>
+{
+  public:
+    /// Number of samples in an MSER batch.
+    static constexpr uint32_t BATCH_SIZE = 5;
+
+    /**
+     * \param interval Goodput sampling interval.
+     * \param precision Maximum half width of the 95% confidence interval,
+     *        relative to the mean goodput.
+     * \param minBatches Minimum number of batches after the truncation point.
+     */
+    SteadyStateDetector(Time interval, double precision, uint32_t minBatches = 10);
+
+    /**
+     * Watch a flow.
+     *
+     * \param sink The sink receiving the flow.
+     */
+    void AddFlow(Ptr<PacketSink> sink);
+
+    /**
+     * Start sampling.
+     *
+     * \param start Time of the first sample.
+     */
+    void Start(Time start);
+
+    /// \return whether all flows reached steady state before the run ended.
+    bool IsSteady() const
+    {
+        return m_steadyTime.IsStrictlyPositive();
+    }
+
+    /// \return the time at which all flows were in steady state.
+    Time GetSteadyTime() const
+    {
+        return m_steadyTime;
+    }
+
+    /**
+     * Print the steady-state goodput estimate of every flow.
+     *
+     * \param os The output stream.
+     */
+    void Print(std::ostream& os) const;
+
+  private:
+    /// Goodput series and estimate of one flow.
+    struct Flow
+    {
+        Ptr<PacketSink> sink;        //!< Sink of the flow
+        uint64_t lastRx{0};          //!< Bytes received at the previous sample
+        std::vector<double> samples; //!< Goodput samples (Mbit/s)
+        uint32_t truncation{0};      //!< MSER-5 truncation point, in batches
+        double mean{0};              //!< Mean of the batch means after truncation
+        double halfWidth{0};         //!< Half width of the 95% confidence interval
+        bool steady{false};          //!< Whether the flow is in steady state
+    };
+
+    /// Take a goodput sample of every flow.
+    void Sample();
+
+    /**
+     * Apply MSER-5 and the batch-means confidence interval to a flow.
+     *
+     * \param flow The flow.
+     */
+    void Estimate(Flow& flow) const;
+
+    /**
+     * \param df Degrees of freedom.
+     * \return the 0.975 quantile of the Student t distribution.
+     */
+    static double StudentT975(uint32_t df);
+
+    Time m_interval;           //!< Sampling interval
+    double m_precision;        //!< Relative CI half width
+    uint32_t m_minBatches;     //!< Minimum batches after truncation
+    std::vector<Flow> m_flows; //!< Watched flows
+    Time m_steadyTime;         //!< Time steady state was reached, zero if not
+};
+
+inline SteadyStateDetector::SteadyStateDetector(Time interval,
+                                                double precision,
+                                                uint32_t minBatches)
+    : m_interval(interval),
+      m_precision(precision),
+      m_minBatches(minBatches)
+{
+    NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(), "Sampling interval must be positive");
+    NS_ABORT_MSG_UNLESS(precision > 0, "Precision must be positive");
+    NS_ABORT_MSG_IF(minBatches < 2, "At least two batches are needed");
+}
+
+inline void
+SteadyStateDetector::AddFlow(Ptr<PacketSink> sink)
+{
+    Flow flow;
+    flow.sink = sink;
+    m_flows.push_back(flow);
+}
+
+inline void
+SteadyStateDetector::Start(Time start)
+{
+    Simulator::Schedule(start, &SteadyStateDetector::Sample, this);
+}
+
+inline void
+SteadyStateDetector::Sample()
+{
+    double seconds = m_interval.GetSeconds();
+    bool allSteady = !m_flows.empty();
+    for (auto& flow : m_flows)
+    {
+        uint64_t rx = flow.sink->GetTotalRx();
+        // A flow that has not received anything yet (e.g. a staggered start) has no
+        // series: it is not sampled and keeps the run going until its data arrives
+        if (rx > 0)
+        {
+            flow.samples.push_back((rx - flow.lastRx) * 8.0 / seconds / 1e6);
+            flow.lastRx = rx;
+            if (flow.samples.size() % BATCH_SIZE == 0)
+            {
+                Estimate(flow);
+            }
+        }
+        allSteady = allSteady && flow.steady;
+    }
+
+    if (allSteady)
+    {
+        m_steadyTime = Simulator::Now();
+        Simulator::Stop();
+        return;
+    }
+    Simulator::Schedule(m_interval, &SteadyStateDetector::Sample, this);
+}
+
+inline void
+SteadyStateDetector::Estimate(Flow& flow) const
+{
+    uint32_t n = flow.samples.size() / BATCH_SIZE;
+    std::vector<double> batches(n);
+    for (uint32_t b = 0; b < n; b++)
+    {
+        double sum = 0;
+        for (uint32_t i = 0; i < BATCH_SIZE; i++)
+        {
+            sum += flow.samples[b * BATCH_SIZE + i];
+        }
+        batches[b] = sum / BATCH_SIZE;
+    }
+
+    // MSER: the truncation point d minimizes the variance of the mean of
+    // batches[d..n), i.e. sum((x - mean)^2) / (n - d)^2.  Walk d backwards so
+    // that the suffix sums are available in O(1).
+    double sum = 0;
+    double sumSq = 0;
+    double best = std::numeric_limits<double>::infinity();
+    uint32_t truncation = 0;
+    for (uint32_t d = n; d-- > 0;)
+    {
+        sum += batches[d];
+        sumSq += batches[d] * batches[d];
+        double k = n - d;
+        double mser = (sumSq - sum * sum / k) / (k * k);
+        if (k >= 2 && mser <= best)
+        {
+            best = mser;
+            truncation = d;
+        }
+    }
+    flow.truncation = truncation;
+
+    uint32_t k = n - truncation;
+    flow.steady = false;
+    if (truncation > n / 2 || k < m_minBatches)
+    {
+        return;
+    }
+
+    double mean = 0;
+    for (uint32_t b = truncation; b < n; b++)
+    {
+        mean += batches[b];
+    }
+    mean /= k;
+    double var = 0;
+    for (uint32_t b = truncation; b < n; b++)
+    {
+        var += (batches[b] - mean) * (batches[b] - mean);
+    }
+    var /= k - 1;
+
+    flow.mean = mean;
+    flow.halfWidth = StudentT975(k - 1) * std::sqrt(var / k);
+    flow.steady = mean > 0 && flow.halfWidth <= m_precision * mean;
+}
+
+inline double
+SteadyStateDetector::StudentT975(uint32_t df)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                   2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                   2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                   2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df == 0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (df <= 30)
+    {
+        return table[df - 1];
+    }
+    // Cornish-Fisher expansion around the normal quantile
+    double z = 1.959964;
+    return z + (z * z * z + z) / (4.0 * df);
+}
+
+inline void
+SteadyStateDetector::Print(std::ostream& os) const
+{
+    if (IsSteady())
+    {
+        os << "Steady state reached at " << m_steadyTime.GetSeconds() << " s" << std::endl;
+    }
+    else
+    {
+        os << "Steady state not reached" << std::endl;
+    }
+    for (std::size_t i = 0; i < m_flows.size(); i++)
+    {
+        const Flow& flow = m_flows[i];
+        os << "Flow " << i << ": warm-up "
+           << flow.truncation * BATCH_SIZE * m_interval.GetSeconds() << " s, goodput "
+           << flow.mean << " +/- " << flow.halfWidth << " Mbps"
+           << (flow.steady ? "" : " (not steady)") << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* STEADY_STATE_H */
@@ -0,0 +1,178 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef SUBNET_PARTITIONER_H
+#define SUBNET_PARTITIONER_H
+
+#include "ns3/abort.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Assign the subnets of a scenario to the systems (ranks) of a distributed run.
+ *
+ * A CSMA or Wi-Fi channel cannot span two systems, so each subnet is placed whole on one
+ * system and only point-to-point links cross between systems; their delays are the lookahead
+ * of the distributed simulator.  Subnets are placed heaviest first on the least loaded system.
+ * With a single system everything lands on system 0, so a scenario written against the
+ * partitioner runs unchanged on the default simulator.
+ *
+ * Node system IDs are fixed at creation, so subnets are declared and partitioned before any
+ * node is created, and the nodes are then created through CreateNode / CreateNodes.
+ */
+class SubnetPartitioner
+{
+  public:
+    /**
+     * \param nSystems Number of systems to spread the subnets over.
+     */
+    explicit SubnetPartitioner(uint32_t nSystems);
+
+    /**
+     * Declare a subnet.
+     *
+     * \param name Name used by Print.
+     * \param weight Expected simulation cost, e.g. its node count.
+     * \return the subnet index.
+     */
+    uint32_t AddSubnet(const std::string& name, double weight);
+
+    /// Assign every declared subnet to a system.
+    void Partition();
+
+    /**
+     * \param subnet Subnet index.
+     * \return the system the subnet was assigned to.
+     */
+    uint32_t GetSystemId(uint32_t subnet) const;
+
+    /**
+     * \param subnet Subnet index.
+     * \return a new node on the system of the subnet.
+     */
+    Ptr<Node> CreateNode(uint32_t subnet) const;
+
+    /**
+     * Create nodes on the system of a subnet.
+     *
+     * \param nodes Container receiving the nodes.
+     * \param n Number of nodes.
+     * \param subnet Subnet index.
+     */
+    void CreateNodes(NodeContainer& nodes, uint32_t n, uint32_t subnet) const;
+
+    /**
+     * \param subnet Subnet index.
+     * \param systemId System of the calling process.
+     * \return true if the subnet is simulated by this process.
+     */
+    bool IsLocal(uint32_t subnet, uint32_t systemId) const;
+
+    /**
+     * Print the assignment and the load of every system.
+     *
+     * \param os Output stream.
+     */
+    void Print(std::ostream& os) const;
+
+  private:
+    /// A declared subnet.
+    struct Subnet
+    {
+        std::string name;  //!< Name
+        double weight;     //!< Expected cost
+        uint32_t systemId; //!< Assigned system
+    };
+
+    uint32_t m_nSystems;           //!< Number of systems
+    std::vector<Subnet> m_subnets; //!< Declared subnets
+    std::vector<double> m_load;    //!< Summed weight per system
+    bool m_partitioned{false};     //!< Whether Partition ran
+};
+
+inline SubnetPartitioner::SubnetPartitioner(uint32_t nSystems)
+    : m_nSystems(nSystems)
+{
+    NS_ABORT_MSG_IF(nSystems == 0, "At least one system is needed");
+}
+
+inline uint32_t
+SubnetPartitioner::AddSubnet(const std::string& name, double weight)
+{
+    NS_ABORT_MSG_IF(m_partitioned, "Subnets must be declared before partitioning");
+    m_subnets.push_back({name, weight, 0});
+    return m_subnets.size() - 1;
+}
+
+inline void
+SubnetPartitioner::Partition()
+{
+    std::vector<uint32_t> order(m_subnets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return m_subnets[a].weight > m_subnets[b].weight;
+    });
+
+    m_load.assign(m_nSystems, 0);
+    for (uint32_t s : order)
+    {
+        auto lightest = std::min_element(m_load.begin(), m_load.end());
+        m_subnets[s].systemId = lightest - m_load.begin();
+        *lightest += m_subnets[s].weight;
+    }
+    m_partitioned = true;
+}
+
+inline uint32_t
+SubnetPartitioner::GetSystemId(uint32_t subnet) const
+{
+    NS_ABORT_MSG_UNLESS(m_partitioned, "Partition() has not run");
+    NS_ABORT_MSG_IF(subnet >= m_subnets.size(), "Unknown subnet " << subnet);
+    return m_subnets[subnet].systemId;
+}
+
+inline Ptr<Node>
+SubnetPartitioner::CreateNode(uint32_t subnet) const
+{
+    return CreateObject<Node>(GetSystemId(subnet));
+}
+
+inline void
+SubnetPartitioner::CreateNodes(NodeContainer& nodes, uint32_t n, uint32_t subnet) const
+{
+    nodes.Create(n, GetSystemId(subnet));
+}
+
+inline bool
+SubnetPartitioner::IsLocal(uint32_t subnet, uint32_t systemId) const
+{
+    return GetSystemId(subnet) == systemId;
+}
+
+inline void
+SubnetPartitioner::Print(std::ostream& os) const
+{
+    for (const auto& subnet : m_subnets)
+    {
+        os << "subnet " << subnet.name << " (weight " << subnet.weight << ") -> system "
+           << subnet.systemId << "\n";
+    }
+    for (uint32_t i = 0; i < m_load.size(); ++i)
+    {
+        os << "system " << i << " load " << m_load[i] << "\n";
+    }
+}
+
+} // namespace ns3
+
+#endif /* SUBNET_PARTITIONER_H */
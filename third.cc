@@ -2,6 +2,11 @@
  * SPDX-License-Identifier: GPL-2.0-only
  */
 
+#include "flow-report.h"
+#include "heap-hooks.h"
+#include "mobility-position-cache.h"
+#include "subnet-partitioner.h"
+
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/csma-module.h"
@@ -13,6 +18,10 @@
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/flow-monitor-module.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
 // Default Network Topology
 //
 //   Wifi 10.1.3.0
@@ -51,15 +60,40 @@ main(int argc, char* argv[])
     uint32_t nCsma = 5; //change
     uint32_t nWifi = 3; //change
     bool tracing = false;
+    std::string flowReport;
+    bool distributed = false;
+    bool nullMessages = false;
+    bool cachePositions = false;
+    bool pool = false;
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
     cmd.AddValue("nWifi", "Number of wifi STA devices", nWifi);
     cmd.AddValue("verbose", "Tell echo applications to log if true", verbose);
     cmd.AddValue("tracing", "Enable pcap tracing", tracing);
+    cmd.AddValue("flowReport", "Write the flow report to this file (.csv or .json)", flowReport);
+    cmd.AddValue("distributed",
+                 "Run the Wi-Fi and CSMA subnets on separate MPI ranks (mpirun -np 2)",
+                 distributed);
+    cmd.AddValue("nullMessages",
+                 "With --distributed, use the null message simulator instead of barriers",
+                 nullMessages);
+    cmd.AddValue("cachePositions",
+                 "Evaluate each node position once per timestamp for the Wi-Fi propagation models",
+                 cachePositions);
+    cmd.AddValue("pool",
+                 "Serve packets, buffers and queue items from size-class freelists (needs a "
+                 "build with -DNS3_HEAP_HOOKS)",
+                 pool);
 
     cmd.Parse(argc, argv);
 
+    NS_ABORT_MSG_IF(pool && !heap::ENABLED, "--pool needs a build with -DNS3_HEAP_HOOKS");
+    if (pool && !heap::SetPoolEnabled(true))
+    {
+        std::cout << "Could not reserve the allocation pool, using the heap" << std::endl;
+    }
+
     // The underlying restriction of 18 is due to the grid position
     // allocator's configuration; the grid layout will exceed the
     // bounding box if more than 18 nodes are provided.
@@ -76,8 +110,37 @@ main(int argc, char* argv[])
         LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
     }
 
+    uint32_t systemId = 0;
+    uint32_t systemCount = 1;
+    if (distributed)
+    {
+#ifdef NS3_MPI
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue(nullMessages ? "ns3::NullMessageSimulatorImpl"
+                                                   : "ns3::DistributedSimulatorImpl"));
+        MpiInterface::Enable(&argc, &argv);
+        systemId = MpiInterface::GetSystemId();
+        systemCount = MpiInterface::GetSize();
+#else
+        std::cout << "--distributed needs ns-3 configured with --enable-mpi" << std::endl;
+        return 1;
+#endif
+    }
+
+    // Each subnet stays on one rank; only the P2P link crosses ranks, so its 2 ms delay is
+    // the lookahead.  With one rank everything is on system 0 as before.
+    SubnetPartitioner partitioner(systemCount);
+    uint32_t wifiSubnet = partitioner.AddSubnet("wifi", nWifi + 1);
+    uint32_t csmaSubnet = partitioner.AddSubnet("csma", nCsma + 1);
+    partitioner.Partition();
+    if (distributed && systemId == 0)
+    {
+        partitioner.Print(std::cout);
+    }
+
     NodeContainer p2pNodes;
-    p2pNodes.Create(2);
+    p2pNodes.Add(partitioner.CreateNode(wifiSubnet)); // n0, the AP
+    p2pNodes.Add(partitioner.CreateNode(csmaSubnet)); // n1
 
     PointToPointHelper pointToPoint;
     pointToPoint.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
@@ -88,7 +151,7 @@ main(int argc, char* argv[])
 
     NodeContainer csmaNodes;
     csmaNodes.Add(p2pNodes.Get(1));
-    csmaNodes.Create(nCsma);
+    partitioner.CreateNodes(csmaNodes, nCsma, csmaSubnet);
 
     CsmaHelper csma;
     csma.SetChannelAttribute("DataRate", StringValue("200Mbps")); //change  100, 150, 200
@@ -98,10 +161,17 @@ main(int argc, char* argv[])
     csmaDevices = csma.Install(csmaNodes);
 
     NodeContainer wifiStaNodes;
-    wifiStaNodes.Create(nWifi);
+    partitioner.CreateNodes(wifiStaNodes, nWifi, wifiSubnet);
     NodeContainer wifiApNode = p2pNodes.Get(0);
 
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+    if (cachePositions)
+    {
+        // Same models as Default(), reading positions through the shared cache
+        channel = YansWifiChannelHelper();
+        channel.SetPropagationDelay("ns3::CachedConstantSpeedPropagationDelayModel");
+        channel.AddPropagationLoss("ns3::CachedLogDistancePropagationLossModel");
+    }
     YansWifiPhyHelper phy;
     phy.SetChannel(channel.Create());
 
@@ -168,7 +238,11 @@ main(int argc, char* argv[])
     uint16_t port = 7;
     Address localAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
     PacketSinkHelper packetSinkHelper(socketType, localAddress);
-    ApplicationContainer sinkApp = packetSinkHelper.Install(csmaNodes.Get(2));
+    ApplicationContainer sinkApp;
+    if (partitioner.IsLocal(csmaSubnet, systemId))
+    {
+        sinkApp = packetSinkHelper.Install(csmaNodes.Get(2));
+    }
 
     sinkApp.Start(Seconds(0.0));
     sinkApp.Stop(Seconds(simulationTime + 0.1));
@@ -186,37 +260,66 @@ main(int argc, char* argv[])
     InetSocketAddress rmt(csmaInterfaces.GetAddress(1), port);
     onoff.SetAttribute("Remote", AddressValue(rmt));
     onoff.SetAttribute("Tos", UintegerValue(0xb8));
-    apps.Add(onoff.Install(wifiStaNodes.Get(0)));
+    if (partitioner.IsLocal(wifiSubnet, systemId))
+    {
+        apps.Add(onoff.Install(wifiStaNodes.Get(0)));
+    }
     apps.Start(Seconds(1.0));
     apps.Stop(Seconds(simulationTime + 0.1));
 
+    // A flow's transmit and receive sides live on different ranks in a distributed run, so
+    // the flow monitor is only used on a single rank
     FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    Ptr<FlowMonitor> monitor;
+    if (!distributed)
+    {
+        monitor = flowmon.InstallAll();
+    }
 
     Simulator::Stop(Seconds(simulationTime + 5));
     Simulator::Run();
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-    std::cout << std::endl << "*** Flow monitor statistics ***" << std::endl;
-    std::cout << "  Tx Packets/Bytes:   " << stats[1].txPackets << " / " << stats[1].txBytes
-              << std::endl;
-  
-    std::cout << "  Rx Packets/Bytes:   " << stats[1].rxPackets << " / " << stats[1].rxBytes
-              << std::endl;
-   
-    std::cout << "  Throughput: "
-              << stats[1].rxBytes * 8.0 /
-                     (stats[1].timeLastRxPacket.GetSeconds() -
-                      stats[1].timeFirstRxPacket.GetSeconds()) /
-                     1000000
-              << " Mbps" << std::endl;
-    std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets
-              << std::endl;
-    std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1)<< std::endl;
-    
+    if (pool)
+    {
+        heap::PrintPoolStats(std::cout);
+    }
+
+    if (cachePositions)
+    {
+        Ptr<MobilityPositionCache> cache = MobilityPositionCache::GetDefault();
+        std::cout << "Position cache: " << cache->GetHits() << " hits, " << cache->GetMisses()
+                  << " mobility evaluations" << std::endl;
+    }
+
+    if (distributed)
+    {
+        if (sinkApp.GetN() > 0)
+        {
+            std::cout << "Rank " << systemId << ": sink received "
+                      << DynamicCast<PacketSink>(sinkApp.Get(0))->GetTotalRx() << " bytes"
+                      << std::endl;
+        }
+    }
+    else
+    {
+        Ptr<Ipv4FlowClassifier> classifier =
+            DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+        FlowReport report;
+        report.AddFlows(monitor, classifier);
+        report.Print(std::cout);
+        if (!flowReport.empty())
+        {
+            report.WriteFile(flowReport);
+        }
+    }
 
     Simulator::Destroy();
+#ifdef NS3_MPI
+    if (distributed)
+    {
+        MpiInterface::Disable();
+    }
+#endif
 
 
     return 0;
@@ -0,0 +1,510 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef TOPOLOGY_BUILDER_H
+#define TOPOLOGY_BUILDER_H
+
+#include "ns3/abort.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4.h"
+#include "ns3/net-device-queue-interface.h"
+#include "ns3/node-container.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/string.h"
+#include "ns3/traffic-control-helper.h"
+#include "ns3/traffic-control-layer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Rate, delay and device queue size of a point-to-point link.
+ */
+struct LinkAttributes
+{
+    std::string dataRate{"10Mbps"}; //!< Device data rate
+    std::string delay{"2ms"};       //!< Channel delay
+    std::string queueSize{"100p"};  //!< Device queue MaxSize
+};
+
+/**
+ * \brief A graph of nodes joined by point-to-point links.
+ *
+ * Edges are stored as compact (node, node, link class) triples; the distinct
+ * link attribute sets are kept once in a side table.  The static generators
+ * build the usual benchmark shapes, and also record which nodes are hosts
+ * (leaves that run applications) as opposed to switches.
+ */
+class Topology
+{
+  public:
+    /// One link of the topology.
+    struct Edge
+    {
+        uint32_t a;    //!< First node
+        uint32_t b;    //!< Second node
+        uint16_t link; //!< Index of the link attributes
+    };
+
+    /**
+     * \param nodes Number of nodes.
+     */
+    explicit Topology(uint32_t nodes = 0);
+
+    /**
+     * Register a link class, reusing an identical one if present.
+     *
+     * \param attributes The link attributes.
+     * \return the link class index.
+     */
+    uint16_t AddLink(const LinkAttributes& attributes);
+
+    /**
+     * Add an edge, growing the node count if needed.
+     *
+     * \param a First node.
+     * \param b Second node.
+     * \param link Link class index.
+     * \return the edge index.
+     */
+    uint32_t AddEdge(uint32_t a, uint32_t b, uint16_t link = 0);
+
+    /**
+     * Mark a node as a host.
+     *
+     * \param node The node.
+     */
+    void AddHost(uint32_t node)
+    {
+        m_hosts.push_back(node);
+    }
+
+    /// \return the number of nodes.
+    uint32_t GetNNodes() const
+    {
+        return m_nodes;
+    }
+
+    /// \return the edges.
+    const std::vector<Edge>& GetEdges() const
+    {
+        return m_edges;
+    }
+
+    /// \return the link classes.
+    const std::vector<LinkAttributes>& GetLinks() const
+    {
+        return m_links;
+    }
+
+    /// \return the hosts, or all nodes if none was marked.
+    std::vector<uint32_t> GetHosts() const;
+
+    /**
+     * Read an edge list.  Each line is "a b" or "a b rate delay queue";
+     * lines starting with '#' are comments.  All nodes are hosts.
+     *
+     * \param fileName The file.
+     * \param link Attributes of the edges that do not give their own.
+     * \return the topology.
+     */
+    static Topology FromEdgeList(const std::string& fileName, const LinkAttributes& link);
+
+    /**
+     * Two routers joined by a bottleneck, each with its own leaves.
+     * Nodes 0 and 1 are the routers; leaves 2..leaves+1 hang off router 0
+     * and the next ones off router 1.
+     *
+     * \param leaves Number of leaves on each side.
+     * \param access Attributes of the leaf links.
+     * \param bottleneck Attributes of the router link.
+     * \return the topology.
+     */
+    static Topology Dumbbell(uint32_t leaves,
+                             const LinkAttributes& access,
+                             const LinkAttributes& bottleneck);
+
+    /**
+     * \param nodes Number of nodes in the ring.
+     * \param link Link attributes.
+     * \return the topology.
+     */
+    static Topology Ring(uint32_t nodes, const LinkAttributes& link);
+
+    /**
+     * A k-ary fat tree: (k/2)^2 core switches, k pods of k/2 aggregation and
+     * k/2 edge switches, and k^3/4 hosts.
+     *
+     * \param k Switch port count, even.
+     * \param link Link attributes.
+     * \return the topology.
+     */
+    static Topology FatTree(uint32_t k, const LinkAttributes& link);
+
+    /**
+     * A connected random graph: a random spanning tree plus random extra
+     * edges up to the requested mean degree, without self loops or parallel
+     * edges.
+     *
+     * \param nodes Number of nodes.
+     * \param meanDegree Mean node degree, at least 2.
+     * \param link Link attributes.
+     * \param stream Random stream index.
+     * \return the topology.
+     */
+    static Topology Random(uint32_t nodes,
+                           double meanDegree,
+                           const LinkAttributes& link,
+                           int64_t stream = 0);
+
+  private:
+    /// Rate, delay and queue size of a link class.
+    using LinkKey = std::tuple<std::string, std::string, std::string>;
+
+    uint32_t m_nodes;                        //!< Number of nodes
+    std::vector<Edge> m_edges;               //!< Edges
+    std::vector<LinkAttributes> m_links;     //!< Link classes
+    std::vector<uint32_t> m_hosts;           //!< Hosts
+    std::map<LinkKey, uint16_t> m_linkIndex; //!< Link class lookup
+};
+
+/**
+ * \brief Install a Topology: nodes, internet stacks, devices and addresses.
+ *
+ * One PointToPointHelper is configured per link class and reused for all its
+ * edges.  Edge e gets the /30 subnet base + 4e, with address base + 4e + 1 on
+ * its first node and base + 4e + 2 on its second, so addresses are computed
+ * rather than stored.  The whole build is linear in the number of edges.
+ */
+class TopologyHelper
+{
+  public:
+    /**
+     * \param base First address of the /30 subnets.
+     */
+    explicit TopologyHelper(Ipv4Address base = Ipv4Address("10.0.0.0"));
+
+    /**
+     * Use this helper to install the internet stacks (e.g. to set the routing).
+     *
+     * \param stack The stack helper.
+     */
+    void SetStackHelper(const InternetStackHelper& stack)
+    {
+        m_stack = stack;
+    }
+
+    /**
+     * Build the topology.
+     *
+     * \param topology The topology.
+     * \return the nodes, in topology order.
+     */
+    NodeContainer Install(const Topology& topology);
+
+    /**
+     * \param edge The edge index.
+     * \param side 0 for the first node of the edge, 1 for the second.
+     * \return the address of that end of the edge.
+     */
+    Ipv4Address GetAddress(uint32_t edge, uint32_t side) const
+    {
+        return Ipv4Address(m_base.Get() + 4 * edge + 1 + side);
+    }
+
+    /**
+     * \param node The node.
+     * \return the address of the node on its first edge.
+     */
+    Ipv4Address GetNodeAddress(uint32_t node) const;
+
+    /// \return the first address of the /30 subnets.
+    Ipv4Address GetBase() const
+    {
+        return m_base;
+    }
+
+  private:
+    /**
+     * Give a device its address, as Ipv4AddressHelper::Assign does but without going
+     * through the global Ipv4AddressGenerator, whose allocation list makes each
+     * assignment linear in the number already made.
+     *
+     * \param device The device.
+     * \param address Its address in the /30 of its edge.
+     */
+    static void AddInterface(Ptr<NetDevice> device, Ipv4Address address);
+
+    Ipv4Address m_base;               //!< First subnet
+    InternetStackHelper m_stack;      //!< Stack helper
+    std::vector<uint32_t> m_firstEnd; //!< First edge end of each node, 2 * edge + side
+};
+
+inline Topology::Topology(uint32_t nodes)
+    : m_nodes(nodes)
+{
+}
+
+inline uint16_t
+Topology::AddLink(const LinkAttributes& attributes)
+{
+    LinkKey key(attributes.dataRate, attributes.delay, attributes.queueSize);
+    auto it = m_linkIndex.find(key);
+    if (it != m_linkIndex.end())
+    {
+        return it->second;
+    }
+    NS_ABORT_MSG_IF(m_links.size() == UINT16_MAX, "Too many link classes");
+    m_links.push_back(attributes);
+    m_linkIndex.emplace(key, m_links.size() - 1);
+    return m_links.size() - 1;
+}
+
+inline uint32_t
+Topology::AddEdge(uint32_t a, uint32_t b, uint16_t link)
+{
+    NS_ABORT_MSG_IF(a == b, "Self loop on node " << a);
+    m_nodes = std::max(m_nodes, std::max(a, b) + 1);
+    m_edges.push_back({a, b, link});
+    return m_edges.size() - 1;
+}
+
+inline std::vector<uint32_t>
+Topology::GetHosts() const
+{
+    if (!m_hosts.empty())
+    {
+        return m_hosts;
+    }
+    std::vector<uint32_t> all(m_nodes);
+    for (uint32_t i = 0; i < m_nodes; i++)
+    {
+        all[i] = i;
+    }
+    return all;
+}
+
+inline Topology
+Topology::FromEdgeList(const std::string& fileName, const LinkAttributes& link)
+{
+    std::ifstream in(fileName);
+    NS_ABORT_MSG_UNLESS(in.is_open(), "Cannot open edge list " << fileName);
+
+    Topology topology;
+    uint16_t defaultLink = topology.AddLink(link);
+    std::string line;
+    uint32_t lineNo = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream iss(line);
+        uint32_t a;
+        uint32_t b;
+        NS_ABORT_MSG_UNLESS(iss >> a >> b, fileName << ":" << lineNo << ": expected two nodes");
+        LinkAttributes own;
+        if (iss >> own.dataRate >> own.delay >> own.queueSize)
+        {
+            topology.AddEdge(a, b, topology.AddLink(own));
+        }
+        else
+        {
+            topology.AddEdge(a, b, defaultLink);
+        }
+    }
+    return topology;
+}
+
+inline Topology
+Topology::Dumbbell(uint32_t leaves, const LinkAttributes& access, const LinkAttributes& bottleneck)
+{
+    Topology topology(2 + 2 * leaves);
+    uint16_t accessLink = topology.AddLink(access);
+    topology.AddEdge(0, 1, topology.AddLink(bottleneck));
+    for (uint32_t i = 0; i < 2 * leaves; i++)
+    {
+        topology.AddEdge(i < leaves ? 0 : 1, 2 + i, accessLink);
+        topology.AddHost(2 + i);
+    }
+    return topology;
+}
+
+inline Topology
+Topology::Ring(uint32_t nodes, const LinkAttributes& link)
+{
+    NS_ABORT_MSG_IF(nodes < 3, "A ring needs at least three nodes");
+    Topology topology(nodes);
+    uint16_t l = topology.AddLink(link);
+    for (uint32_t i = 0; i < nodes; i++)
+    {
+        topology.AddEdge(i, (i + 1) % nodes, l);
+    }
+    return topology;
+}
+
+inline Topology
+Topology::FatTree(uint32_t k, const LinkAttributes& link)
+{
+    NS_ABORT_MSG_IF(k < 2 || k % 2 != 0, "Fat tree arity must be even");
+    uint32_t half = k / 2;
+    uint32_t cores = half * half;
+    // Layout: core switches, then per pod half aggregation and half edge
+    // switches, then the hosts of every edge switch in order.
+    uint32_t firstPod = cores;
+    uint32_t firstHost = firstPod + k * k;
+    Topology topology(firstHost + k * half * half);
+    uint16_t l = topology.AddLink(link);
+
+    for (uint32_t pod = 0; pod < k; pod++)
+    {
+        uint32_t agg = firstPod + pod * k;
+        uint32_t edge = agg + half;
+        for (uint32_t i = 0; i < half; i++)
+        {
+            for (uint32_t j = 0; j < half; j++)
+            {
+                topology.AddEdge(i * half + j, agg + i, l);
+                topology.AddEdge(agg + i, edge + j, l);
+                uint32_t host = firstHost + (pod * half + i) * half + j;
+                topology.AddEdge(edge + i, host, l);
+                topology.AddHost(host);
+            }
+        }
+    }
+    return topology;
+}
+
+inline Topology
+Topology::Random(uint32_t nodes, double meanDegree, const LinkAttributes& link, int64_t stream)
+{
+    NS_ABORT_MSG_IF(nodes < 2, "A random graph needs at least two nodes");
+    NS_ABORT_MSG_IF(meanDegree < 2, "Mean degree below 2 cannot keep the graph connected");
+    uint64_t edges = std::min(static_cast<uint64_t>(meanDegree * nodes / 2),
+                              uint64_t(nodes) * (nodes - 1) / 2);
+
+    Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable>();
+    rng->SetStream(stream);
+
+    Topology topology(nodes);
+    uint16_t l = topology.AddLink(link);
+    topology.m_edges.reserve(edges);
+    std::unordered_set<uint64_t> present;
+    present.reserve(edges);
+    auto key = [](uint32_t a, uint32_t b) {
+        return (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+    };
+
+    // Random recursive tree: every node joins an earlier one
+    for (uint32_t i = 1; i < nodes; i++)
+    {
+        uint32_t j = rng->GetInteger(0, i - 1);
+        topology.AddEdge(j, i, l);
+        present.insert(key(i, j));
+    }
+    while (topology.m_edges.size() < edges)
+    {
+        uint32_t a = rng->GetInteger(0, nodes - 1);
+        uint32_t b = rng->GetInteger(0, nodes - 1);
+        if (a != b && present.insert(key(a, b)).second)
+        {
+            topology.AddEdge(a, b, l);
+        }
+    }
+    return topology;
+}
+
+inline TopologyHelper::TopologyHelper(Ipv4Address base)
+    : m_base(base)
+{
+}
+
+inline NodeContainer
+TopologyHelper::Install(const Topology& topology)
+{
+    const auto& edges = topology.GetEdges();
+    NS_ABORT_MSG_IF(uint64_t(edges.size()) * 4 > (~m_base.Get() & 0xffffffffULL),
+                    "Not enough addresses after " << m_base << " for " << edges.size()
+                                                  << " /30 subnets");
+
+    NodeContainer nodes;
+    nodes.Create(topology.GetNNodes());
+    m_stack.Install(nodes);
+
+    std::vector<PointToPointHelper> p2p(topology.GetLinks().size());
+    for (std::size_t i = 0; i < p2p.size(); i++)
+    {
+        const LinkAttributes& attributes = topology.GetLinks()[i];
+        p2p[i].SetDeviceAttribute("DataRate", StringValue(attributes.dataRate));
+        p2p[i].SetChannelAttribute("Delay", StringValue(attributes.delay));
+        p2p[i].SetQueue("ns3::DropTailQueue", "MaxSize", StringValue(attributes.queueSize));
+    }
+
+    m_firstEnd.assign(topology.GetNNodes(), UINT32_MAX);
+    for (uint32_t e = 0; e < edges.size(); e++)
+    {
+        const Topology::Edge& edge = edges[e];
+        NetDeviceContainer devices = p2p[edge.link].Install(nodes.Get(edge.a), nodes.Get(edge.b));
+        AddInterface(devices.Get(0), GetAddress(e, 0));
+        AddInterface(devices.Get(1), GetAddress(e, 1));
+
+        if (m_firstEnd[edge.a] == UINT32_MAX)
+        {
+            m_firstEnd[edge.a] = 2 * e;
+        }
+        if (m_firstEnd[edge.b] == UINT32_MAX)
+        {
+            m_firstEnd[edge.b] = 2 * e + 1;
+        }
+    }
+    return nodes;
+}
+
+inline void
+TopologyHelper::AddInterface(Ptr<NetDevice> device, Ipv4Address address)
+{
+    Ptr<Node> node = device->GetNode();
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    NS_ABORT_MSG_UNLESS(ipv4, "Node " << node->GetId() << " has no internet stack");
+    int32_t interface = ipv4->GetInterfaceForDevice(device);
+    if (interface == -1)
+    {
+        interface = ipv4->AddInterface(device);
+    }
+    ipv4->AddAddress(interface, Ipv4InterfaceAddress(address, Ipv4Mask("255.255.255.252")));
+    ipv4->SetMetric(interface, 1);
+    ipv4->SetUp(interface);
+
+    // Same default queue disc as Ipv4AddressHelper::Assign would install
+    Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+    Ptr<NetDeviceQueueInterface> ndqi = device->GetObject<NetDeviceQueueInterface>();
+    if (tc && ndqi && !tc->GetRootQueueDiscOnDevice(device))
+    {
+        TrafficControlHelper::Default(ndqi->GetNTxQueues()).Install(device);
+    }
+}
+
+inline Ipv4Address
+TopologyHelper::GetNodeAddress(uint32_t node) const
+{
+    NS_ABORT_MSG_IF(node >= m_firstEnd.size() || m_firstEnd[node] == UINT32_MAX,
+                    "Node " << node << " has no link");
+    return GetAddress(m_firstEnd[node] / 2, m_firstEnd[node] % 2);
+}
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_BUILDER_H */
@@ -0,0 +1,452 @@
+/*
+ * Load generator for the TCP socket servers.
+ *
+ * Opens N connections spread over M threads, each thread driving its
+ * connections from an edge-triggered epoll loop.  Every request is a fixed
+ * size payload answered by a fixed size reply, so replies are matched to
+ * requests in order and a connection can have several requests in flight.
+ * The reply is the payload for the echo server; `server-real` answers each
+ * recv with 17 bytes, so use -R 17 and the closed loop against it.
+ *
+ * Closed loop (default): every connection keeps one request outstanding.
+ * Open loop (-r): requests are issued at a fixed total rate, round robin over
+ * the connections, and latency is measured from the time each request was
+ * due, so a stalled server cannot hide its queueing delay.
+ *
+ * Latencies go into a log-linear (HDR-style) histogram with 128 sub-buckets
+ * per power of two, under 1% relative error.
+ *
+ *   client [-a address] [-p port] [-c connections] [-t threads] [-s payload]
+ *          [-R reply_size] [-r rate] [-d seconds] [-w warmup_seconds]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PORT 8080
+#define MAX_EVENTS 256
+#define MAX_DEPTH 1024 /* requests in flight per connection */
+#define TIMER UINT32_MAX
+#define FILLER_SIZE 65536
+#define HIST_SUB_BITS 7
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_SIZE ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct histogram {
+  uint64_t counts[HIST_SIZE];
+  uint64_t total;
+  uint64_t max;
+  double sum;
+};
+
+struct conn {
+  int fd;
+  uint64_t out_bytes; /* request bytes not sent yet */
+  uint64_t in_bytes;  /* reply bytes received for the oldest request */
+  uint32_t head;      /* ring of request start times, oldest at head */
+  uint32_t count;
+  uint64_t start[MAX_DEPTH];
+};
+
+struct worker {
+  pthread_t thread;
+  int epoll_fd;
+  int timer_fd; /* wakes the open loop when the next request is due */
+  struct conn *conns;
+  uint32_t n_conns;
+  uint32_t next_conn; /* round robin cursor of the open loop */
+  struct histogram hist;
+  uint64_t completed;
+  uint64_t backlogged; /* open-loop requests dropped on a full connection */
+  uint64_t errors;
+};
+
+static const char *address = "127.0.0.1";
+static int port = PORT;
+static uint32_t n_conns = 1;
+static int n_workers = 1;
+static uint32_t payload = 64;
+static uint32_t reply = 0; /* 0: same as the payload */
+static double rate = 0;    /* requests per second, 0 for closed loop */
+static double duration = 10;
+static double warmup = 1;
+
+static uint64_t measure_from; /* ns; samples before this are warmup */
+static uint64_t stop_at;
+static char filler[FILLER_SIZE];
+
+static uint64_t now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int hist_index(uint64_t v) {
+  if (v < HIST_SUB) {
+    return v;
+  }
+  int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+  return (shift + 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+/* Upper bound of the values counted in bucket i */
+static uint64_t hist_value(int i) {
+  if (i < HIST_SUB) {
+    return i;
+  }
+  int shift = i / HIST_SUB - 1;
+  uint64_t mantissa = i % HIST_SUB + HIST_SUB;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+static void hist_record(struct histogram *h, uint64_t v) {
+  h->counts[hist_index(v)]++;
+  h->total++;
+  h->sum += v;
+  if (v > h->max) {
+    h->max = v;
+  }
+}
+
+static void hist_merge(struct histogram *into, const struct histogram *from) {
+  for (int i = 0; i < HIST_SIZE; i++) {
+    into->counts[i] += from->counts[i];
+  }
+  into->total += from->total;
+  into->sum += from->sum;
+  if (from->max > into->max) {
+    into->max = from->max;
+  }
+}
+
+static uint64_t hist_percentile(const struct histogram *h, double p) {
+  uint64_t rank = (uint64_t)(p / 100 * h->total + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < HIST_SIZE; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t v = hist_value(i);
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
+
+static void close_conn(struct worker *w, struct conn *c) {
+  close(c->fd);
+  c->fd = -1;
+  w->errors++;
+}
+
+/* Queue one request on the connection, due at `start` */
+static int issue(struct worker *w, struct conn *c, uint64_t start) {
+  if (c->count == MAX_DEPTH) {
+    w->backlogged++;
+    return -1;
+  }
+  c->start[(c->head + c->count) % MAX_DEPTH] = start;
+  c->count++;
+  c->out_bytes += payload;
+  return 0;
+}
+
+/* Send until the queued bytes are out or the socket would block.  The
+ * servers do not look at the content, so it all comes from one filler
+ * buffer. */
+static void flush(struct worker *w, struct conn *c) {
+  while (c->fd >= 0 && c->out_bytes > 0) {
+    size_t len = c->out_bytes < FILLER_SIZE ? c->out_bytes : FILLER_SIZE;
+    ssize_t n = send(c->fd, filler, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_conn(w, c);
+      }
+      return; /* resume on EPOLLOUT */
+    }
+    c->out_bytes -= n;
+  }
+}
+
+/* Read until the socket would block, completing requests in order */
+static void drain(struct worker *w, struct conn *c) {
+  static __thread char scratch[FILLER_SIZE];
+  while (c->fd >= 0) {
+    ssize_t n = recv(c->fd, scratch, sizeof(scratch), 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_conn(w, c);
+      }
+      return;
+    }
+    if (n == 0) {
+      close_conn(w, c);
+      return;
+    }
+
+    c->in_bytes += n;
+    while (c->in_bytes >= reply && c->count > 0) {
+      uint64_t now = now_ns();
+      uint64_t start = c->start[c->head];
+      c->in_bytes -= reply;
+      c->head = (c->head + 1) % MAX_DEPTH;
+      c->count--;
+      if (start >= measure_from && now < stop_at) {
+        hist_record(&w->hist, now - start);
+        w->completed++;
+      }
+      if (rate == 0) {
+        issue(w, c, now); /* closed loop: next request right away */
+      }
+    }
+    flush(w, c);
+  }
+}
+
+static void *run_worker(void *arg) {
+  struct worker *w = arg;
+  struct epoll_event events[MAX_EVENTS];
+  uint64_t interval = rate > 0 ? (uint64_t)(1e9 * n_workers / rate) : 0;
+  uint64_t next_due = now_ns();
+
+  if (rate == 0) {
+    for (uint32_t i = 0; i < w->n_conns; i++) {
+      issue(w, &w->conns[i], next_due);
+      flush(w, &w->conns[i]);
+    }
+  }
+
+  for (;;) {
+    uint64_t now = now_ns();
+    if (now >= stop_at) {
+      return NULL;
+    }
+
+    /* Open loop: issue everything that fell due, even if late */
+    if (interval > 0) {
+      for (; next_due <= now; next_due += interval) {
+        for (uint32_t tries = 0; tries < w->n_conns; tries++) {
+          struct conn *c = &w->conns[w->next_conn];
+          w->next_conn = (w->next_conn + 1) % w->n_conns;
+          if (c->fd >= 0) {
+            if (issue(w, c, next_due) == 0) {
+              flush(w, c);
+            }
+            break;
+          }
+        }
+      }
+    }
+
+    if (interval > 0) {
+      /* epoll_wait only sleeps in milliseconds; the timer is exact */
+      struct itimerspec due = {.it_value = {.tv_sec = next_due / 1000000000,
+                                            .tv_nsec = next_due % 1000000000}};
+      timerfd_settime(w->timer_fd, TFD_TIMER_ABSTIME, &due, NULL);
+    }
+    int n = epoll_wait(w->epoll_fd, events, MAX_EVENTS, 100);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.u32 == TIMER) {
+        uint64_t expirations;
+        read(w->timer_fd, &expirations, sizeof(expirations));
+        continue;
+      }
+      struct conn *c = &w->conns[events[i].data.u32];
+      if (events[i].events & EPOLLOUT) {
+        flush(w, c);
+      }
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        drain(w, c);
+      }
+    }
+  }
+}
+
+static int open_conn(void) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    exit(EXIT_FAILURE);
+  }
+  struct sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &server_addr.sin_addr) != 1) {
+    fprintf(stderr, "invalid address %s\n", address);
+    exit(EXIT_FAILURE);
+  }
+  if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    perror("connect");
+    exit(EXIT_FAILURE);
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+static void init_worker(struct worker *w, uint32_t conns) {
+  w->epoll_fd = epoll_create1(0);
+  w->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  w->conns = calloc(conns, sizeof(struct conn));
+  if (w->epoll_fd < 0 || w->timer_fd < 0 || w->conns == NULL) {
+    perror("worker setup");
+    exit(EXIT_FAILURE);
+  }
+  struct epoll_event timer = {.events = EPOLLIN, .data.u32 = TIMER};
+  if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->timer_fd, &timer) < 0) {
+    perror("epoll_ctl");
+    exit(EXIT_FAILURE);
+  }
+  w->n_conns = conns;
+  for (uint32_t i = 0; i < conns; i++) {
+    int fd = open_conn();
+    w->conns[i].fd = fd;
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+      perror("fcntl");
+      exit(EXIT_FAILURE);
+    }
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET, .data.u32 = i};
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("epoll_ctl");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static void raise_fd_limit(void) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "a:p:c:t:s:R:r:d:w:")) != -1) {
+    switch (opt) {
+    case 'a':
+      address = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'c':
+      n_conns = strtoul(optarg, NULL, 10);
+      break;
+    case 't':
+      n_workers = atoi(optarg);
+      break;
+    case 's':
+      payload = strtoul(optarg, NULL, 10);
+      break;
+    case 'R':
+      reply = strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      rate = atof(optarg);
+      break;
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'w':
+      warmup = atof(optarg);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-a address] [-p port] [-c connections] [-t threads] [-s payload]\n"
+              "          [-R reply_size] [-r rate] [-d seconds] [-w warmup_seconds]\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (reply == 0) {
+    reply = payload;
+  }
+  if (n_workers < 1 || payload == 0 || n_conns < (uint32_t)n_workers) {
+    fprintf(stderr, "need a non-empty payload and at least one connection per thread\n");
+    exit(EXIT_FAILURE);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  raise_fd_limit();
+  memset(filler, 'x', sizeof(filler));
+
+  struct worker *workers = calloc(n_workers, sizeof(struct worker));
+  if (workers == NULL) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < n_workers; i++) {
+    uint32_t conns = n_conns / n_workers + ((uint32_t)i < n_conns % n_workers ? 1 : 0);
+    init_worker(&workers[i], conns);
+  }
+
+  uint64_t start = now_ns();
+  measure_from = start + (uint64_t)(warmup * 1e9);
+  stop_at = measure_from + (uint64_t)(duration * 1e9);
+  for (int i = 0; i < n_workers; i++) {
+    if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  struct histogram *total = calloc(1, sizeof(struct histogram));
+  uint64_t completed = 0, backlogged = 0, errors = 0;
+  for (int i = 0; i < n_workers; i++) {
+    pthread_join(workers[i].thread, NULL);
+    hist_merge(total, &workers[i].hist);
+    completed += workers[i].completed;
+    backlogged += workers[i].backlogged;
+    errors += workers[i].errors;
+  }
+
+  printf("%s:%d, %u connections on %d threads, %u byte requests, %u byte replies, %s\n",
+         address, port, n_conns, n_workers, payload, reply,
+         rate > 0 ? "open loop" : "closed loop");
+  if (rate > 0) {
+    printf("target rate: %.0f req/s\n", rate);
+  }
+  printf("requests: %llu in %.1f s, %.0f req/s, %.2f MB/s out\n", (unsigned long long)completed,
+         duration, completed / duration, completed * (double)payload / duration / 1e6);
+  if (total->total > 0) {
+    printf("latency (us): mean %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+           total->sum / total->total / 1e3, hist_percentile(total, 50) / 1e3,
+           hist_percentile(total, 90) / 1e3, hist_percentile(total, 99) / 1e3,
+           hist_percentile(total, 99.9) / 1e3, total->max / 1e3);
+  }
+  if (backlogged > 0 || errors > 0) {
+    printf("backlogged: %llu, closed connections: %llu\n", (unsigned long long)backlogged,
+           (unsigned long long)errors);
+  }
+  return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Event-driven TCP echo server for local load tests.
+ *
+ * Every worker thread owns a listening socket bound with SO_REUSEPORT, so the
+ * kernel spreads the incoming connections over the workers, and an
+ * edge-triggered epoll instance serving its connections.  Connections and
+ * their buffers come from a per-worker pool allocated at startup.
+ *
+ *   server [-p port] [-t threads] [-c max_connections] [-b buffer_size]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PORT 8080
+#define MAX_EVENTS 256
+#define LISTENER UINT32_MAX
+#define NO_CONN UINT32_MAX
+
+struct conn {
+  int fd;
+  uint32_t len;       /* bytes in the buffer */
+  uint32_t off;       /* bytes of the buffer already echoed */
+  uint32_t next_free; /* free list link */
+  char *buf;
+};
+
+struct worker {
+  pthread_t thread;
+  int listen_fd;
+  int epoll_fd;
+  struct conn *conns;
+  char *buffers;
+  uint32_t free_head;
+  uint32_t active;
+};
+
+static int port = PORT;
+static int n_workers = 1;
+static uint32_t max_conns = 16384;
+static uint32_t buf_size = 4096;
+
+static int open_listener(void) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    perror("socket");
+    exit(EXIT_FAILURE);
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+    perror("setsockopt SO_REUSEPORT");
+    exit(EXIT_FAILURE);
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = INADDR_ANY;
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    perror("bind");
+    exit(EXIT_FAILURE);
+  }
+  if (listen(fd, SOMAXCONN) < 0) {
+    perror("listen");
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+static void init_worker(struct worker *w, uint32_t conns) {
+  w->listen_fd = open_listener();
+  w->epoll_fd = epoll_create1(0);
+  if (w->epoll_fd < 0) {
+    perror("epoll_create1");
+    exit(EXIT_FAILURE);
+  }
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.u32 = LISTENER};
+  if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->listen_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    exit(EXIT_FAILURE);
+  }
+
+  /* One slab for all the buffers of the worker */
+  w->conns = calloc(conns, sizeof(struct conn));
+  w->buffers = malloc((size_t)conns * buf_size);
+  if (w->conns == NULL || w->buffers == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  for (uint32_t i = 0; i < conns; i++) {
+    w->conns[i].fd = -1;
+    w->conns[i].buf = w->buffers + (size_t)i * buf_size;
+    w->conns[i].next_free = (i + 1 < conns) ? i + 1 : NO_CONN;
+  }
+  w->free_head = conns > 0 ? 0 : NO_CONN;
+  w->active = 0;
+}
+
+static void release(struct worker *w, uint32_t id) {
+  struct conn *c = &w->conns[id];
+  close(c->fd); /* also removes it from the epoll set */
+  c->fd = -1;
+  c->next_free = w->free_head;
+  w->free_head = id;
+  w->active--;
+}
+
+static void accept_all(struct worker *w) {
+  for (;;) {
+    int fd = accept4(w->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("accept4");
+      }
+      return;
+    }
+    if (w->free_head == NO_CONN) {
+      close(fd); /* pool exhausted */
+      continue;
+    }
+
+    uint32_t id = w->free_head;
+    struct conn *c = &w->conns[id];
+    w->free_head = c->next_free;
+    w->active++;
+    c->fd = fd;
+    c->len = 0;
+    c->off = 0;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                             .data.u32 = id};
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("epoll_ctl");
+      release(w, id);
+    }
+  }
+}
+
+/* Echo until the socket would block.  Edge-triggered epoll only reports new
+ * readiness, so the connection is drained every time it is woken up. */
+static void serve(struct worker *w, uint32_t id) {
+  struct conn *c = &w->conns[id];
+  for (;;) {
+    while (c->off < c->len) {
+      ssize_t n = send(c->fd, c->buf + c->off, c->len - c->off, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return; /* resume on EPOLLOUT */
+        }
+        release(w, id);
+        return;
+      }
+      c->off += n;
+    }
+    c->off = c->len = 0;
+
+    ssize_t n = recv(c->fd, c->buf, buf_size, 0);
+    if (n > 0) {
+      c->len = n;
+    } else if (n == 0) {
+      release(w, id);
+      return;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return;
+    } else if (errno != EINTR) {
+      release(w, id);
+      return;
+    }
+  }
+}
+
+static void *run_worker(void *arg) {
+  struct worker *w = arg;
+  struct epoll_event events[MAX_EVENTS];
+  for (;;) {
+    int n = epoll_wait(w->epoll_fd, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait");
+      exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+      uint32_t id = events[i].data.u32;
+      if (id == LISTENER) {
+        accept_all(w);
+      } else if (w->conns[id].fd >= 0) {
+        serve(w, id);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void raise_fd_limit(void) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:c:b:")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 't':
+      n_workers = atoi(optarg);
+      break;
+    case 'c':
+      max_conns = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      buf_size = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-p port] [-t threads] [-c max_connections] [-b buffer_size]\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (n_workers < 1 || buf_size == 0) {
+    fprintf(stderr, "need at least one thread and a non-empty buffer\n");
+    exit(EXIT_FAILURE);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  raise_fd_limit();
+
+  struct worker *workers = calloc(n_workers, sizeof(struct worker));
+  if (workers == NULL) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  uint32_t per_worker = (max_conns + n_workers - 1) / n_workers;
+  for (int i = 0; i < n_workers; i++) {
+    init_worker(&workers[i], per_worker);
+  }
+  printf("echo server on port %d: %d workers, %u connections each\n", port, n_workers,
+         per_worker);
+  fflush(stdout);
+
+  for (int i = 1; i < n_workers; i++) {
+    if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+  run_worker(&workers[0]);
+  return 0;
+}
@@ -0,0 +1,437 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef WIFI_AC_STATS_H
+#define WIFI_AC_STATS_H
+
+#include "ns3/abort.h"
+#include "ns3/nstime.h"
+#include "ns3/qos-txop.h"
+#include "ns3/qos-utils.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-mac-queue.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-mpdu.h"
+#include "ns3/wifi-net-device.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Histogram of durations with logarithmic buckets.
+ *
+ * Durations are bucketed in nanoseconds by their power of two, each power split in 8
+ * linear sub-buckets, so percentiles are within 12.5% of the true value.  The buckets are
+ * a fixed array and Add does not allocate.
+ */
+class DurationHistogram
+{
+  public:
+    /**
+     * \param value A duration.
+     */
+    void Add(Time value)
+    {
+        int64_t ns = std::max<int64_t>(value.GetNanoSeconds(), 0);
+        ++m_counts[Bucket(ns)];
+        ++m_count;
+        m_sum += ns;
+        m_max = std::max(m_max, ns);
+    }
+
+    /**
+     * \param other Histogram added to this one.
+     */
+    void Merge(const DurationHistogram& other)
+    {
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    /// \return the number of durations added.
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    /// \return the mean duration.
+    Time GetMean() const
+    {
+        return NanoSeconds(m_count ? m_sum / m_count : 0);
+    }
+
+    /// \return the longest duration.
+    Time GetMax() const
+    {
+        return NanoSeconds(m_max);
+    }
+
+    /**
+     * \param fraction Fraction of the durations, in [0, 1].
+     * \return the duration that fraction of the durations does not exceed.
+     */
+    Time GetPercentile(double fraction) const
+    {
+        if (m_count == 0)
+        {
+            return Time();
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * m_count)));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+            {
+                return NanoSeconds(std::min(UpperBound(i), m_max));
+            }
+        }
+        return NanoSeconds(m_max);
+    }
+
+  private:
+    static constexpr int SUB_BITS = 3;                            //!< log2 of the sub-buckets
+    static constexpr int64_t SUB = 1 << SUB_BITS;                 //!< Sub-buckets per power of two
+    static constexpr std::size_t BUCKETS = (64 - SUB_BITS) * SUB; //!< Number of buckets
+
+    /**
+     * \param ns A duration in nanoseconds.
+     * \return its bucket.
+     */
+    static std::size_t Bucket(int64_t ns)
+    {
+        if (ns < SUB)
+        {
+            return ns;
+        }
+        int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(ns));
+        int shift = exponent - SUB_BITS;
+        return (shift + 1) * SUB + ((ns >> shift) & (SUB - 1));
+    }
+
+    /**
+     * \param bucket A bucket.
+     * \return the largest duration in nanoseconds falling in it.
+     */
+    static int64_t UpperBound(std::size_t bucket)
+    {
+        if (bucket < static_cast<std::size_t>(SUB))
+        {
+            return bucket;
+        }
+        int shift = bucket / SUB - 1;
+        int64_t low = (SUB + static_cast<int64_t>(bucket % SUB)) << shift;
+        return low + (int64_t{1} << shift) - 1;
+    }
+
+    std::array<uint64_t, BUCKETS> m_counts{}; //!< Durations per bucket
+    uint64_t m_count{0};                      //!< Durations added
+    int64_t m_sum{0};                         //!< Sum in nanoseconds
+    int64_t m_max{0};                         //!< Longest duration in nanoseconds
+};
+
+/**
+ * \brief Per-station, per-access-category EDCA statistics of Wi-Fi senders.
+ *
+ * For each station and AC the collector records the time MPDUs spend in the EDCA queue
+ * (enqueue to removal, i.e. until acknowledged, dropped or expired), the TXOPs the AC
+ * won and how long they lasted, the acknowledged MPDUs and bytes, the MPDUs that were
+ * not acknowledged (each one a retry or a drop) and the dropped MPDUs.  Application
+ * bytes received by the sinks can be added per AC for the goodput column.
+ *
+ * All counters are allocated when the collector is created; the trace sinks bound to
+ * them only increment counters.
+ */
+class WifiAcStats : public SimpleRefCount<WifiAcStats>
+{
+  public:
+    /// Counters of one AC of one station.
+    struct AcCounters
+    {
+        DurationHistogram sojourn; //!< Queue sojourn times
+        uint64_t txops{0};         //!< TXOPs won
+        Time txopTime;             //!< Summed TXOP durations
+        uint64_t ackedMpdus{0};    //!< MPDUs acknowledged
+        uint64_t ackedBytes{0};    //!< Bytes of the acknowledged MPDUs
+        uint64_t nackedMpdus{0};   //!< Transmissions not acknowledged
+        uint64_t droppedMpdus{0};  //!< MPDUs dropped
+        uint64_t sinkBytes{0};     //!< Application bytes received
+    };
+
+    /// Counters of the four QoS ACs of a station, indexed by AcIndex.
+    using StationCounters = std::array<AcCounters, 4>;
+
+    /**
+     * \param nStations Number of stations.
+     */
+    explicit WifiAcStats(uint32_t nStations);
+
+    /**
+     * Connect the traces of the device of a station.
+     *
+     * \param station Station index.
+     * \param device Its Wi-Fi device.
+     */
+    void Install(uint32_t station, Ptr<WifiNetDevice> device);
+
+    /**
+     * Add the application bytes received for a station and AC.
+     *
+     * \param station Station index.
+     * \param ac Access category.
+     * \param bytes Bytes received.
+     */
+    void AddSinkBytes(uint32_t station, AcIndex ac, uint64_t bytes);
+
+    /**
+     * \param station Station index.
+     * \param ac Access category.
+     * \return the counters.
+     */
+    const AcCounters& Get(uint32_t station, AcIndex ac) const;
+
+    /**
+     * Print one line per station and AC, and the totals per AC.
+     *
+     * \param os Output stream.
+     * \param duration Time the traffic ran for, for the rates.
+     */
+    void Print(std::ostream& os, Time duration) const;
+
+  private:
+    /**
+     * Queue Dequeue sink.
+     * \param counters Counters of the AC.
+     * \param mpdu The MPDU leaving the queue.
+     */
+    static void Dequeued(AcCounters* counters, Ptr<const WifiMpdu> mpdu);
+    /**
+     * TxopTrace sink.
+     * \param counters Counters of the AC.
+     * \param start Start of the TXOP.
+     * \param duration Its duration.
+     * \param linkId Link it was won on.
+     */
+    static void Txop(AcCounters* counters, Time start, Time duration, uint8_t linkId);
+    /**
+     * \param station Counters of the station.
+     * \param mpdu An MPDU.
+     * \return the counters of the AC of the MPDU, nullptr if it is not QoS data.
+     */
+    static AcCounters* ForMpdu(StationCounters* station, Ptr<const WifiMpdu> mpdu);
+    /**
+     * AckedMpdu sink.
+     * \param station Counters of the station.
+     * \param mpdu The MPDU.
+     */
+    static void Acked(StationCounters* station, Ptr<const WifiMpdu> mpdu);
+    /**
+     * NAckedMpdu sink.
+     * \param station Counters of the station.
+     * \param mpdu The MPDU.
+     */
+    static void Nacked(StationCounters* station, Ptr<const WifiMpdu> mpdu);
+    /**
+     * DroppedMpdu sink.
+     * \param station Counters of the station.
+     * \param reason Why it was dropped.
+     * \param mpdu The MPDU.
+     */
+    static void Dropped(StationCounters* station,
+                        WifiMacDropReason reason,
+                        Ptr<const WifiMpdu> mpdu);
+    /**
+     * Print one line of counters.
+     * \param os Output stream.
+     * \param label Station label.
+     * \param ac Access category.
+     * \param counters The counters.
+     * \param duration Time the traffic ran for.
+     */
+    static void PrintLine(std::ostream& os,
+                          const std::string& label,
+                          AcIndex ac,
+                          const AcCounters& counters,
+                          Time duration);
+
+    std::vector<StationCounters> m_stations; //!< Counters per station, never resized
+};
+
+inline WifiAcStats::WifiAcStats(uint32_t nStations)
+    : m_stations(nStations)
+{
+}
+
+inline void
+WifiAcStats::Install(uint32_t station, Ptr<WifiNetDevice> device)
+{
+    NS_ABORT_MSG_IF(station >= m_stations.size(), "Unknown station " << station);
+    Ptr<WifiMac> mac = device->GetMac();
+    NS_ABORT_MSG_UNLESS(mac->GetQosSupported(), "Per-AC statistics need a QoS MAC");
+    StationCounters* counters = &m_stations[station];
+
+    for (AcIndex ac : {AC_BE, AC_BK, AC_VI, AC_VO})
+    {
+        Ptr<QosTxop> txop = mac->GetQosTxop(ac);
+        AcCounters* acCounters = &(*counters)[ac];
+        txop->GetWifiMacQueue()->TraceConnectWithoutContext(
+            "Dequeue",
+            MakeBoundCallback(&WifiAcStats::Dequeued, acCounters));
+        txop->TraceConnectWithoutContext("TxopTrace",
+                                         MakeBoundCallback(&WifiAcStats::Txop, acCounters));
+    }
+    mac->TraceConnectWithoutContext("AckedMpdu", MakeBoundCallback(&WifiAcStats::Acked, counters));
+    mac->TraceConnectWithoutContext("NAckedMpdu",
+                                    MakeBoundCallback(&WifiAcStats::Nacked, counters));
+    mac->TraceConnectWithoutContext("DroppedMpdu",
+                                    MakeBoundCallback(&WifiAcStats::Dropped, counters));
+}
+
+inline void
+WifiAcStats::AddSinkBytes(uint32_t station, AcIndex ac, uint64_t bytes)
+{
+    NS_ABORT_MSG_IF(station >= m_stations.size(), "Unknown station " << station);
+    m_stations[station][ac].sinkBytes += bytes;
+}
+
+inline const WifiAcStats::AcCounters&
+WifiAcStats::Get(uint32_t station, AcIndex ac) const
+{
+    NS_ABORT_MSG_IF(station >= m_stations.size(), "Unknown station " << station);
+    return m_stations[station][ac];
+}
+
+inline void
+WifiAcStats::Dequeued(AcCounters* counters, Ptr<const WifiMpdu> mpdu)
+{
+    counters->sojourn.Add(Simulator::Now() - mpdu->GetTimestamp());
+}
+
+inline void
+WifiAcStats::Txop(AcCounters* counters, Time /* start */, Time duration, uint8_t /* linkId */)
+{
+    ++counters->txops;
+    counters->txopTime += duration;
+}
+
+inline WifiAcStats::AcCounters*
+WifiAcStats::ForMpdu(StationCounters* station, Ptr<const WifiMpdu> mpdu)
+{
+    const WifiMacHeader& header = mpdu->GetHeader();
+    if (!header.IsQosData())
+    {
+        return nullptr;
+    }
+    return &(*station)[QosUtilsMapTidToAc(header.GetQosTid())];
+}
+
+inline void
+WifiAcStats::Acked(StationCounters* station, Ptr<const WifiMpdu> mpdu)
+{
+    if (AcCounters* counters = ForMpdu(station, mpdu))
+    {
+        ++counters->ackedMpdus;
+        counters->ackedBytes += mpdu->GetPacketSize();
+    }
+}
+
+inline void
+WifiAcStats::Nacked(StationCounters* station, Ptr<const WifiMpdu> mpdu)
+{
+    if (AcCounters* counters = ForMpdu(station, mpdu))
+    {
+        ++counters->nackedMpdus;
+    }
+}
+
+inline void
+WifiAcStats::Dropped(StationCounters* station,
+                     WifiMacDropReason /* reason */,
+                     Ptr<const WifiMpdu> mpdu)
+{
+    if (AcCounters* counters = ForMpdu(station, mpdu))
+    {
+        ++counters->droppedMpdus;
+    }
+}
+
+inline void
+WifiAcStats::PrintLine(std::ostream& os,
+                       const std::string& label,
+                       AcIndex ac,
+                       const AcCounters& counters,
+                       Time duration)
+{
+    static const char* names[] = {"AC_BE", "AC_BK", "AC_VI", "AC_VO"};
+    double seconds = duration.GetSeconds();
+    const DurationHistogram& sojourn = counters.sojourn;
+    os << std::setw(6) << label << std::setw(7) << names[ac] << std::setw(10)
+       << counters.ackedMpdus << std::setw(10) << counters.ackedBytes * 8 / seconds / 1e6
+       << std::setw(10) << counters.sinkBytes * 8 / seconds / 1e6 << std::setw(9)
+       << counters.nackedMpdus << std::setw(8) << counters.droppedMpdus << std::setw(8)
+       << counters.txops << std::setw(8) << 100 * counters.txopTime.GetSeconds() / seconds
+       << std::setw(10) << sojourn.GetMean().GetMicroSeconds() / 1e3 << std::setw(10)
+       << sojourn.GetPercentile(0.5).GetMicroSeconds() / 1e3 << std::setw(10)
+       << sojourn.GetPercentile(0.9).GetMicroSeconds() / 1e3 << std::setw(10)
+       << sojourn.GetPercentile(0.99).GetMicroSeconds() / 1e3 << std::setw(10)
+       << sojourn.GetMax().GetMicroSeconds() / 1e3 << "\n";
+}
+
+inline void
+WifiAcStats::Print(std::ostream& os, Time duration) const
+{
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(2);
+    os << std::setw(6) << "sta" << std::setw(7) << "ac" << std::setw(10) << "acked"
+       << std::setw(10) << "macMbps" << std::setw(10) << "appMbps" << std::setw(9) << "nacked"
+       << std::setw(8) << "drops" << std::setw(8) << "txops" << std::setw(8) << "txop%"
+       << std::setw(10) << "meanMs" << std::setw(10) << "p50Ms" << std::setw(10) << "p90Ms"
+       << std::setw(10) << "p99Ms" << std::setw(10) << "maxMs"
+       << "\n";
+
+    StationCounters totals{};
+    for (uint32_t station = 0; station < m_stations.size(); ++station)
+    {
+        for (AcIndex ac : {AC_BE, AC_BK, AC_VI, AC_VO})
+        {
+            const AcCounters& counters = m_stations[station][ac];
+            PrintLine(os, std::to_string(station), ac, counters, duration);
+
+            AcCounters& total = totals[ac];
+            total.sojourn.Merge(counters.sojourn);
+            total.txops += counters.txops;
+            total.txopTime += counters.txopTime;
+            total.ackedMpdus += counters.ackedMpdus;
+            total.ackedBytes += counters.ackedBytes;
+            total.nackedMpdus += counters.nackedMpdus;
+            total.droppedMpdus += counters.droppedMpdus;
+            total.sinkBytes += counters.sinkBytes;
+        }
+    }
+    for (AcIndex ac : {AC_BE, AC_BK, AC_VI, AC_VO})
+    {
+        PrintLine(os, "all", ac, totals[ac], duration);
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace ns3
+
+#endif /* WIFI_AC_STATS_H */